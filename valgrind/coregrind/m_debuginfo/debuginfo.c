@@ -4759,6 +4759,11 @@ PtrdiffT VG_(DebugInfo_get_text_bias)(const DebugInfo* di)
    return di->text_present ? di->text_bias : 0;
 }
 
+ULong VG_(DebugInfo_get_handle)(const DebugInfo* di)
+{
+   return di->handle;
+}
+
 Int VG_(DebugInfo_syms_howmany) ( const DebugInfo *si )
 {
    return si->symtab_used;
@@ -39,6 +39,7 @@
 #include "pub_core_libcprint.h"
 #include "pub_core_libcproc.h"     /* VG_(read_millisecond_timer) */
 #include "pub_core_libcfile.h"
+#include "pub_core_debuginfo.h"     /* VG_(tinfl_decompress_mem_to_mem) */
 #include "priv_misc.h"             /* dinfo_zalloc/free/strdup */
 #include "priv_image.h"            /* self */
 
@@ -1322,6 +1323,20 @@ UInt ML_(img_calc_gnu_debuglink_crc32)(DiImage* img)
    vg_assert(0);
 }
 
+/* Fjalar - see pub_tool_debuginfo.h. */
+SizeT VG_(tinfl_decompress_mem_to_mem) ( void* out, SizeT out_len,
+                                         const void* src, SizeT src_len,
+                                         Int flags )
+{
+   STATIC_ASSERT(VG_TINFL_FLAG_PARSE_ZLIB_HEADER
+                 == TINFL_FLAG_PARSE_ZLIB_HEADER);
+   STATIC_ASSERT(VG_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF
+                 == TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+   STATIC_ASSERT(VG_TINFL_DECOMPRESS_FAILED
+                 == TINFL_DECOMPRESS_MEM_TO_MEM_FAILED);
+   return tinfl_decompress_mem_to_mem(out, out_len, src, src_len, flags);
+}
+
 ////////////////////////////////////////////////////
 #include "minilzo-inl.c"
 
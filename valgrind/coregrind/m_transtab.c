@@ -2323,6 +2323,22 @@ void VG_(discard_translations_safely) ( Addr  start, SizeT len,
    VG_(discard_translations)(start, len, who);
 }
 
+/* Fjalar - see pub_tool_transtab.h.  This deliberately doesn't check
+   VG_(ok_to_discard_translations), which is only set while a client
+   request is being handled.  What that check guards against is the
+   caller returning into host code that has gone away; but
+   VG_(discard_translations) only marks the translations as deleted
+   and unchains them, and leaves their host code in place until the
+   sector is recycled.  That can't happen before the dirty helper
+   returns, since the helper makes no new translations, so the
+   superblock it was called from finishes normally and then goes back
+   through the dispatcher, which won't find it anymore. */
+void VG_(discard_translations_from_helper) ( Addr  start, SizeT len,
+                                             const HChar* who )
+{
+   VG_(discard_translations)(start, len, who);
+}
+
 /*------------------------------------------------------------*/
 /*--- AUXILIARY: the unredirected TT/TC                    ---*/
 /*------------------------------------------------------------*/
@@ -133,6 +133,24 @@ void fjalar_tool_handle_function_exit(FunctionExecutionState* f_state) {
 
 }
 
+// These functions are called when a tracing window is opened or
+// closed (see ../fjalar.h):
+void fjalar_tool_trace_window_opened(UInt segment) {
+  VG_(printf)("[trace window %u opened]\n", segment);
+}
+
+void fjalar_tool_trace_window_closed(UInt segment) {
+  VG_(printf)("[trace window %u closed]\n", segment);
+}
+
+void fjalar_tool_dump_stats(void) {
+  // We don't keep any statistics
+}
+
+void fjalar_tool_checkpoint(void) {
+  // We don't keep any state worth saving
+}
+
 
 // Constructors and destructors for classes that can be sub-classed:
 
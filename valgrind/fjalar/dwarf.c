@@ -175,7 +175,7 @@ int do_debug_pubnames;		// true if --fjalar-debug-dump
 int do_debug_pubtypes;		// never true for Fjalar
 int do_debug_aranges;		// never true for Fjalar
 int do_debug_ranges;		// true if --fjalar-debug-dump
-int do_debug_frames;		// always true for Fjalar
+int do_debug_frames;		// true if --fjalar-debug-dump
 int do_debug_frames_interp;	// never true for Fjalar
 int do_debug_macinfo;		// true if --fjalar-debug-dump
 int do_debug_str;		// true if --fjalar-debug-dump
@@ -1435,12 +1435,13 @@ decode_location_expression (unsigned char * data,
     {
       op = *data++;
 
-      if(ll) {ll->atom = op;}
+      if(ll) {ll->atom = op; harvest_location_list_op(ll, op);}
 
       switch (op)
 	{
 	case DW_OP_addr:
 	  SAFE_BYTE_GET_AND_INC (uvalue, data, pointer_size, end);
+	  if (ll) harvest_location_list_operand(ll, uvalue);  // Fjalar
 	  if (ok_to_harvest)
 	    harvest_variable_addr_value(entry, uvalue);
 	  printf ("DW_OP_addr: %s", dwarf_vmatoa ("x", uvalue));
@@ -1455,14 +1456,17 @@ decode_location_expression (unsigned char * data,
 	  break;
 	case DW_OP_const1u:
 	  SAFE_BYTE_GET_AND_INC (uvalue, data, 1, end);
+	  if (ll) harvest_location_list_operand(ll, uvalue);  // Fjalar
 	  printf ("DW_OP_const1u: %lu", (unsigned long) uvalue);
 	  break;
 	case DW_OP_const1s:
 	  SAFE_SIGNED_BYTE_GET_AND_INC (svalue, data, 1, end);
+	  if (ll) harvest_location_list_operand(ll, svalue);  // Fjalar
 	  printf ("DW_OP_const1s: %ld", (long) svalue);
 	  break;
 	case DW_OP_const2u:
 	  SAFE_BYTE_GET_AND_INC (uvalue, data, 2, end);
+	  if (ll) harvest_location_list_operand(ll, uvalue);  // Fjalar
 	  if (ok_to_harvest)
 	    if (entry && tag_is_formal_parameter(entry->tag_name)) {
 	      harvest_formal_param_location_atom(entry, op, uvalue);
@@ -1472,6 +1476,7 @@ decode_location_expression (unsigned char * data,
 	  break;
 	case DW_OP_const2s:
 	  SAFE_SIGNED_BYTE_GET_AND_INC (svalue, data, 2, end);
+	  if (ll) harvest_location_list_operand(ll, svalue);  // Fjalar
 	  if (ok_to_harvest)
 	    if (entry && tag_is_formal_parameter(entry->tag_name)) {
 	      harvest_formal_param_location_atom(entry, op, svalue);
@@ -1481,6 +1486,7 @@ decode_location_expression (unsigned char * data,
 	  break;
 	case DW_OP_const4u:
 	  SAFE_BYTE_GET_AND_INC (uvalue, data, 4, end);
+	  if (ll) harvest_location_list_operand(ll, uvalue);  // Fjalar
 	  if (ok_to_harvest)
 	    if (entry && tag_is_formal_parameter(entry->tag_name)) {
 	      harvest_formal_param_location_atom(entry, op, uvalue);
@@ -1490,6 +1496,7 @@ decode_location_expression (unsigned char * data,
 	  break;
 	case DW_OP_const4s:
 	  SAFE_SIGNED_BYTE_GET_AND_INC (svalue, data, 4, end);
+	  if (ll) harvest_location_list_operand(ll, svalue);  // Fjalar
       if (ok_to_harvest)
 	    if (entry && tag_is_formal_parameter(entry->tag_name)) {
 	      harvest_formal_param_location_atom(entry, op, svalue);
@@ -1511,6 +1518,7 @@ decode_location_expression (unsigned char * data,
 	  break;
 	case DW_OP_constu:
 	  READ_ULEB (uvalue, data, end);
+	  if (ll) harvest_location_list_operand(ll, uvalue);  // Fjalar
 	  if (ok_to_harvest)
 	    if (entry && tag_is_formal_parameter(entry->tag_name)) {
 	      harvest_formal_param_location_atom(entry, op, uvalue);
@@ -1520,6 +1528,7 @@ decode_location_expression (unsigned char * data,
 	  break;
 	case DW_OP_consts:
 	  READ_SLEB (svalue, data, end);
+	  if (ll) harvest_location_list_operand(ll, svalue);  // Fjalar
 	  if (ok_to_harvest)
 	    if (entry && tag_is_formal_parameter(entry->tag_name)) {
 	      harvest_formal_param_location_atom(entry, op, svalue);
@@ -1581,6 +1590,7 @@ decode_location_expression (unsigned char * data,
 	  break;
 	case DW_OP_plus_uconst:
 	  READ_ULEB (uvalue, data, end);
+	  if (ll) harvest_location_list_operand(ll, uvalue);  // Fjalar
 	  if (ok_to_harvest) {
 	    if (entry && tag_is_formal_parameter(entry->tag_name)) {
 		  harvest_formal_param_location_atom(entry, op, uvalue);
@@ -1742,6 +1752,7 @@ decode_location_expression (unsigned char * data,
 	case DW_OP_breg30:
 	case DW_OP_breg31:
 	  READ_SLEB (svalue, data, end);
+	  if (ll) harvest_location_list_operand(ll, svalue);  // Fjalar
           if (ok_to_harvest) {
               if(ll) {
                 ll->atom_offset = svalue;
@@ -1769,6 +1780,7 @@ decode_location_expression (unsigned char * data,
 	case DW_OP_fbreg:
 	  need_frame_base = 1;
 	  READ_SLEB (svalue, data, end);
+	  if (ll) harvest_location_list_operand(ll, svalue);  // Fjalar
           if (ok_to_harvest) {
               if(ll) {
                 ll->atom_offset = svalue;
@@ -3710,8 +3722,19 @@ read_and_display_attr_value (unsigned long           attribute,
                                       uvalue, cu_offset, section, pass2, ok_to_harvest, entry, 0);
           printf (")");
 	  }
-      else if (form == DW_FORM_data4 || form == DW_FORM_data8)
+      else if (form == DW_FORM_data4 || form == DW_FORM_data8
+               || form == DW_FORM_sec_offset || form == DW_FORM_loclistx)
 	  {
+          // Fjalar - the location changes with the PC (see
+          // harvest_location_list_entry()).  Only the .debug_loc lists
+          // of DWARF 4 and earlier are read; a DWARF 5 list is in
+          // .debug_loclists, so its offset means nothing in loc_list_map.
+          if (ok_to_harvest && attribute == DW_AT_location) {
+            if (dwarf_version >= 5)
+              harvest_formal_param_loclists(entry);
+            else
+              harvest_formal_param_location_list(entry, uvalue);
+          }
           printf ("(");
           printf ("location list");
           printf (")");
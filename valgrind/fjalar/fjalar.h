@@ -0,0 +1,134 @@
+
+/*
+   ----------------------------------------------------------------
+
+   Notice that the following BSD-style license applies to this one
+   file (fjalar.h) only.  The rest of Valgrind is licensed under the
+   terms of the GNU General Public License, version 2, unless
+   otherwise indicated.  See the COPYING file in the source
+   distribution for details.
+
+   ----------------------------------------------------------------
+
+   This file is part of Fjalar, a dynamic analysis framework for C/C++
+   programs.
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   1. Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+   2. The origin of this software must not be misrepresented; you must
+      not claim that you wrote the original software.  If you use this
+      software in a product, an acknowledgment in the product
+      documentation would be appreciated but is not required.
+
+   3. Altered source versions must be plainly marked as such, and must
+      not be misrepresented as being the original software.
+
+   4. The name of the author may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+   GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   ----------------------------------------------------------------
+
+   Notice that the above BSD-style license applies to this one file
+   (fjalar.h) only.  The entire rest of Valgrind is licensed under
+   the terms of the GNU General Public License, version 2.  See the
+   COPYING file in the source distribution for details.
+
+   ----------------------------------------------------------------
+*/
+
+
+#ifndef __FJALAR_H
+#define __FJALAR_H
+
+
+/* This file is for inclusion into client (your!) code.
+
+   You can use these macros to open and close tracing windows from
+   inside the program being traced by Fjalar (e.g., by Kvasir):
+
+      FJALAR_STOP_TRACING;     // e.g., at the start of main()
+      ... warm up ...
+      FJALAR_START_TRACING;    // trace from here on
+      ...
+      FJALAR_ROTATE_TRACE;     // start a new trace segment
+      ...
+      FJALAR_STOP_TRACING;
+
+   While tracing is stopped, function entries and exits are not
+   reported to the Fjalar tool.  Every window that is opened goes to
+   its own trace segment (for Kvasir, its own .dtrace file).  The same
+   commands can be issued from outside the program with the
+   --trace-control-file option.
+
+   See comment near the top of valgrind.h on how to use them.  When the
+   program is not running under Fjalar, these macros do nothing.
+*/
+
+#include "valgrind.h"
+
+/* !! ABIWARNING !! ABIWARNING !! ABIWARNING !! ABIWARNING !!
+   This enum comprises an ABI exported by Valgrind to programs
+   which use client requests.  DO NOT CHANGE THE ORDER OF THESE
+   ENTRIES, NOR DELETE ANY -- add new ones at the end. */
+typedef
+   enum {
+      VG_USERREQ__FJALAR_START_TRACING = VG_USERREQ_TOOL_BASE('F','J'),
+      VG_USERREQ__FJALAR_STOP_TRACING,
+      VG_USERREQ__FJALAR_ROTATE_TRACE,
+      VG_USERREQ__FJALAR_DUMP_STATS,
+      VG_USERREQ__FJALAR_CHECKPOINT
+   } Vg_FjalarClientRequest;
+
+
+/* Client-code macros to manipulate the tracing window */
+
+/* Open a tracing window (does nothing if one is already open). */
+#define FJALAR_START_TRACING                                     \
+    VALGRIND_DO_CLIENT_REQUEST_STMT(VG_USERREQ__FJALAR_START_TRACING, \
+                                    0, 0, 0, 0, 0)
+
+/* Close the current tracing window (does nothing if none is open). */
+#define FJALAR_STOP_TRACING                                      \
+    VALGRIND_DO_CLIENT_REQUEST_STMT(VG_USERREQ__FJALAR_STOP_TRACING, \
+                                    0, 0, 0, 0, 0)
+
+/* Close the current tracing window and immediately open a new one. */
+#define FJALAR_ROTATE_TRACE                                      \
+    VALGRIND_DO_CLIENT_REQUEST_STMT(VG_USERREQ__FJALAR_ROTATE_TRACE, \
+                                    0, 0, 0, 0, 0)
+
+/* Have the tool write out its statistics so far (e.g., Kvasir's
+   --kvasir-stats file). */
+#define FJALAR_DUMP_STATS                                        \
+    VALGRIND_DO_CLIENT_REQUEST_STMT(VG_USERREQ__FJALAR_DUMP_STATS, \
+                                    0, 0, 0, 0, 0)
+
+/* Have the tool save the state it has accumulated so far, so that a
+   later run can pick up from there (e.g., Kvasir's
+   --dyncomp-checkpoint file). */
+#define FJALAR_CHECKPOINT                                        \
+    VALGRIND_DO_CLIENT_REQUEST_STMT(VG_USERREQ__FJALAR_CHECKPOINT, \
+                                    0, 0, 0, 0, 0)
+
+#endif
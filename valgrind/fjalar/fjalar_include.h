@@ -227,6 +227,19 @@ struct _AggregateType {
   //       but that shouldn't really matter in practice - oh well...
   SimpleList* /* <Superclass> */ superclassList;
 
+  // The class graph, which is worked out once all types are known:
+
+  // Numbers the struct/class/union types in TypesTable from 1 to
+  // numAggregateTypes, so that tools can keep per-type data in an
+  // array (0 if this type isn't in TypesTable)
+  UInt objectIndex;
+
+  // The distinct struct/class/union types of this type's (non-static)
+  // member variables, not counting those of its superclasses
+  // Every elt is a TypeEntry* so this is like List<TypeEntry>
+  // (Only non-null if there is at least 1 such type)
+  SimpleList* /* <TypeEntry> */ memberClassList;
+
 };
 
 
@@ -294,6 +307,10 @@ Bool hasNextType(TypeIterator* typeIt);
 TypeEntry* nextType(TypeIterator* typeIt);
 void deleteTypeIterator(TypeIterator* typeIt);
 
+// The number of struct/class/union types in TypesTable (the largest
+// AggregateType::objectIndex)
+UInt numAggregateTypes;
+
 
 /******** VariableEntry ********/
 
@@ -324,6 +341,20 @@ typedef struct _VariableEntry {
   dwarf_location location_expression[MAX_DWARF_OPS];
   unsigned int location_expression_size;
 
+  // For a formal parameter of optimized code, DWARF may give a
+  // "location list" instead: a different location expression for
+  // each range of PCs.  hasLocList is then True, locListOffset is the
+  // list's key in loc_list_map, and locListSlot is this parameter's
+  // index into FunctionExecutionState.locListParams, where its
+  // location at function entrance is saved (see enter_function()).
+  Bool hasLocList;
+  unsigned long locListOffset;
+  int locListSlot;
+  // The entry of the location list that covered locListCachePC, the
+  // last PC that we looked up (saves walking the list every call)
+  Addr locListCachePC;
+  struct _location_list* locListCacheEntry;
+
   // If locationType == FP_OFFSET_LOCATION then this field contains
   // the byte offset of the variable from the DWARF notion of frame base.
   // This is usually NOT the same as ESP.
@@ -409,6 +440,11 @@ typedef struct _VariableEntry {
   // declared in.
   char* declaredIn;
 
+  // Which of this variable and the variables derived from it are in
+  // the --var-list-file, compiled by compileVarSelections() (one per
+  // trace_vars_tree that this variable is visited with)
+  struct _VarSelection* varSelections;
+
 } VariableEntry;
 
 
@@ -593,6 +629,10 @@ typedef struct _FunctionEntry {
   // locations.
   Addr entryPC;
 
+  // The address that find_entry_point() picked for entryPC (its key in
+  // FunctionTable_by_endOfBb), or 0 if it hasn't been picked yet
+  Addr entryPoint;
+
   // Fjalar maintains a virtual stack for invocation a function. This
   // allows Fjalar to provide tools with unaltered values of formal
   // parameters at both function entry and exit, regardless of whether
@@ -645,6 +685,11 @@ typedef struct _FunctionEntry {
   //Has trace_global_vars_tree been initialized?
   Bool trace_global_vars_tree_already_initialized;
 
+  // Whether fjalar_name is in the --ppt-list-file (once
+  // prog_pts_tree_entry_found() has looked it up)
+  Bool pptListChecked;
+  Bool inPptList;
+
 
   // Estimate of the amount of stack space used by the function's formal
   // parameters that are actually pushed onto the stack. This amount of
@@ -655,6 +700,23 @@ typedef struct _FunctionEntry {
   // the function's formal parameters that are passed in registers.
   int formalParamLowerStackByteSize;
 
+  // True if every formal parameter lives at a fixed offset from the
+  // frame base (its location is a lone DW_OP_fbreg, as it is for
+  // register-passed params once the prolog has spilled them).  Then
+  // only the bytes from formalParamSnapshotLow to
+  // formalParamSnapshotHigh (offsets from the frame base) are copied
+  // into the virtual stack on entrance, rather than the whole frame.
+  Bool formalParamSnapshotExact;
+  int formalParamSnapshotLow;
+  int formalParamSnapshotHigh;
+
+  // Number of formal parameters whose location is given by a
+  // location list (VariableEntry.hasLocList)
+  int numLocListParams;
+  // Where those parameters were at entrance to the current invocation
+  // of this function (set on entrance and exit just like lowestVirtSP)
+  struct _LocListParamSnapshot* locListParams;
+
   // GCC 4.0+ Complicates things as it will not use Frame offsets for
   // all formal parameters. If we want to mimic the behavior achieved
   // for GCC 3.3 we'll have to keep track of the mapping between
@@ -668,6 +730,14 @@ typedef struct _FunctionEntry {
 
   UInt nonce;
 
+  // True once a tool has called fjalar_retire_function() on this
+  // function.  Fjalar no longer instruments it for entry/exit and no
+  // longer calls the tool's entrance/exit handlers for it.
+  Bool retired;
+  // True once the translations of a retired function have been
+  // discarded (which waits until no invocation of it is active)
+  Bool retiredTranslationsDiscarded;
+
 } FunctionEntry;
 
 
@@ -718,6 +788,22 @@ These data structures and functions provide mechanisms for runtime
 traversals within data structures and arrays
 **********************************************************************/
 
+// Where a formal parameter with a location list (see
+// VariableEntry.hasLocList) was at function entrance.  If the
+// parameter was in memory, loc is its address (in the virtual stack if
+// it was in the part of the guest stack that was copied there) and
+// locGuest its address on the guest.  If its value was in a register
+// or computed by the location expression, that value is saved in
+// value (which is then marked as defined) and loc points to it.  If
+// Fjalar couldn't evaluate the location, loc still points to value,
+// but Memcheck considers it unaddressable, so the parameter shows up
+// as nonsensical.
+typedef struct _LocListParamSnapshot {
+  Addr loc;
+  Addr locGuest;
+  Word value;
+} LocListParamSnapshot;
+
 // Entries for tracking the runtime state of functions at entrances
 // and exits (used mainly by FunctionExecutionStateStack in
 // fjalar_main.c).  This class CANNOT BE SUBCLASSED because it is
@@ -754,7 +840,8 @@ typedef struct {
 
   // This is a copy of the portion of the function's stack frame that
   // is in use after the function prolog has executed, including the
-  // formal parameters in the caller's frame.  It holds function
+  // formal parameters in the caller's frame (or, if
+  // func->formalParamSnapshotExact, of just the formal parameters).  It holds function
   // formal parameter values that were passed into this function at
   // entrance time.  We reference this virtualStack at function exit
   // in order to visit the SAME formal parameter values upon exit as
@@ -769,8 +856,24 @@ typedef struct {
   int virtualStackByteSize; // Number of 1-byte entries in virtualStack
   int virtualStackFPOffset; // Where in the stack the frame pointer was
 
+  // One entry for each of func's formal parameters that has a
+  // location list (func->numLocListParams of them, indexed by
+  // VariableEntry.locListSlot), or 0 if there are none
+  LocListParamSnapshot* locListParams;
+
 
   Addr lowSP;
+
+  // Scratch space that a tool may use to carry state from the
+  // entrance of this invocation to its exit (e.g., whether the
+  // invocation was sampled).  Fjalar clears it to 0 on entrance.
+  UWord toolData;
+
+  // True if the function had already been retired when this
+  // invocation began, so the tool never saw its entrance and will not
+  // see its exit.  (We still push an entry so that exits of recursive
+  // invocations match up until the translations are discarded.)
+  Bool untraced;
 } FunctionExecutionState;
 
 
@@ -937,6 +1040,28 @@ void visitVariableGroup(VariableOrigin varOrigin,
                         // variable visited:
 			TraversalAction *performAction);
 
+// Called by visitGlobalVariables() before it visits a global variable
+// 'var' (stored at pValue, which may be 0 if it has no location) and
+// all variables derived from it.  Return False to skip the variable,
+// e.g., because the tool already knows what visiting it would do.
+typedef Bool (BeforeGlobalVarAction)(VariableEntry* var,
+                                     Addr pValue,
+                                     FunctionEntry* varFuncInfo,
+                                     Bool isEnter);
+
+// Called by visitGlobalVariables() after it has visited a global
+// variable and all variables derived from it
+typedef void (AfterGlobalVarAction)(VariableEntry* var);
+
+// Like visitVariableGroup(GLOBAL_VAR, ...), but also calls
+// beforeVar and afterVar (if they are non-null) around the visit of
+// each global variable
+void visitGlobalVariables(FunctionEntry* funcPtr,
+                          Bool isEnter,
+                          TraversalAction *performAction,
+                          BeforeGlobalVarAction *beforeVar,
+                          AfterGlobalVarAction *afterVar);
+
 // Grabs the appropriate return value of the function denoted by the
 // execution state 'e' from Valgrind simulated registers and visits
 // the derived variables to perform some action.  This differs from
@@ -1077,8 +1202,10 @@ Bool fjalar_output_struct_vars;            // --output-struct-vars
 Bool fjalar_flatten_arrays;                // --flatten-arrays
 Bool fjalar_func_disambig_ptrs;            // --func-disambig-ptrs
 Bool fjalar_disambig_ptrs;                 // --disambig-ptrs
+Bool fjalar_trace_from_start;              // --trace-from-start
 
 int  fjalar_array_length_limit;            // --array-length-limit
+int  fjalar_trace_control_interval;        // --trace-control-interval
 
 UInt fjalar_max_visit_struct_depth;        // --struct-depth
 UInt fjalar_max_visit_nesting_depth;       // --nesting-depth
@@ -1092,6 +1219,8 @@ const HChar* fjalar_trace_prog_pts_filename;      // --ppt-list-file
 const HChar* fjalar_trace_vars_filename;          // --var-list-file
 const HChar* fjalar_disambig_filename;            // --disambig-file
 const HChar* fjalar_xml_output_filename;          // --xml-output-file
+const HChar* fjalar_trace_control_filename;       // --trace-control-file
+const HChar* fjalar_trace_library;                // --trace-library
 
 
 /*********************************************************************
@@ -1104,6 +1233,12 @@ Bool doing_debug_print;
 // The filename of the target executable:
 const HChar* executable_filename;
 
+// Set by a tool that keeps each thread's output apart: number the
+// invocations of each thread separately, so that a thread's
+// invocation nonces don't depend on how it was scheduled against
+// the others.  (Otherwise all threads share one sequence.)
+Bool fjalar_per_thread_nonces;
+
 // returns ID1 == ID2 - needed for GenericHashtable
 int equivalentIDs(int ID1, int ID2);
 
@@ -1118,6 +1253,32 @@ unsigned int hashString(const char* str);
 // fjalar_trace_prog_pts_filename is non-null)
 Bool prog_pts_tree_entry_found(FunctionEntry* cur_entry);
 
+// Tells Fjalar that the tool has no further interest in the function
+// f (e.g., because it has already seen enough executions of it).
+// Fjalar stops calling fjalar_tool_handle_function_entrance/exit for
+// new invocations of f and, as soon as no invocation of f is active
+// on any thread, discards f's translations so that f subsequently
+// runs with no Fjalar hooks at all.  It is safe to call this from
+// within fjalar_tool_handle_function_entrance/exit.
+void fjalar_retire_function(FunctionEntry* f);
+
+// Tracing windows (see fjalar.h): function entries and exits are only
+// passed on to the tool while a window is open.
+// True while a tracing window is open:
+Bool fjalar_tracing_window_open;
+// The number of the current (or, if none is open, the last) window,
+// starting at 0 - this is the segment passed to
+// fjalar_tool_trace_window_opened/closed():
+UInt fjalar_trace_segment;
+
+// Open a new tracing window, close the current one, or do both.
+// These are what the FJALAR_START_TRACING, FJALAR_STOP_TRACING and
+// FJALAR_ROTATE_TRACE client requests and the commands in the
+// --trace-control-file do.
+void fjalar_start_tracing(void);
+void fjalar_stop_tracing(void);
+void fjalar_rotate_trace(void);
+
 #define MAX_STRING_STACK_SIZE 100
 
 typedef struct StringStack_ {
@@ -39,12 +39,19 @@
 #include "pub_tool_replacemalloc.h"
 #include "pub_tool_stacktrace.h"
 #include "pub_tool_clientstate.h"
+#include "pub_tool_debuginfo.h"
+#include "pub_tool_transtab.h"
+#include "pub_tool_tooliface.h"
+#include "pub_tool_libcfile.h"
+#include "pub_tool_vki.h"           // VKI_PROT_READ
 
 #include "generate_fjalar_entries.h"
 #include "fjalar_main.h"
 #include "fjalar_runtime.h"
 #include "fjalar_tool.h"
+#include "fjalar.h"
 #include "fjalar_select.h"
+#include "fjalar_traversal.h"
 #include "disambig.h"
 #include "mc_include.h"
 #include "typedata.h"
@@ -70,7 +77,9 @@ Bool fjalar_output_struct_vars = False;
 Bool fjalar_flatten_arrays = False;
 Bool fjalar_func_disambig_ptrs = False;
 Bool fjalar_disambig_ptrs = False;
+Bool fjalar_trace_from_start = True;
 int  fjalar_array_length_limit = -1;
+int  fjalar_trace_control_interval = 10000;
 
 // adjustable via the --struct-depth=N option:
 UInt fjalar_max_visit_struct_depth = 4;
@@ -87,6 +96,12 @@ const HChar* fjalar_trace_prog_pts_filename = 0;
 const HChar* fjalar_trace_vars_filename = 0;
 const HChar* fjalar_disambig_filename = 0;
 const HChar* fjalar_xml_output_filename = 0;
+const HChar* fjalar_trace_control_filename = 0;
+const HChar* fjalar_trace_library = 0;
+
+// Tracing windows (see fjalar.h):
+Bool fjalar_tracing_window_open = True;
+UInt fjalar_trace_segment = 0;
 
 // Are we printing decls because we are debugging?
 Bool doing_debug_print = False;
@@ -94,6 +109,9 @@ Bool doing_debug_print = False;
 // The filename of the target executable:
 const HChar* executable_filename = 0;
 
+// Set by the tool (see fjalar_include.h):
+Bool fjalar_per_thread_nonces = False;
+
 // Mapping between Dwarf Register numbers and
 // valgrind function to return the value
 // Below comment is ripped from GCC 4.3.1
@@ -139,6 +157,27 @@ Addr (*get_reg[16])( ThreadId tid ) = {
   VG_(get_R14),
   VG_(get_R15),
 };
+
+// Where each of the registers in get_reg[] is in the guest state (for
+// getting at its V bits and DynComp tag)
+static const Int get_reg_guest_offset[16] = {
+  offsetof(VexGuestAMD64State, guest_RAX),
+  offsetof(VexGuestAMD64State, guest_RDX),
+  offsetof(VexGuestAMD64State, guest_RCX),
+  offsetof(VexGuestAMD64State, guest_RBX),
+  offsetof(VexGuestAMD64State, guest_RSI),
+  offsetof(VexGuestAMD64State, guest_RDI),
+  offsetof(VexGuestAMD64State, guest_RBP),
+  offsetof(VexGuestAMD64State, guest_RSP),
+  offsetof(VexGuestAMD64State, guest_R8),
+  offsetof(VexGuestAMD64State, guest_R9),
+  offsetof(VexGuestAMD64State, guest_R10),
+  offsetof(VexGuestAMD64State, guest_R11),
+  offsetof(VexGuestAMD64State, guest_R12),
+  offsetof(VexGuestAMD64State, guest_R13),
+  offsetof(VexGuestAMD64State, guest_R14),
+  offsetof(VexGuestAMD64State, guest_R15),
+};
 #else
 Addr (*get_reg[11])( ThreadId tid ) = {
   VG_(get_xAX),
@@ -153,6 +192,22 @@ Addr (*get_reg[11])( ThreadId tid ) = {
   NULL,
   NULL
 };
+
+// Where each of the registers in get_reg[] is in the guest state (for
+// getting at its V bits and DynComp tag), or -1 if it isn't there
+static const Int get_reg_guest_offset[11] = {
+  offsetof(VexGuestX86State, guest_EAX),
+  offsetof(VexGuestX86State, guest_ECX),
+  offsetof(VexGuestX86State, guest_EDX),
+  offsetof(VexGuestX86State, guest_EBX),
+  offsetof(VexGuestX86State, guest_ESP),
+  offsetof(VexGuestX86State, guest_EBP),
+  offsetof(VexGuestX86State, guest_ESI),
+  offsetof(VexGuestX86State, guest_EDI),
+  offsetof(VexGuestX86State, guest_EIP),
+  -1,
+  -1
+};
 #endif
 
 // For debugging purposes, a mapping between
@@ -179,20 +234,145 @@ extern void setNOBUF(FILE *stream);
 /*--- Entry and Exit Handling                              ---*/
 /*------------------------------------------------------------*/
 
-// (comment added 2005)
-// TODO: We cannot sub-class FunctionExecutionState unless we make
-// this into an array of pointers. Have one stack for
-// each thread. We'll be wasteful and just have the maximum number
-// of threads.
-FunctionExecutionStateStack1d *FunctionExecutionStateStack;
+FunctionExecutionStateStack** fnStacks = 0;
+FunctionExecutionState fnStackEmptyEntry;
+
+// Allocate the (empty) stack of thread tid and its first segment
+FunctionExecutionStateStack* fnStackCreate(ThreadId tid) {
+  FunctionExecutionStateStack* stack =
+    VG_(calloc)("fjalar_main.c: fnStackCreate", 1, sizeof(*stack));
+
+  stack->segSize = FN_STACK_FIRST_SEGMENT_SIZE;
+  stack->segments[0] =
+    VG_(calloc)("fjalar_main.c: fnStackCreate.2", stack->segSize,
+                sizeof(FunctionExecutionState));
+  fnStacks[tid] = stack;
+  return stack;
+}
+
+// Move on to the next segment of a stack whose current segment is
+// full, allocating it if this is the deepest the stack has ever been
+void fnStackNextSegment(FunctionExecutionStateStack* stack) {
+  // The first push onto an empty stack goes into segment 0, which
+  // always exists:
+  if (stack->size == 0) {
+    return;
+  }
+
+  if (stack->seg + 1 >= FN_STACK_MAX_SEGMENTS) {
+    printf("Fjalar: the function stack is more than %d calls deep\n",
+           stack->size);
+    VG_(exit)(1);
+  }
+
+  stack->segStart += stack->segSize;
+  stack->segSize <<= 1;
+  stack->seg++;
+  if (!stack->segments[stack->seg]) {
+    stack->segments[stack->seg] =
+      VG_(calloc)("fjalar_main.c: fnStackNextSegment", stack->segSize,
+                  sizeof(FunctionExecutionState));
+  }
+}
+
+FunctionExecutionState* fnStackGet(ThreadId tid, int i) {
+  FunctionExecutionStateStack* stack = fnStacks[tid];
+  int seg = 0;
+  int segStart = 0;
+  int segSize = FN_STACK_FIRST_SEGMENT_SIZE;
+
+  tl_assert(stack && 0 <= i && i < stack->size);
+  while (i >= segStart + segSize) {
+    segStart += segSize;
+    segSize <<= 1;
+    seg++;
+  }
+  return &stack->segments[seg][i - segStart];
+}
+
+static void freeVirtualStack(FunctionExecutionState* state);
+
+// Free the stack of a thread that is exiting, along with whatever is
+// left of the virtual stacks of the invocations still on it
+static void fnStackFree(ThreadId tid) {
+  FunctionExecutionStateStack* stack = fnStacks[tid];
+  int i;
+
+  if (!stack) {
+    return;
+  }
+
+  for (i = 0; i < stack->size; i++) {
+    freeVirtualStack(fnStackGet(tid, i));
+  }
+  for (i = 0; i < FN_STACK_MAX_SEGMENTS && stack->segments[i]; i++) {
+    VG_(free)(stack->segments[i]);
+  }
+  VG_(free)(stack);
+  fnStacks[tid] = 0;
+}
+
+// Returns True if some invocation of f is on the function execution
+// stack of any thread.  (This walks all of the stacks, so only use it
+// for retired functions.)
+static Bool function_is_active(FunctionEntry* f) {
+  ThreadId tid;
+  int i;
+
+  for (tid = 0; tid < VG_N_THREADS; tid++) {
+    for (i = 0; i < fnStackDepth(tid); i++) {
+      if (fnStackGet(tid, i)->func == f) {
+        return True;
+      }
+    }
+  }
+
+  return False;
+}
+
+static void forget_entry_point(FunctionEntry *f);
+
+// Throw away all translations of the retired function f so that it
+// gets re-translated without any calls to enter_function() or
+// exit_function().  This must wait until no invocation of f is
+// active, since those invocations still need their exits to be seen.
+static void discard_retired_function(FunctionEntry* f) {
+  tl_assert(f->retired);
+
+  if (f->retiredTranslationsDiscarded || function_is_active(f)) {
+    return;
+  }
+
+  FJALAR_DPRINTF("[discard_retired_function] %s [%p - %p]\n",
+                 f->fjalar_name, (void *)f->startPC, (void *)f->endPC);
+
+  // We may be called from within exit_function(), which is a dirty
+  // helper running inside one of the translations we are about to
+  // throw away; see pub_tool_transtab.h for why this is okay.
+  VG_(discard_translations_from_helper)(f->startPC,
+                                        f->endPC - f->startPC + 1,
+                                        "fjalar_retire_function");
+  f->retiredTranslationsDiscarded = True;
+}
+
+void fjalar_retire_function(FunctionEntry* f) {
+  tl_assert(f);
+
+  if (f->retired) {
+    return;
+  }
+
+  FJALAR_DPRINTF("[fjalar_retire_function] %s\n", f->fjalar_name);
 
+  f->retired = True;
 
-// The first free slot in FunctionExecutionStateStack
-// right above the top element:
-int *fn_stack_first_free_index;
+  // Once we get around to re-translating its entry block, make sure
+  // that handle_possible_entry_func() doesn't find it anymore (it
+  // also checks f->retired, but there is no point in keeping it)
+  forget_entry_point(f);
 
-// The top element of the stack is:
-// FunctionExecutionStateStack[fn_stack_first_free_index - 1]
+  discard_retired_function(f);
+}
 
 typedef VG_REGPARM(1) void entry_func(FunctionEntry *);
 
@@ -220,7 +400,8 @@ static void handle_possible_entry_func(MCEnv *mce, Addr64 addr,
   // file), then DO NOT generate IR code to call helper functions for
   // functions whose name is NOT located in prog_pts_tree. It's faster
   // to filter them out at translation-time instead of run-time
-  if (entry && (!fjalar_trace_prog_pts_filename ||
+  if (entry && !entry->retired &&
+      (!fjalar_trace_prog_pts_filename ||
 		prog_pts_tree_entry_found(entry))) {
     UWord entry_w = (UWord)entry;
     di = unsafeIRDirty_0_N(1/*regparms*/, func_name, func,
@@ -277,6 +458,15 @@ static void handle_possible_entry_func(MCEnv *mce, Addr64 addr,
 // come with the Ist_Exit IR instruction:
 static Addr currentAddr = 0;
 
+// The file name part of --trace-library, which is what we match the
+// core's DebugInfo file names against:
+static const HChar* trace_library_basename = 0;
+
+// Until the library of --trace-library is mapped, the model holds its
+// link-time addresses, which may well be those of code in the program
+// itself, so we must not take any of them for a function entry:
+static Bool trace_library_mapped = False;
+
 // This hash table simply ensures do not calculate the entry point for
 // a function multiple times. Due to the way entry is handled, the
 // handle_possble_entry function is called once for every instruction
@@ -311,6 +501,10 @@ void handle_possible_entry(MCEnv* mce, Addr64 addr, IRSB* bb_orig) {
   // properly:
   currentAddr = (Addr)addr;
 
+  if (trace_library_basename && !trace_library_mapped) {
+    return;
+  }
+
   FunctionEntry *entry = gengettable(FunctionTable, (void *)(Addr)addr);
   // debug code
   //FJALAR_DPRINTF("handle_possible_entry: addr: %p entry: %p\n", (void *)addr, entry);
@@ -397,7 +591,17 @@ static void find_entry_point(IRSB* bb_orig, FunctionEntry *f) {
   genputtable(funcs_handled, (void *)f, (void *)1);
 
   genputtable(FunctionTable_by_endOfBb, (void *)entry_pt, (void *)f);
+  f->entryPoint = entry_pt;
+
+}
 
+// Forget the entry point that find_entry_point() picked for f, if any
+static void forget_entry_point(FunctionEntry *f) {
+  if (f->entryPoint &&
+      (gengettable(FunctionTable_by_endOfBb, (void *)f->entryPoint) == f)) {
+    genfreekey(FunctionTable_by_endOfBb, (void *)f->entryPoint);
+  }
+  f->entryPoint = 0;
 }
 
 
@@ -412,6 +616,9 @@ void handle_possible_exit(MCEnv* mce, IRJumpKind jk) {
     FunctionEntry* curFuncPtr = getFunctionEntryFromAddr(currentAddr);
 
     if (curFuncPtr &&
+	// Don't bother for retired functions unless some invocation of
+	// it is still active and needs its exit to be seen:
+	(!curFuncPtr->retired || function_is_active(curFuncPtr)) &&
 	// Also, if fjalar_trace_prog_pts_filename is on (we are
 	// reading in a ppt list file), then DO NOT generate IR code
 	// to call helper functions for functions whose names are NOT
@@ -497,7 +704,401 @@ VG_REGPARM(1) void prime_function(FunctionEntry *f)
 }
 
 
+// Destroy the virtual stack of an invocation that is about to be popped
+static void freeVirtualStack(FunctionExecutionState* state) {
+  if (state->virtualStack) {
+    /* We were previously using the V bits associated with the area to
+       store guest V bits, but Memcheck doesn't normally expect
+       VG_(malloc)'ed memory to be client accessible, so we have to
+       make it inaccessible again before allowing Valgrind's malloc to
+       use it, lest assertions fail later. */
+    mc_make_noaccess((Addr)state->virtualStack, state->virtualStackByteSize);
+    VG_(free)(state->virtualStack);
+    state->virtualStack = 0;
+  }
+  if (state->locListParams) {
+    // Values saved by snapshotLocListParams() were given A and V bits
+    mc_make_noaccess((Addr)state->locListParams,
+                     state->func->numLocListParams * sizeof(LocListParamSnapshot));
+    VG_(free)(state->locListParams);
+    state->locListParams = 0;
+  }
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Formal parameters with location lists                ---*/
+/*------------------------------------------------------------*/
+
+// Return the entry of var's location list that covers pc, or 0 if
+// there is none (i.e., the parameter has been optimized away there).
+// Like the frame base code in enter_function(), this compares the
+// entries' ranges both to pc relative to the compilation unit and to
+// pc itself (as a link-time address, see relocateAllFjalarData()).
+static location_list* findLocationListEntry(VariableEntry* var,
+                                            FunctionEntry* f, Addr pc) {
+  location_list* ll;
+  Addr cuPC = pc - f->cuBase;
+  Addr linkPC = pc - fjalar_load_bias;
+
+  if (var->locListCacheEntry && (var->locListCachePC == pc)) {
+    return var->locListCacheEntry;
+  }
+
+  if (!gencontains(loc_list_map, (void *)var->locListOffset)) {
+    return 0;
+  }
+
+  ll = gengettable(loc_list_map, (void *)var->locListOffset);
+  while (ll &&
+         !(((ll->begin <= cuPC) && (cuPC < ll->end)) ||
+           ((ll->begin <= linkPC) && (linkPC < ll->end)))) {
+    ll = ll->next;
+  }
+
+  var->locListCachePC = pc;
+  var->locListCacheEntry = ll;
+  return ll;
+}
+
+// What evaluateLocationExpression() found
+typedef enum {
+  LOC_UNKNOWN,  // Unsupported or malformed expression
+  LOC_MEMORY,   // The variable is in memory at the resulting address
+  LOC_VALUE     // The result is the variable's value itself
+} LocationKind;
+
+// Evaluate the location expression of location list entry ll for
+// thread tid, with frame_ptr as the frame base, leaving the result in
+// *result.  If the result is the contents of a register, *regOffset
+// is set to where that register is in the guest state, and otherwise
+// to -1.  Only the operations that GCC commonly uses for the
+// formal parameters of optimized code are supported; anything else
+// (DW_OP_piece, DW_OP_entry_value, registers outside of get_reg[],
+// etc.) gives LOC_UNKNOWN.
+static LocationKind evaluateLocationExpression(location_list* ll, ThreadId tid,
+                                               Addr frame_ptr, Addr* result,
+                                               Int* regOffset) {
+  const unsigned int numRegs = sizeof(get_reg) / sizeof(get_reg[0]);
+  Addr stack[MAX_DWARF_OPS];
+  int depth = 0;
+  unsigned int i, reg;
+
+  *regOffset = -1;
+
+  if ((ll->expr_size == 0) || (ll->expr_size > MAX_DWARF_OPS)) {
+    return LOC_UNKNOWN;
+  }
+
+  for (i = 0; i < ll->expr_size; i++) {
+    unsigned int op = ll->expr[i].atom;
+    long long operand = ll->expr[i].atom_offset;
+    Bool last = (i + 1 == ll->expr_size);
+
+    // Every expression has at most MAX_DWARF_OPS operations, so there
+    // is always room on the stack for one more value.
+    if ((op >= DW_OP_reg0) && (op <= DW_OP_reg31)) {
+      // The value is in a register (which must be all there is)
+      reg = op - DW_OP_reg0;
+      if (!last || (reg >= numRegs) || !get_reg[reg]) {
+        return LOC_UNKNOWN;
+      }
+      *result = (*get_reg[reg])(tid);
+      *regOffset = get_reg_guest_offset[reg];
+      return LOC_VALUE;
+    } else if ((op >= DW_OP_breg0) && (op <= DW_OP_breg31)) {
+      reg = op - DW_OP_breg0;
+      if ((reg >= numRegs) || !get_reg[reg]) {
+        return LOC_UNKNOWN;
+      }
+      stack[depth++] = (*get_reg[reg])(tid) + operand;
+    } else if ((op >= DW_OP_lit0) && (op <= DW_OP_lit31)) {
+      stack[depth++] = op - DW_OP_lit0;
+    } else {
+      switch (op) {
+      case DW_OP_addr:
+        // Link-time address (see relocateAllFjalarData())
+        stack[depth++] = operand + fjalar_load_bias;
+        break;
+      case DW_OP_const1u:
+      case DW_OP_const1s:
+      case DW_OP_const2u:
+      case DW_OP_const2s:
+      case DW_OP_const4u:
+      case DW_OP_const4s:
+      case DW_OP_constu:
+      case DW_OP_consts:
+        stack[depth++] = operand;
+        break;
+      case DW_OP_fbreg:
+        stack[depth++] = frame_ptr + operand;
+        break;
+      case DW_OP_plus_uconst:
+        if (depth < 1) return LOC_UNKNOWN;
+        stack[depth - 1] += operand;
+        break;
+      case DW_OP_plus:
+        if (depth < 2) return LOC_UNKNOWN;
+        stack[depth - 2] += stack[depth - 1];
+        depth--;
+        break;
+      case DW_OP_minus:
+        if (depth < 2) return LOC_UNKNOWN;
+        stack[depth - 2] -= stack[depth - 1];
+        depth--;
+        break;
+      case DW_OP_deref:
+        if ((depth < 1) ||
+            !VG_(am_is_valid_for_client)(stack[depth - 1], sizeof(Addr),
+                                         VKI_PROT_READ)) {
+          return LOC_UNKNOWN;
+        }
+        stack[depth - 1] = *(Addr *)stack[depth - 1];
+        break;
+      case DW_OP_stack_value:
+        if (!last || (depth < 1)) return LOC_UNKNOWN;
+        *result = stack[depth - 1];
+        return LOC_VALUE;
+      default:
+        FJALAR_DPRINTF("\tUnsupported DWARF location list OP: %s\n",
+                       location_expression_to_string(op));
+        return LOC_UNKNOWN;
+      }
+    }
+  }
+
+  if (depth < 1) {
+    return LOC_UNKNOWN;
+  }
+  *result = stack[depth - 1];
+  return LOC_MEMORY;
+}
+
+// Save where each of f's formal parameters with a location list is at
+// its entrance, so that the tool sees the same (entry) values at both
+// entrance and exit.  Call this after the virtual stack is set up.
+static void snapshotLocListParams(FunctionExecutionState* state,
+                                  ThreadId tid) {
+  FunctionEntry* f = state->func;
+  // Where we are now, which is where the location lists must be looked
+  // up (enter_function() is called with the guest IP up to date)
+  Addr pc = VG_(get_IP)(tid);
+  VarNode* n;
+
+  state->locListParams =
+    VG_(calloc)("fjalar_main.c: snapshotLocListParams",
+                f->numLocListParams, sizeof(LocListParamSnapshot));
+
+  for (n = f->formalParameters.first; n; n = n->next) {
+    VariableEntry* var = n->var;
+    LocListParamSnapshot* snapshot;
+    location_list* ll;
+    Addr result = 0;
+    Int regOffset = -1;
+    LocationKind kind = LOC_UNKNOWN;
+
+    if (!var || !var->hasLocList) {
+      continue;
+    }
+
+    tl_assert(var->locListSlot < f->numLocListParams);
+    snapshot = &state->locListParams[var->locListSlot];
+    snapshot->loc = (Addr)&snapshot->value;
+
+    ll = findLocationListEntry(var, f, pc);
+    if (ll) {
+      kind = evaluateLocationExpression(ll, tid, state->FP, &result,
+                                        &regOffset);
+    }
+
+    FJALAR_DPRINTF("\t[snapshotLocListParams] %s: entry %p, kind %d, result %p\n",
+                   var->name, (void *)ll, (int)kind, (void *)result);
+
+    if (kind == LOC_VALUE) {
+      snapshot->value = result;
+      if (regOffset >= 0) {
+        // Like the return value in exit_function(), keep the register's
+        // V bits and tag along with its value
+        UChar vbits[sizeof(Addr)];
+        UInt i;
+
+        VG_(get_shadow_regs_area)(tid, vbits, 1/*shadowNo*/,
+                                  regOffset, sizeof(Addr));
+        for (i = 0; i < sizeof(Addr); i++) {
+          set_abit_and_vbyte((Addr)&snapshot->value + i, VGM_BIT_VALID,
+                             vbits[i]);
+        }
+        if (kvasir_with_dyncomp) {
+          UInt tag = *VG_(get_tag_ptr_for_guest_offset)(tid, regOffset);
+          for (i = 0; i < sizeof(Addr); i++) {
+            set_tag((Addr)&snapshot->value + i, tag);
+          }
+        }
+      } else {
+        // A computed value (DW_OP_stack_value)
+        MC_(make_mem_defined)((Addr)&snapshot->value, sizeof(snapshot->value));
+      }
+    } else if (kind == LOC_MEMORY) {
+      snapshot->locGuest = result;
+      if ((result >= f->guestStackStart) && (result < f->guestStackEnd)) {
+        snapshot->loc = f->lowestVirtSP + (result - f->guestStackStart);
+      } else {
+        snapshot->loc = result;
+      }
+    }
+  }
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Tracing windows                                      ---*/
+/*------------------------------------------------------------*/
+
+// Has any tracing window been opened yet?
+static Bool trace_window_ever_opened = False;
+
+// Function entries left until we next look at --trace-control-file
+static int trace_control_countdown = 0;
+
+// Mark all invocations currently on any thread's stack as untraced
+// so that exits from a window that has been closed are not passed on
+// to the tool (and don't end up in the next segment).
+static void untrace_active_invocations(void) {
+  ThreadId tid;
+  int i;
+
+  for (tid = 0; tid < VG_N_THREADS; tid++) {
+    for (i = 0; i < fnStackDepth(tid); i++) {
+      fnStackGet(tid, i)->untraced = True;
+    }
+  }
+}
+
+void fjalar_start_tracing(void) {
+  if (fjalar_tracing_window_open) {
+    return;
+  }
+
+  if (trace_window_ever_opened) {
+    fjalar_trace_segment++;
+  }
+  trace_window_ever_opened = True;
+  fjalar_tracing_window_open = True;
+
+  FJALAR_DPRINTF("[fjalar_start_tracing] segment %u\n", fjalar_trace_segment);
+  fjalar_tool_trace_window_opened(fjalar_trace_segment);
+}
+
+void fjalar_stop_tracing(void) {
+  if (!fjalar_tracing_window_open) {
+    return;
+  }
+
+  untrace_active_invocations();
+  fjalar_tracing_window_open = False;
+
+  FJALAR_DPRINTF("[fjalar_stop_tracing] segment %u\n", fjalar_trace_segment);
+  fjalar_tool_trace_window_closed(fjalar_trace_segment);
+}
+
+void fjalar_rotate_trace(void) {
+  fjalar_stop_tracing();
+  fjalar_start_tracing();
+}
+
+// Carry out the command ("start", "stop", "rotate", "stats" or
+// "checkpoint") in the
+// --trace-control-file, if that file exists, and then remove the
+// file so that the command is only carried out once.  (To avoid
+// reading a partially written command, create the file under another
+// name and then rename it.)
+static void poll_trace_control_file(void) {
+  HChar command[16];
+  SysRes sr;
+  Int fd, n;
+
+  trace_control_countdown = fjalar_trace_control_interval;
+
+  sr = VG_(open)(fjalar_trace_control_filename, VKI_O_RDONLY, 0);
+  if (sr_isError(sr)) {
+    return;
+  }
+  fd = sr_Res(sr);
+  n = VG_(read)(fd, command, sizeof(command) - 1);
+  VG_(close)(fd);
+  VG_(unlink)(fjalar_trace_control_filename);
+
+  while (n > 0 && VG_(isspace)(command[n - 1])) {
+    n--;
+  }
+  command[n > 0 ? n : 0] = '\0';
+
+  if (VG_STREQ(command, "start")) {
+    fjalar_start_tracing();
+  }
+  else if (VG_STREQ(command, "stop")) {
+    fjalar_stop_tracing();
+  }
+  else if (VG_STREQ(command, "rotate")) {
+    fjalar_rotate_trace();
+  }
+  else if (VG_STREQ(command, "stats")) {
+    fjalar_tool_dump_stats();
+  }
+  else if (VG_STREQ(command, "checkpoint")) {
+    fjalar_tool_checkpoint();
+  }
+  else {
+    printf("Ignoring unknown command in %s: %s\n",
+           fjalar_trace_control_filename, command);
+  }
+}
+
+// Handles the client requests in fjalar.h (called from
+// mc_handle_client_request() in mc_main.c)
+Bool fjalar_handle_client_request(ThreadId tid, UWord* arg, UWord* ret) {
+  switch (arg[0]) {
+  case VG_USERREQ__FJALAR_START_TRACING:
+    fjalar_start_tracing();
+    break;
+  case VG_USERREQ__FJALAR_STOP_TRACING:
+    fjalar_stop_tracing();
+    break;
+  case VG_USERREQ__FJALAR_ROTATE_TRACE:
+    fjalar_rotate_trace();
+    break;
+  case VG_USERREQ__FJALAR_DUMP_STATS:
+    fjalar_tool_dump_stats();
+    break;
+  case VG_USERREQ__FJALAR_CHECKPOINT:
+    fjalar_tool_checkpoint();
+    break;
+  default:
+    return False;
+  }
+
+  *ret = 0;
+  return True;
+}
+
+
 static UInt cur_nonce = 0;
+
+// With fjalar_per_thread_nonces, each thread's next nonce, indexed by
+// ThreadId.  These are kept apart from fnStacks[] (which are freed
+// when a thread exits) so that a later thread that reuses a ThreadId
+// carries on where the earlier one left off rather than repeating its
+// nonces.  Never freed.
+static UInt* thread_next_nonce = 0;
+
+// The nonce for a new invocation on thread tid's stack
+static __inline__ UInt newInvocationNonce(ThreadId tid) {
+  if (fjalar_per_thread_nonces) {
+    return thread_next_nonce[tid]++;
+  }
+  return cur_nonce++;
+}
+
 /*
 This is the hook into Valgrind that is called whenever the target
 program enters a function.  Pushes an entry onto the top of
@@ -513,7 +1114,26 @@ void enter_function(FunctionEntry* f)
   ThreadId tid = VG_(get_running_tid)();
   Addr stack_ptr= VG_(get_SP)(tid);
   Addr frame_ptr = 0; /* E.g., %ebp */
-  int local_stack, size;
+  int local_stack, size, fp_offset;
+  Addr snapshot_start;
+
+  if (fjalar_trace_control_filename &&
+      --trace_control_countdown <= 0) {
+    poll_trace_control_file();
+  }
+
+  // A stale translation of a retired function is still around, or no
+  // tracing window is open; push a placeholder so that this
+  // invocation's exit can be matched up, but don't bother the tool
+  // with it.
+  if (f->retired || !fjalar_tracing_window_open) {
+    newEntry = fnStackPush(tid);
+    VG_(memset)(newEntry, 0, sizeof(*newEntry));
+    newEntry->func = f;
+    newEntry->untraced = True;
+    newEntry->invocation_nonce = newInvocationNonce(tid);
+    return;
+  }
 
   FJALAR_DPRINTF("[enter_function] startPC is: %x, entryPC is: %x, cu_base: %p\n",
                  (UInt)f->startPC, (UInt)f->entryPC,(void *)f->cuBase);
@@ -542,6 +1162,9 @@ void enter_function(FunctionEntry* f)
 
   if (f->frame_base_atom != 0) {
     Addr eip = f->entryPC;
+    // The location list's addresses are link-time ones (see
+    // relocateAllFjalarData()):
+    Addr linkEntryPC = f->entryPC - fjalar_load_bias;
     eip =  eip - f->cuBase;
     FJALAR_DPRINTF("\tCurrent EIP is: %x\n", (UInt)eip);
 
@@ -561,7 +1184,7 @@ void enter_function(FunctionEntry* f)
         // where the compilation unit offset is a valid address in the program
         while(ll &&
               !(((ll->begin <= eip) && (ll->end >= eip)) ||
-                ((ll->begin <= f->entryPC) && (ll->end >= f->entryPC)))) {
+                ((ll->begin <= linkEntryPC) && (ll->end >= linkEntryPC)))) {
           FJALAR_DPRINTF("\tExamining loc list entry: %x - %x - %x\n", (UInt)ll->offset, (UInt)ll->begin, (UInt)ll->end);
           ll = ll->next;
         }
@@ -620,7 +1243,9 @@ void enter_function(FunctionEntry* f)
   newEntry->xAX = 0;
   newEntry->xDX = 0;
   newEntry->FPU = 0;
-  newEntry->invocation_nonce = cur_nonce++;
+  newEntry->toolData = 0;
+  newEntry->untraced = False;
+  newEntry->invocation_nonce = newInvocationNonce(tid);
   newEntry->func->nonce = newEntry->invocation_nonce;
 
   // FJALAR VIRTUAL STACK
@@ -648,22 +1273,35 @@ void enter_function(FunctionEntry* f)
   // Let's be conservative in how much we copy over to the Virtual stack. Due to the
   // stack alignment operations in main, we may need  as much as 16 bytes over the above.
   size = local_stack + f->formalParamStackByteSize + sizeof(Addr)*2 + 32;/* plus stuff in caller's*/
+  snapshot_start = stack_ptr - VG_STACK_REDZONE_SZB;
+  fp_offset = local_stack;
   FJALAR_DPRINTF("local_stack: %p, arg_size: %d\n", (void *)(frame_ptr - f->formalParamLowerStackByteSize),
                                                     f->formalParamLowerStackByteSize);
   int delta = stack_ptr - (frame_ptr - f->formalParamLowerStackByteSize);
   if (delta < 0 )
       delta = 0;
 
+  // Only the formal parameters are read back out of the virtual
+  // stack, so if we know exactly where they are (see
+  // determineFormalParametersSnapshotRange()), copy just those bytes
+  // (and their A/V bits and tags) rather than the whole frame. The
+  // virtual stack still maps onto the guest stack at a fixed offset,
+  // so reading it back works just the same.
+  if (f->formalParamSnapshotExact) {
+    snapshot_start = frame_ptr + f->formalParamSnapshotLow;
+    size = f->formalParamSnapshotHigh - f->formalParamSnapshotLow;
+    fp_offset = -f->formalParamSnapshotLow;
+  }
+
   tl_assert(size >= 0);
   if (size != 0) {
     newEntry->virtualStack = VG_(calloc)("fjalar_main.c: enter_func",  size, sizeof(char));
     newEntry->virtualStackByteSize = size;
-    newEntry->virtualStackFPOffset = local_stack;
+    newEntry->virtualStackFPOffset = fp_offset;
 
     clear_all_tags_in_range(stack_ptr - VG_STACK_REDZONE_SZB, VG_STACK_REDZONE_SZB - delta);
 
-    VG_(memcpy)(newEntry->virtualStack,
-		(char*)stack_ptr - VG_STACK_REDZONE_SZB, size);
+    VG_(memcpy)(newEntry->virtualStack, (char*)snapshot_start, size);
 
     // VERY IMPORTANT!!! Copy all the A & V bits over the real stack to
     // virtualStack!!!  (As a consequence, this copies over the tags
@@ -672,12 +1310,12 @@ void enter_function(FunctionEntry* f)
     // VG_(calloc)ed address, which is a bit weird. It would be more
     // elegant to copy the metadata to an inaccessible place, but that
     // would be more work.
-    FJALAR_DPRINTF("Copying over stack [%p] -> [%p] %d bytes\n",(void *)(stack_ptr - VG_STACK_REDZONE_SZB),  (void *)newEntry->virtualStack, size);
-    mc_copy_address_range_state(stack_ptr - VG_STACK_REDZONE_SZB,
+    FJALAR_DPRINTF("Copying over stack [%p] -> [%p] %d bytes\n",(void *)snapshot_start,  (void *)newEntry->virtualStack, size);
+    mc_copy_address_range_state(snapshot_start,
 				(Addr)(newEntry->virtualStack), size);
 
 
-    newEntry->func->guestStackStart = stack_ptr - VG_STACK_REDZONE_SZB;
+    newEntry->func->guestStackStart = snapshot_start;
     newEntry->func->guestStackEnd = newEntry->func->guestStackStart + size;
     newEntry->func->lowestVirtSP = (Addr)newEntry->virtualStack;
 
@@ -688,6 +1326,12 @@ void enter_function(FunctionEntry* f)
   }
 
 
+  newEntry->locListParams = 0;
+  if (f->numLocListParams > 0) {
+    snapshotLocListParams(newEntry, tid);
+  }
+  newEntry->func->locListParams = newEntry->locListParams;
+
   // Do this AFTER initializing virtual stack and lowestSP
   curFunctionExecutionStatePtr = newEntry;
   fjalar_tool_handle_function_entrance(newEntry);
@@ -713,11 +1357,19 @@ void exit_function(FunctionEntry* f)
 
   FJALAR_DPRINTF("Exit function: %s\n", f->fjalar_name);
 
-  top->func->guestStackStart = top->lowSP - VG_STACK_REDZONE_SZB;
+  // The only invocations of a retired function that we still care
+  // about are those that are on the stack:
+  if (f->retired && !function_is_active(f)) {
+    discard_retired_function(f);
+    return;
+  }
+
+  top->func->guestStackStart = top->FP - top->virtualStackFPOffset;
   top->func->guestStackEnd = top->func->guestStackStart + top->virtualStackByteSize;
   top->func->lowestVirtSP = (Addr)top->virtualStack;
+  top->func->locListParams = top->locListParams;
   top->func->FP  = top->FP;
-  top->func->lowestSP  = top->func->guestStackStart;
+  top->func->lowestSP  = top->lowSP - VG_STACK_REDZONE_SZB;
 
   FJALAR_DPRINTF("\tState of Guest Stack [%p - %p] \n", (void *)top->lowestSP, (void *)(top->lowestSP + top->virtualStackByteSize));
 
@@ -798,8 +1450,8 @@ void exit_function(FunctionEntry* f)
     // This is probably being overconservative. However let's revert
     // to Fjalar's old behavior (do nothing) if we can't find an
     // instance of our function in the function stack.
-    for(i = fn_stack_first_free_index[currentTID] - 1; i >= 0; i-- ) {
-      FunctionExecutionState* curFuncExecPtr = &FunctionExecutionStateStack[currentTID][i];
+    for(i = fnStackDepth(currentTID) - 1; i >= 0; i-- ) {
+      FunctionExecutionState* curFuncExecPtr = fnStackGet(currentTID, i);
       if(curFuncExecPtr->func == f) {
         foundFunc = True;
         break;
@@ -822,6 +1474,18 @@ void exit_function(FunctionEntry* f)
     tl_assert(top->func == f);
   }
 
+  // Invocations that started after f was retired or outside of a
+  // tracing window were never shown to the tool (or were entered in a
+  // window that has since been closed), so just pop them:
+  if (top->untraced) {
+    freeVirtualStack(top);
+    fnStackPop(currentTID);
+    if (f->retired) {
+      discard_retired_function(f);
+    }
+    return;
+  }
+
   top->xAX = xAX;
   top->xDX = xDX;
   top->FPU = fpuReturnVal;
@@ -850,15 +1514,7 @@ void exit_function(FunctionEntry* f)
 
   // Destroy the memory allocated by virtualStack
   // AFTER the tool has handled the exit
-  if (top->virtualStack) {
-    /* We were previously using the V bits associated with the area to
-       store guest V bits, but Memcheck doesn't normally expect
-       VG_(malloc)'ed memory to be client accessible, so we have to
-       make it inaccessible again before allowing Valgrind's malloc to
-       use it, lest assertions fail later. */
-    mc_make_noaccess((Addr)top->virtualStack, top->virtualStackByteSize);
-    VG_(free)(top->virtualStack);
-  }
+  freeVirtualStack(top);
 
   // Pop at the VERY end after the tool is done handling the exit.
   // This is subtle but important - this must be done AFTER the tool
@@ -869,8 +1525,68 @@ void exit_function(FunctionEntry* f)
   // program points to be printed.
   fnStackPop(currentTID);
 
+  if (f->retired) {
+    discard_retired_function(f);
+  }
 }
 
+// With --trace-library, the model is built at startup from the
+// library's own file, so all of its addresses are link-time ones.
+// This is called for every new mapping; once the core has read the
+// debug info of a mapping of the library, we move the model to where
+// the library actually got loaded.  This costs a pass over the
+// functions and globals of the library, not another DWARF read.
+void fjalar_new_mem_mmap(Addr a, ULong di_handle) {
+  const DebugInfo* di;
+  const HChar* filename;
+  FuncIterator* funcIt;
+  PtrdiffT bias;
+  (void)a;
+
+  if (!trace_library_basename || di_handle == 0) {
+    return;
+  }
+
+  // The new DebugInfo is usually at the head of the list
+  for (di = VG_(next_DebugInfo)(0); di; di = VG_(next_DebugInfo)(di)) {
+    if (VG_(DebugInfo_get_handle)(di) == di_handle) {
+      break;
+    }
+  }
+
+  if (!di) {
+    return;
+  }
+
+  filename = VG_(DebugInfo_get_filename)(di);
+  if (!filename || !VG_STREQ(VG_(basename)(filename), trace_library_basename)) {
+    return;
+  }
+
+  bias = VG_(DebugInfo_get_text_bias)(di);
+  if (bias == fjalar_load_bias) {
+    trace_library_mapped = True;
+    return;
+  }
+
+  FJALAR_DPRINTF("[fjalar_new_mem_mmap] %s loaded with bias %#lx\n",
+                 VG_(DebugInfo_get_filename)(di), (unsigned long)bias);
+
+  // If the library was loaded before somewhere else, forget about the
+  // entry points that we found in the translations of its old copy:
+  funcIt = newFuncIterator();
+  while (hasNextFunc(funcIt)) {
+    FunctionEntry* f = nextFunc(funcIt);
+    if (gencontains(funcs_handled, f)) {
+      genfreekey(funcs_handled, f);
+      forget_entry_point(f);
+    }
+  }
+  deleteFuncIterator(funcIt);
+
+  relocateAllFjalarData(bias - fjalar_load_bias);
+  trace_library_mapped = True;
+}
 
 /*------------------------------------------------------------*/
 /*--- Command line processing                              ---*/
@@ -975,12 +1691,13 @@ static void outputAuxiliaryFilesAndExit(void) {
 // This is called before command-line options are processed
 void fjalar_pre_clo_init()
 {
-   fn_stack_first_free_index = VG_(malloc)("fjalar_main.c: fjalar_pre_clo_init1", VG_N_THREADS * sizeof fn_stack_first_free_index[0]);
-   FunctionExecutionStateStack = VG_(malloc)("fjalar_main.c: fjalar_pre_clo_init2", VG_N_THREADS * FN_STACK_SIZE * sizeof FunctionExecutionStateStack[0][0]);
-
-  // Clear FunctionExecutionStateStack
-/*   VG_(memset)(FunctionExecutionStateStack, 0, */
-/* 	      FN_STACK_SIZE * sizeof(*FunctionExecutionStateStack)); */
+  // The stacks themselves are only allocated for threads that enter
+  // a traced function (see fnStackPush()):
+  fnStacks = VG_(calloc)("fjalar_main.c: fjalar_pre_clo_init",
+                         VG_N_THREADS, sizeof(fnStacks[0]));
+  thread_next_nonce = VG_(calloc)("fjalar_main.c: fjalar_pre_clo_init",
+                                  VG_N_THREADS, sizeof(thread_next_nonce[0]));
+  VG_(track_pre_thread_ll_exit)(fnStackFree);
 
   // (comment added 2005)
   // TODO: Do we need to clear all global variables before processing
@@ -1043,7 +1760,26 @@ void fjalar_post_clo_init()
   FJALAR_DPRINTF("Typedata structures completed\n");
 
   // Calls into readelf.c:
-  process_elf_binary_data(executable_filename);
+  // (With --trace-library, we read the library instead of the program
+  //  and relocate the result when it gets loaded; see
+  //  fjalar_new_mem_mmap())
+  if (fjalar_trace_library) {
+    FILE* library_fp = fopen(fjalar_trace_library, "r");
+    if (!library_fp) {
+      printf( "\nError: \"%s\" is an invalid filename for the shared library specified by the --trace-library option.\n\nExiting.\n\n",
+                   fjalar_trace_library);
+
+      VG_(exit)(1);
+    }
+    fclose(library_fp);
+
+    trace_library_basename =
+      VG_(strdup)("fjalar_main.c: fj_po_clo_init.2", VG_(basename)(fjalar_trace_library));
+    process_elf_binary_data(fjalar_trace_library);
+  }
+  else {
+    process_elf_binary_data(executable_filename);
+  }
 
   FJALAR_DPRINTF("Process elf binary completed\n");
   // Call this BEFORE initializeAllFjalarData() so that the vars_tree
@@ -1062,6 +1798,16 @@ void fjalar_post_clo_init()
   outputAuxiliaryFilesAndExit();
 
   FJALAR_DPRINTF("Files output\n");
+
+  // Call this AFTER handleDisambigFile(), whose entries change which
+  // variables get derived:
+  if (fjalar_trace_vars_filename) {
+    compileVarSelections();
+  }
+
+  fjalar_tracing_window_open = fjalar_trace_from_start;
+  trace_window_ever_opened = fjalar_trace_from_start;
+
   // Make sure to execute this last!
   fjalar_tool_post_clo_init();
   FJALAR_DPRINTF("Tool clo initialized\n");
@@ -1083,6 +1829,17 @@ void fjalar_print_usage()
 "    --ignore-static-vars     Ignores all static variables [--no-ignore-static-vars]\n"
 "    --ignore-constants       Ignores all constant variables [--no-ignore-constants]\n"
 "    --all-static-vars        Output all static vars [--no-all-static-vars]\n"
+"    --trace-library=<string> Trace the functions of this shared library (which\n"
+"                             may be loaded with dlopen) instead of the program\n"
+"                             (only one shared library can be traced at a time)\n"
+
+"\n  Tracing windows (see fjalar.h):\n"
+"    --trace-from-start       Trace from the start of the program [--trace-from-start]\n"
+"                             (--no-trace-from-start waits for a start command)\n"
+"    --trace-control-file=<string>  Read start/stop/rotate/stats/checkpoint commands\n"
+"                             from this file\n"
+"    --trace-control-interval=N     Look for the control file every N function\n"
+"                             entries (default is 10000)\n"
 
 "\n  Pointer type disambiguation:\n"
 "    --disambig-file=<string> Reads in disambig file if exists; otherwise creates one\n"
@@ -1139,8 +1896,11 @@ Bool fjalar_process_cmd_line_option(const HChar* arg)
   else if VG_YESNO_CLO(arg, "flatten-arrays", fjalar_flatten_arrays) {}
   else if VG_YESNO_CLO(arg, "func-disambig-ptrs", fjalar_func_disambig_ptrs) {}
   else if VG_YESNO_CLO(arg, "disambig-ptrs", fjalar_disambig_ptrs) {}
+  else if VG_YESNO_CLO(arg, "trace-from-start", fjalar_trace_from_start) {}
   else if VG_BINT_CLO(arg, "--array-length-limit", fjalar_array_length_limit,
 		      -1, 0x7fffffff) {}
+  else if VG_BINT_CLO(arg, "--trace-control-interval",
+		      fjalar_trace_control_interval, 1, 0x7fffffff) {}
 
   /* else if VG_BINT_CLO(arg, "--struct-depth",  fjalar_max_visit_struct_depth, 0, 100)  {} // [0 to 100]
      else if VG_BINT_CLO(arg, "--nesting-depth", fjalar_max_visit_nesting_depth, 0, 100) {} // [0 to 100] */
@@ -1154,6 +1914,9 @@ Bool fjalar_process_cmd_line_option(const HChar* arg)
   else if VG_STR_CLO(arg, "--var-list-file",  fjalar_trace_vars_filename) {}
   else if VG_STR_CLO(arg, "--disambig-file",  fjalar_disambig_filename) {}
   else if VG_STR_CLO(arg, "--xml-output-file", fjalar_xml_output_filename) {}
+  else if VG_STR_CLO(arg, "--trace-control-file",
+		     fjalar_trace_control_filename) {}
+  else if VG_STR_CLO(arg, "--trace-library",  fjalar_trace_library) {}
   else
     return fjalar_tool_process_cmd_line_option(arg);
 
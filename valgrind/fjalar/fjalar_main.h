@@ -89,39 +89,109 @@ void fjalar_post_clo_init(void);
 void fjalar_finish(void);
 void fjalar_print_usage(void);
 Bool fjalar_process_cmd_line_option(const HChar* arg);
+Bool fjalar_handle_client_request(ThreadId tid, UWord* arg, UWord* ret);
+void fjalar_new_mem_mmap(Addr a, ULong di_handle);
 
 void printFunctionEntryStack(void);
 
-// The stack should never grow this deep!
-#define FN_STACK_SIZE 1000
+// The function execution stack of each thread.  It is allocated when
+// the thread first enters a traced function and is made up of
+// segments that are allocated as the stack grows: segment k holds
+// FN_STACK_FIRST_SEGMENT_SIZE << k entries, so a stack never needs
+// more than a couple of times as much memory as its deepest point,
+// and entries never move once they have been pushed (so pointers to
+// them stay valid while they are on the stack).
+#define FN_STACK_FIRST_SEGMENT_SIZE 64
+#define FN_STACK_MAX_SEGMENTS 24
+
+typedef struct {
+  int size;        // The number of entries on the stack
+  // The segment that holds the top entry (segment 0 if the stack is
+  // empty), the index of its first entry, and its number of entries:
+  int seg;
+  int segStart;
+  int segSize;
+  FunctionExecutionState* top; // The top entry (if size > 0)
+  FunctionExecutionState* segments[FN_STACK_MAX_SEGMENTS];
+} FunctionExecutionStateStack;
+
+// Indexed by ThreadId; 0 for threads that have no stack yet:
+FunctionExecutionStateStack** fnStacks;
+
+// Returned by fnStackTop() for an empty stack.  Its func is always 0,
+// which is how callers can tell that the stack is empty.
+FunctionExecutionState fnStackEmptyEntry;
+
+// Out-of-line parts of the stack operations (in fjalar_main.c):
+FunctionExecutionStateStack* fnStackCreate(ThreadId tid);
+void fnStackNextSegment(FunctionExecutionStateStack* stack);
+
+// Returns the number of entries on the stack of thread tid
+static __inline__ int fnStackDepth(ThreadId tid) {
+  FunctionExecutionStateStack* stack = fnStacks[tid];
+  return stack ? stack->size : 0;
+}
 
-typedef FunctionExecutionState FunctionExecutionStateStack1d[FN_STACK_SIZE];
-FunctionExecutionStateStack1d *FunctionExecutionStateStack;
-int *fn_stack_first_free_index;
+// Returns entry i (counting from the bottom, 0 <= i < fnStackDepth())
+// of the stack of thread tid
+FunctionExecutionState* fnStackGet(ThreadId tid, int i);
 
 // "Pushes" a new entry onto the stack by returning a pointer to it
-// and incrementing fn_stack_first_free_index (Notice that this has
-// slightly has different semantics than a normal stack push)
+// (Notice that this has slightly has different semantics than a
+// normal stack push)
 static __inline__ FunctionExecutionState* fnStackPush(ThreadId tid) {
+  FunctionExecutionStateStack* stack;
+
   tl_assert(tid != VG_INVALID_THREADID);
-  tl_assert(fn_stack_first_free_index[tid] < FN_STACK_SIZE);
-  fn_stack_first_free_index[tid]++;
-  return &(FunctionExecutionStateStack[tid][fn_stack_first_free_index[tid] - 1]);
+  stack = fnStacks[tid];
+  if (!stack) {
+    stack = fnStackCreate(tid);
+  }
+
+  if (stack->size == stack->segStart + stack->segSize) {
+    fnStackNextSegment(stack);
+  }
+
+  stack->top = &stack->segments[stack->seg][stack->size - stack->segStart];
+  stack->size++;
+  return stack->top;
 }
 
 // Returns the top element of the stack and pops it off
 static __inline__ FunctionExecutionState* fnStackPop(ThreadId tid) {
+  FunctionExecutionStateStack* stack;
+  FunctionExecutionState* popped;
+
   tl_assert(tid != VG_INVALID_THREADID);
-  tl_assert(fn_stack_first_free_index[tid] > 0);
-  fn_stack_first_free_index[tid]--;
-  return &(FunctionExecutionStateStack[tid][fn_stack_first_free_index[tid]]);
+  stack = fnStacks[tid];
+  tl_assert(stack && stack->size > 0);
+
+  popped = stack->top;
+  stack->size--;
+
+  if (stack->size > 0) {
+    if (stack->size - 1 < stack->segStart) {
+      stack->seg--;
+      stack->segSize >>= 1;
+      stack->segStart -= stack->segSize;
+    }
+    stack->top = &stack->segments[stack->seg][stack->size - 1 - stack->segStart];
+  }
+
+  return popped;
 }
 
-// Returns the top element of the stack
+// Returns the top element of the stack (fnStackEmptyEntry if the
+// stack is empty)
 static __inline__ FunctionExecutionState* fnStackTop(ThreadId tid) {
+  FunctionExecutionStateStack* stack;
+
   tl_assert(tid != VG_INVALID_THREADID);
-  tl_assert(fn_stack_first_free_index[tid] >= 0);
-  return &(FunctionExecutionStateStack[tid][fn_stack_first_free_index[tid] - 1]);
+  stack = fnStacks[tid];
+  if (!stack || stack->size == 0) {
+    return &fnStackEmptyEntry;
+  }
+  return stack->top;
 }
 
 /*
@@ -156,7 +226,7 @@ This is called from hooks within mac_shared.h
 #define CHECK_SP(currentSP)                                           \
   ThreadId tid = VG_(get_running_tid)();                                \
   FunctionExecutionState* curFunc = fnStackTop(tid);			\
-  if (curFunc &&							\
+  if (curFunc->func &&						\
       (currentSP < curFunc->lowestSP)) {				\
     curFunc->lowestSP = currentSP;					\
   }
@@ -165,7 +235,7 @@ This is called from hooks within mac_shared.h
 #define CHECK_SP_SLOW()                                                \
   ThreadId tid = VG_(get_running_tid)();                                \
   FunctionExecutionState* curFunc = fnStackTop(tid);			\
-  if (curFunc) {							\
+  if (curFunc->func) {							\
     Addr currentSP = VG_(get_SP)(VG_(get_running_tid)());		\
     if (currentSP < curFunc->lowestSP) {				\
       curFunc->lowestSP = currentSP;					\
@@ -62,11 +62,11 @@ FunctionExecutionState* returnFunctionExecutionStateWithAddress(Addr a)
   // Traverse the function stack from the function with
   // the highest ESP to the one with the lowest ESP
   // but DON'T LOOK at the function that's the most
-  // recent one on the stack yet - hence 0 <= i <= (fn_stack_first_free_index - 2)
-  for (i = 0; i <= fn_stack_first_free_index[tid] - 2; i++)
+  // recent one on the stack yet - hence 0 <= i <= (fnStackDepth - 2)
+  for (i = 0; i <= fnStackDepth(tid) - 2; i++)
     {
-      cur_fn = &FunctionExecutionStateStack[tid][i];
-      next_fn = &FunctionExecutionStateStack[tid][i + 1];
+      cur_fn = fnStackGet(tid, i);
+      next_fn = fnStackGet(tid, i + 1);
 
       if (!cur_fn || !next_fn)
         {
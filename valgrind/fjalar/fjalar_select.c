@@ -231,16 +231,17 @@ void initializeVarsTree()
 
 // Returns 1 if the proper function name of cur_entry is found in
 // prog_pts_tree and 0 otherwise.  Always look for cur_entry->fjalar_name.
+// (prog_pts_tree never changes once it has been read in, so the
+// answer is remembered in cur_entry.)
 Bool prog_pts_tree_entry_found(FunctionEntry* cur_entry) {
 
-  if (tfind((void*)cur_entry->fjalar_name,
-            (void**)&prog_pts_tree,
-            compareStrings)) {
-    return 1;
-  }
-  else {
-    return 0;
+  if (!cur_entry->pptListChecked) {
+    cur_entry->inPptList = (tfind((void*)cur_entry->fjalar_name,
+                                  (void**)&prog_pts_tree,
+                                  compareStrings) != 0);
+    cur_entry->pptListChecked = True;
   }
+  return cur_entry->inPptList;
 }
 
 // Compares the function's fjalar names names
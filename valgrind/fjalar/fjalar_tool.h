@@ -99,6 +99,28 @@ void fjalar_tool_finish(void);
 void fjalar_tool_handle_function_entrance(FunctionExecutionState* f_state);
 void fjalar_tool_handle_function_exit(FunctionExecutionState* f_state);
 
+// These functions are called whenever a tracing window is opened or
+// closed (see fjalar.h and the --trace-control-file option).  segment
+// counts the windows opened so far, starting at 0, and the tool
+// should send the output for each window to its own segment.  If
+// tracing is on from the start (the default), window 0 is already
+// open when the program starts and fjalar_tool_trace_window_opened()
+// is not called for it.
+void fjalar_tool_trace_window_opened(UInt segment);
+void fjalar_tool_trace_window_closed(UInt segment);
+
+// This function is called when the program asks for statistics with
+// FJALAR_DUMP_STATS (see fjalar.h) or a "stats" command arrives
+// through --trace-control-file.  The tool should write out whatever
+// statistics it keeps.
+void fjalar_tool_dump_stats(void);
+
+// This function is called when the program asks for a checkpoint with
+// FJALAR_CHECKPOINT (see fjalar.h) or a "checkpoint" command arrives
+// through --trace-control-file.  The tool should save whatever it
+// needs to resume its analysis in a later run.
+void fjalar_tool_checkpoint(void);
+
 
 /*********************************************************************
 Constructors and destructors for classes that can be subclassed:
@@ -114,6 +114,8 @@ void visitSequence(VisitArgs* visit_args);
 
 void visitClassMemberVariables(VisitArgs* args);
 
+static void setVisitedStructCount(TypeEntry* type, UWord count);
+
 // This is an example of a function that's valid to be passed in as
 // the performAction parameter to visitVariable:
 /*
@@ -349,7 +351,7 @@ void visitClassMemberVariables(VisitArgs* args) {
 
     if (count <= fjalar_max_visit_struct_depth) {
       count++;
-      genputtable(VisitedStructsTable, (void*)class, (void*)count);
+      setVisitedStructCount(class, count);
     }
     // PUNT because this struct has appeared more than
     // fjalar_max_visit_struct_depth times during one call to visitVariable()
@@ -359,7 +361,7 @@ void visitClassMemberVariables(VisitArgs* args) {
   }
   // If not found in the table, initialize this entry with 1
   else {
-    genputtable(VisitedStructsTable, (void*)class, (void*)1);
+    setVisitedStructCount(class, 1);
   }
 
   // If we have dereferenced more than fjalar_max_visit_nesting_depth
@@ -421,7 +423,7 @@ void visitClassMemberVariables(VisitArgs* args) {
           if (gencontains(VisitedStructsTable, (void*)(curVar->varType))) {
             UWord count = (UWord)(gengettable(VisitedStructsTable, (void*)(curVar->varType)));
             count--;
-            genputtable(VisitedStructsTable, (void*)(curVar->varType), (void*)count);
+            setVisitedStructCount(curVar->varType, count);
           }
 
           if (isSequence) {
@@ -573,7 +575,7 @@ void visitClassMemberVariables(VisitArgs* args) {
           if (gencontains(VisitedStructsTable, (void*)(curVar->varType))) {
             UWord count = (UWord)(gengettable(VisitedStructsTable, (void*)(curVar->varType)));
             count++;
-            genputtable(VisitedStructsTable, (void*)(curVar->varType), (void*)count);
+            setVisitedStructCount(curVar->varType, count);
           }
 
           // Only free if necessary
@@ -852,6 +854,409 @@ void visitClassMemberVariables(VisitArgs* args) {
   FJALAR_DPRINTF("Exit  visitClassMemberVariables\n");
 }
 
+// Returns 1 if we are interested in visiting this variable and its
+// children, 0 otherwise.  No children of this variable will get
+// visited if this variable is not visited.  For example, if 'foo' is
+// an array, then if the hashcode value of 'foo' is not visited, then
+// the actual array value of 'foo[]' won't be visited either.
+// This performs string matching in trace_vars_tree based on fullFjalarName
+static char interestedInVar(const HChar* fullFjalarName, char* trace_vars_tree) {
+  if (fjalar_trace_vars_filename) {
+    if (trace_vars_tree) {
+      //      printf("Checking if %s is in var list\n", fullFjalarName);
+      if (!tfind((void*)fullFjalarName, (void**)&trace_vars_tree, compareStrings)) {        
+        return 0;
+      }
+      //      printf("Found it\n", fullFjalarName);
+    }
+    // If trace_vars_tree is kept at 0 on purpose but
+    // fjalar_trace_vars_filename is valid, then still punt because we
+    // are only supposed to print out variables listed in
+    // fjalar_trace_vars_filename and obviously there aren't any
+    // relevant variables to print
+    else {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+// With --var-list-file, compileVarSelections() asks interestedInVar()
+// about every variable that can be visited at a program point once,
+// when the model is created.  A variable and the variables derived
+// from it are traversed the same way every time (that only depends
+// on their types and the command-line options), so the answers are
+// kept in a VarSelection for each variable visited by visitVariable(),
+// indexed by the position of each variable in the traversal (counted
+// the same way as g_variableIndex, from 0 for the variable itself).
+// At run time, a traced variable takes one bit test, and a variable
+// none of whose derived variables are traced is skipped along with
+// all of them, without building any of their names.
+typedef struct {
+  TypeEntry* type;       // 0 at the end of a list of these
+  UWord count;
+} VisitedStructCount;
+
+typedef struct _VarSelection {
+  char* trace_vars_tree; // What the answers are for
+  UInt numPositions;
+  UInt capacity;
+  VariableEntry** vars;  // The variable at each position
+  UInt* selected;        // 1 bit per position: is its variable traced?
+  UInt* wanted;          // 1 bit per position: is its variable or one
+                         // derived from it traced?
+  UInt* sizes;           // Positions taken by a variable and the ones
+                         // derived from it
+  // Skipping the variables derived from one that isn't wanted would
+  // leave out what visiting them adds to VisitedStructsTable, which
+  // limits how far later variables get derived.  For each such
+  // position, 1 + the index of the VisitedStructsTable entries as
+  // they are afterwards in structCounts (0 if there are none):
+  UInt* structCountsStart;
+  VisitedStructCount* structCounts;
+  UInt numStructCounts;
+  UInt structCountsCapacity;
+  // The next selection of the same variable, for another trace_vars_tree
+  struct _VarSelection* next;
+} VarSelection;
+
+#define VAR_SELECTION_BIT(bits, pos) (((bits)[(pos) / 32] >> ((pos) % 32)) & 1)
+#define SET_VAR_SELECTION_BIT(bits, pos) ((bits)[(pos) / 32] |= (1U << ((pos) % 32)))
+
+// The selection of the variable being visited (0 if none) and the
+// position of the next variable in it
+static VarSelection* curVarSelection = 0;
+static UInt curVarSelectionPos = 0;
+
+// True while compileVarSelections() is running.  It then also keeps
+// track of the struct types whose counts in VisitedStructsTable change.
+static Bool compilingVarSelections = False;
+static TypeEntry** visitedStructsLog = 0;
+static UInt visitedStructsLogSize = 0;
+static UInt visitedStructsLogCapacity = 0;
+
+static void setVisitedStructCount(TypeEntry* type, UWord count) {
+  genputtable(VisitedStructsTable, (void*)type, (void*)count);
+
+  if (compilingVarSelections) {
+    if (visitedStructsLogSize == visitedStructsLogCapacity) {
+      visitedStructsLogCapacity =
+        (visitedStructsLogCapacity ? 2 * visitedStructsLogCapacity : 64);
+      visitedStructsLog =
+        VG_(realloc)("fjalar_traversal.c: setVisitedStructCount",
+                     visitedStructsLog, visitedStructsLogCapacity * sizeof(TypeEntry*));
+    }
+    visitedStructsLog[visitedStructsLogSize++] = type;
+  }
+}
+
+static VarSelection* findVarSelection(VariableEntry* var, char* trace_vars_tree) {
+  VarSelection* sel;
+
+  for (sel = var->varSelections; sel; sel = sel->next) {
+    if ((sel->trace_vars_tree == trace_vars_tree) &&
+        sel->numPositions && (sel->vars[0] == var)) {
+      return sel;
+    }
+  }
+  return 0;
+}
+
+// Called by visitVariable() before it visits var
+static void startVarSelection(VariableEntry* var, char* trace_vars_tree,
+                              UInt numStructsDereferenced) {
+  curVarSelection = 0;
+  curVarSelectionPos = 0;
+
+  // (Variables visited from deeper inside of a struct don't get
+  //  derived the same way.)
+  if (!fjalar_trace_vars_filename || (numStructsDereferenced > 0)) {
+    return;
+  }
+
+  if (compilingVarSelections) {
+    VarSelection* sel =
+      VG_(calloc)("fjalar_traversal.c: startVarSelection", 1, sizeof(VarSelection));
+    sel->trace_vars_tree = trace_vars_tree;
+    sel->next = var->varSelections;
+    var->varSelections = sel;
+    visitedStructsLogSize = 0;
+    curVarSelection = sel;
+  }
+  else {
+    curVarSelection = findVarSelection(var, trace_vars_tree);
+  }
+}
+
+static void growVarSelection(VarSelection* sel, UInt pos) {
+  UInt newCapacity = sel->capacity ? sel->capacity : 64;
+  UInt oldWords = sel->capacity / 32;
+  UInt newWords;
+
+  while (pos >= newCapacity) {
+    newCapacity <<= 1;
+  }
+  newWords = newCapacity / 32;
+
+  sel->vars = VG_(realloc)("fjalar_traversal.c: growVarSelection",
+                           sel->vars, newCapacity * sizeof(VariableEntry*));
+  sel->sizes = VG_(realloc)("fjalar_traversal.c: growVarSelection.2",
+                            sel->sizes, newCapacity * sizeof(UInt));
+  sel->structCountsStart = VG_(realloc)("fjalar_traversal.c: growVarSelection.3",
+                                        sel->structCountsStart,
+                                        newCapacity * sizeof(UInt));
+  sel->selected = VG_(realloc)("fjalar_traversal.c: growVarSelection.4",
+                               sel->selected, newWords * sizeof(UInt));
+  sel->wanted = VG_(realloc)("fjalar_traversal.c: growVarSelection.5",
+                             sel->wanted, newWords * sizeof(UInt));
+  VG_(memset)(sel->selected + oldWords, 0, (newWords - oldWords) * sizeof(UInt));
+  VG_(memset)(sel->wanted + oldWords, 0, (newWords - oldWords) * sizeof(UInt));
+  sel->capacity = newCapacity;
+}
+
+// Called by compileVarSelections() (through visitSingleVar() and
+// visitSequence()) when it reaches var, whose name is on top of
+// fullNameStack.  Returns what to pass to endCompiledVar() once the
+// variables derived from var have been visited.
+static UInt beginCompiledVar(VariableEntry* var, char* trace_vars_tree) {
+  VarSelection* sel = curVarSelection;
+  UInt pos = curVarSelectionPos;
+  const HChar* fullFjalarName;
+
+  if (!sel) {
+    return 0;
+  }
+
+  if (pos >= sel->capacity) {
+    growVarSelection(sel, pos);
+  }
+  sel->numPositions = pos + 1;
+  sel->vars[pos] = var;
+  sel->sizes[pos] = 1;
+  sel->structCountsStart[pos] = 0;
+
+  fullFjalarName = stringStackStrdup(&fullNameStack);
+  if (interestedInVar(fullFjalarName, trace_vars_tree)) {
+    SET_VAR_SELECTION_BIT(sel->selected, pos);
+  }
+  VG_(free)((void*)fullFjalarName);
+
+  return visitedStructsLogSize;
+}
+
+static void endCompiledVar(UInt pos, UInt logStart) {
+  VarSelection* sel = curVarSelection;
+  UInt end = curVarSelectionPos;
+  UInt i, j;
+
+  if (!sel) {
+    return;
+  }
+
+  sel->sizes[pos] = end - pos;
+
+  for (i = pos; i < end; i++) {
+    if (VAR_SELECTION_BIT(sel->selected, i)) {
+      SET_VAR_SELECTION_BIT(sel->wanted, pos);
+      return;
+    }
+  }
+
+  if (visitedStructsLogSize == logStart) {
+    return;
+  }
+
+  // Record the counts of the struct types that the skipped variables
+  // would have changed, as they are now
+  sel->structCountsStart[pos] = sel->numStructCounts + 1;
+  for (i = logStart; i < visitedStructsLogSize; i++) {
+    TypeEntry* type = visitedStructsLog[i];
+    Bool seen = False;
+
+    for (j = sel->structCountsStart[pos] - 1; j < sel->numStructCounts; j++) {
+      if (sel->structCounts[j].type == type) {
+        seen = True;
+        break;
+      }
+    }
+    if (seen) {
+      continue;
+    }
+
+    // (Always leave room for the terminating entry)
+    if (sel->numStructCounts + 1 >= sel->structCountsCapacity) {
+      sel->structCountsCapacity =
+        (sel->structCountsCapacity ? 2 * sel->structCountsCapacity : 16);
+      sel->structCounts =
+        VG_(realloc)("fjalar_traversal.c: endCompiledVar", sel->structCounts,
+                     sel->structCountsCapacity * sizeof(VisitedStructCount));
+    }
+    sel->structCounts[sel->numStructCounts].type = type;
+    sel->structCounts[sel->numStructCounts].count =
+      (UWord)gengettable(VisitedStructsTable, (void*)type);
+    sel->numStructCounts++;
+  }
+
+  sel->structCounts[sel->numStructCounts].type = 0;
+  sel->structCounts[sel->numStructCounts].count = 0;
+  sel->numStructCounts++;
+}
+
+// If none of var (the variable at the current position) and the
+// variables derived from it are traced, skips all of them, just like
+// visiting them would, and returns True
+static Bool skipUntracedVars(VariableEntry* var) {
+  VarSelection* sel = curVarSelection;
+  UInt pos = curVarSelectionPos;
+  UInt start;
+
+  // (--smart-disambig wants to observe all pointers.)
+  if (!sel || (pos >= sel->numPositions) || (sel->vars[pos] != var) ||
+      VAR_SELECTION_BIT(sel->wanted, pos) || fjalar_smart_disambig) {
+    return False;
+  }
+
+  start = sel->structCountsStart[pos];
+  if (start) {
+    VisitedStructCount* c;
+    for (c = &sel->structCounts[start - 1]; c->type; c++) {
+      genputtable(VisitedStructsTable, (void*)c->type, (void*)c->count);
+    }
+  }
+
+  g_variableIndex += sel->sizes[pos];
+  curVarSelectionPos += sel->sizes[pos];
+  return True;
+}
+
+// Returns whether var (the variable at the current position, whose
+// name is on top of fullNameStack) should be passed to the tool.
+// Only builds the full name of var (returned in *fullFjalarNamePtr,
+// to be VG_(free)d) if it has to be looked up in trace_vars_tree;
+// otherwise, the caller must build it if it needs it.
+static Bool selectVar(VariableEntry* var, char* trace_vars_tree,
+                      const HChar** fullFjalarNamePtr) {
+  VarSelection* sel = curVarSelection;
+  UInt pos = curVarSelectionPos;
+
+  if (!fjalar_trace_vars_filename) {
+    return True;
+  }
+
+  if (sel && (pos < sel->numPositions) && (sel->vars[pos] == var)) {
+    return VAR_SELECTION_BIT(sel->selected, pos);
+  }
+
+  *fullFjalarNamePtr = stringStackStrdup(&fullNameStack);
+  return interestedInVar(*fullFjalarNamePtr, trace_vars_tree);
+}
+
+// Passed to visitVariable() by compileVarSelection(), which doesn't
+// visit any values
+static TraversalResult compileVarSelectionAction(VariableEntry* var,
+                                                 const HChar* varName,
+                                                 VariableOrigin varOrigin,
+                                                 UInt numDereferences,
+                                                 UInt layersBeforeBase,
+                                                 Bool overrideIsInit,
+                                                 DisambigOverride disambigOverride,
+                                                 Bool isSequence,
+                                                 Addr pValue,
+                                                 Addr pValueGuest,
+                                                 Addr* pValueArray,
+                                                 Addr* pValueArrayGuest,
+                                                 UInt numElts,
+                                                 FunctionEntry* varFuncInfo,
+                                                 Bool isEnter) {
+  /* silence unused variable warnings */
+  (void)var; (void)varName; (void)varOrigin; (void)numDereferences;
+  (void)layersBeforeBase; (void)overrideIsInit; (void)disambigOverride;
+  (void)isSequence; (void)pValue; (void)pValueGuest; (void)pValueArray;
+  (void)pValueArrayGuest; (void)numElts; (void)varFuncInfo; (void)isEnter;
+
+  return DO_NOT_DEREF_MORE_POINTERS;
+}
+
+static char* traceVarsTreeFor(VariableOrigin varOrigin, FunctionEntry* varFuncInfo);
+
+static void compileVarSelection(VariableEntry* var,
+                                VariableOrigin varOrigin,
+                                FunctionEntry* varFuncInfo) {
+  if (!var->name ||
+      findVarSelection(var, traceVarsTreeFor(varOrigin, varFuncInfo))) {
+    return;
+  }
+
+  stringStackClear(&fullNameStack);
+  stringStackPush(&fullNameStack, var->name);
+  visitVariable(var, 0, 0, False, 0, &compileVarSelectionAction,
+                varOrigin, varFuncInfo, False);
+  stringStackPop(&fullNameStack);
+}
+
+// Compiles trace_vars_tree and trace_global_vars_tree of every
+// function (and the global variables section of the --var-list-file)
+// into VarSelections for the variables at its program points.
+// Call this once all of the variables and their types are known, and
+// after handleDisambigFile(), whose entries change which variables
+// get derived.
+void compileVarSelections(void) {
+  int savedVariableIndex = g_variableIndex;
+  FuncIterator* funcIt;
+  VarIterator* varIt;
+
+  tl_assert(fjalar_trace_vars_filename);
+  compilingVarSelections = True;
+
+  if (!fjalar_ignore_globals) {
+    varIt = newVarIterator(&globalVars);
+    while (hasNextVar(varIt)) {
+      compileVarSelection(nextVar(varIt), GLOBAL_VAR, 0);
+    }
+    deleteVarIterator(varIt);
+  }
+
+  funcIt = newFuncIterator();
+  while (hasNextFunc(funcIt)) {
+    FunctionEntry* funcPtr = nextFunc(funcIt);
+
+    if (fjalar_trace_prog_pts_filename &&
+        !prog_pts_tree_entry_found(funcPtr)) {
+      continue;
+    }
+
+    varIt = newVarIterator(&funcPtr->formalParameters);
+    while (hasNextVar(varIt)) {
+      compileVarSelection(nextVar(varIt), FUNCTION_FORMAL_PARAM, funcPtr);
+    }
+    deleteVarIterator(varIt);
+
+    varIt = newVarIterator(&funcPtr->returnValue);
+    while (hasNextVar(varIt)) {
+      compileVarSelection(nextVar(varIt), FUNCTION_RETURN_VAR, funcPtr);
+    }
+    deleteVarIterator(varIt);
+
+    // (Functions without a list of their own share the selections of
+    //  the global variables compiled above.)
+    if (!fjalar_ignore_globals && funcPtr->trace_global_vars_tree) {
+      varIt = newVarIterator(&globalVars);
+      while (hasNextVar(varIt)) {
+        compileVarSelection(nextVar(varIt), GLOBAL_VAR, funcPtr);
+      }
+      deleteVarIterator(varIt);
+    }
+  }
+  deleteFuncIterator(funcIt);
+
+  compilingVarSelections = False;
+  curVarSelection = 0;
+  g_variableIndex = savedVariableIndex;
+}
+
+
 // Visits an entire group of variables, depending on the value of varOrigin:
 // If varOrigin == GLOBAL_VAR, then visit all global variables
 // If varOrigin == FUNCTION_FORMAL_PARAM, then visit all formal parameters
@@ -859,6 +1264,17 @@ void visitClassMemberVariables(VisitArgs* args) {
 // If varOrigin == FUNCTION_RETURN_VAR, then visit the return value variable
 // of the function denoted by funcPtr (use visitReturnValue() if you
 // want to grab the actual return value at runtime and not just the name)
+static
+void visitGroup(VariableOrigin varOrigin,
+                FunctionEntry* funcPtr,
+                Bool isEnter,
+                Addr stackBaseAddr,
+                Addr stackBaseAddrGuest,
+                TraversalAction *performAction,
+                // Only used for GLOBAL_VAR (see visitGlobalVariables()):
+                BeforeGlobalVarAction *beforeGlobalVar,
+                AfterGlobalVarAction *afterGlobalVar);
+
 void visitVariableGroup(VariableOrigin varOrigin,
                         FunctionEntry* funcPtr, // 0 for unspecified function
                         Bool isEnter,           // 1 for function entrance, 0 for exit
@@ -867,6 +1283,30 @@ void visitVariableGroup(VariableOrigin varOrigin,
                         // This function performs an action for each
                         // variable visited:
                         TraversalAction *performAction) {
+  visitGroup(varOrigin, funcPtr, isEnter, stackBaseAddr, stackBaseAddrGuest,
+             performAction, 0, 0);
+}
+
+// Visits all global variables, giving the tool a chance to skip each
+// one (see BeforeGlobalVarAction in fjalar_include.h)
+void visitGlobalVariables(FunctionEntry* funcPtr,
+                          Bool isEnter,
+                          TraversalAction *performAction,
+                          BeforeGlobalVarAction *beforeVar,
+                          AfterGlobalVarAction *afterVar) {
+  visitGroup(GLOBAL_VAR, funcPtr, isEnter, 0, 0,
+             performAction, beforeVar, afterVar);
+}
+
+static
+void visitGroup(VariableOrigin varOrigin,
+                FunctionEntry* funcPtr,
+                Bool isEnter,
+                Addr stackBaseAddr,
+                Addr stackBaseAddrGuest,
+                TraversalAction *performAction,
+                BeforeGlobalVarAction *beforeGlobalVar,
+                AfterGlobalVarAction *afterGlobalVar) {
   VarList* varListPtr = NULL;
   VarIterator* varIt = NULL;
   Bool overrideIsInit = 0;
@@ -947,7 +1387,20 @@ void visitVariableGroup(VariableOrigin varOrigin,
       FJALAR_DPRINTF("\t[visitVariableGroup] State of Frame Pointer: %p\n", (void *)stackBaseAddrGuest);
       FJALAR_DPRINTF("\t[visitVariableGroup] Size of DWARF location stack: %u\n", var->location_expression_size);
 
-      if(var->location_expression_size) {
+      if (var->hasLocList) {
+        // The location depends on the PC (optimized code).  Use where
+        // the parameter was at function entrance at both entrance and
+        // exit, just like for the virtual stack (see
+        // snapshotLocListParams() in fjalar_main.c)
+        if (!funcPtr->locListParams) {
+          continue;
+        }
+        basePtrValue = funcPtr->locListParams[var->locListSlot].loc;
+        basePtrValueGuest = funcPtr->locListParams[var->locListSlot].locGuest;
+        FJALAR_DPRINTF("\t[visitVariableGroup] location list entry location: %p (guest %p)\n",
+                       (void *)basePtrValue, (void *)basePtrValueGuest);
+      }
+      else if(var->location_expression_size) {
         Addr var_loc = (Addr) NULL;
         unsigned int i = 0;
 
@@ -1129,6 +1582,11 @@ void visitVariableGroup(VariableOrigin varOrigin,
       }
     }
 
+    if (beforeGlobalVar &&
+        !(*beforeGlobalVar)(var, basePtrValue, funcPtr, isEnter)) {
+      continue;
+    }
+
     stringStackPush(&fullNameStack, var->name);
 
     visitVariable(var,
@@ -1142,6 +1600,10 @@ void visitVariableGroup(VariableOrigin varOrigin,
                   isEnter);
 
     stringStackPop(&fullNameStack);
+
+    if (afterGlobalVar) {
+      (*afterGlobalVar)(var);
+    }
   }
 
   deleteVarIterator(varIt);
@@ -1350,35 +1812,27 @@ void visitReturnValue(FunctionExecutionState* e,
 
 /* Functions for visiting variables at every program point */
 
-// Returns 1 if we are interested in visiting this variable and its
-// children, 0 otherwise.  No children of this variable will get
-// visited if this variable is not visited.  For example, if 'foo' is
-// an array, then if the hashcode value of 'foo' is not visited, then
-// the actual array value of 'foo[]' won't be visited either.
-// This performs string matching in trace_vars_tree based on fullFjalarName
-static char interestedInVar(const HChar* fullFjalarName, char* trace_vars_tree) {
-  if (fjalar_trace_vars_filename) {
-    if (trace_vars_tree) {
-      //      printf("Checking if %s is in var list\n", fullFjalarName);
-      if (!tfind((void*)fullFjalarName, (void**)&trace_vars_tree, compareStrings)) {        
-        return 0;
-      }
-      //      printf("Found it\n", fullFjalarName);
-    }
-    // If trace_vars_tree is kept at 0 on purpose but
-    // fjalar_trace_vars_filename is valid, then still punt because we
-    // are only supposed to print out variables listed in
-    // fjalar_trace_vars_filename and obviously there aren't any
-    // relevant variables to print
-    else {
-      return 0;
+// The trace_vars_tree to use for a variable visited with varOrigin at
+// the program points of varFuncInfo
+static char* traceVarsTreeFor(VariableOrigin varOrigin, FunctionEntry* varFuncInfo) {
+  if (varOrigin == GLOBAL_VAR) {
+    
+    if (varFuncInfo == 0 || varFuncInfo->trace_global_vars_tree == 0){
+      return (globalFunctionTree ?
+              globalFunctionTree->function_variables_tree : 0);
+    }else{
+      //Use the user-specified globals list if possible
+      //trace_global_vars_tree holds all the global variables specified in the globals
+      //section as well as those specified in the functions section of vars-file
+
+      return varFuncInfo->trace_global_vars_tree;
     }
   }
-
-  return 1;
+  else {
+    return varFuncInfo->trace_vars_tree;
+  }
 }
 
-
 // This visits a variable by delegating to visitSingleVar()
 // Pre: varOrigin != DERIVED_VAR, varOrigin != DERIVED_FLATTENED_ARRAY_VAR
 // Pre: The name of the variable is already initialized in fullNameStack
@@ -1442,22 +1896,8 @@ void visitVariable(VariableEntry* var,
 
   // Also initialize trace_vars_tree based on varOrigin and
   // varFuncInfo:
-  if (varOrigin == GLOBAL_VAR) {
-    
-    if (varFuncInfo == 0 || varFuncInfo->trace_global_vars_tree == 0){
-      trace_vars_tree = (globalFunctionTree ?
-                         globalFunctionTree->function_variables_tree : 0);
-    }else{
-      //Use the user-specified globals list if possible
-      //trace_global_vars_tree holds all the global variables specified in the globals
-      //section as well as those specified in the functions section of vars-file
-
-      trace_vars_tree = varFuncInfo->trace_global_vars_tree;
-    }
-  }
-  else {
-    trace_vars_tree = varFuncInfo->trace_vars_tree;
-  }
+  trace_vars_tree = traceVarsTreeFor(varOrigin, varFuncInfo);
+  startVarSelection(var, trace_vars_tree, numStructsDereferenced);
 
   // Delegate:
   new_args.var                    = var;
@@ -1475,6 +1915,7 @@ void visitVariable(VariableEntry* var,
   new_args.isEnter                = isEnter;
 
   visitSingleVar(&new_args);
+  curVarSelection = 0;
 
   FJALAR_DPRINTF("Exit  visitVariable - var: %s\n", var->name);
 }
@@ -1503,6 +1944,10 @@ void visitSingleVar(VisitArgs* args) {
   VisitArgs new_args;
 
   const HChar* fullFjalarName = NULL;
+  Bool varSelected = False;
+  Bool nameSkipped = False;
+  UInt varSelectionPos = curVarSelectionPos;
+  UInt visitedStructsLogStart = 0;
   int layersBeforeBase;
 
   // Initialize these in a group later
@@ -1515,6 +1960,14 @@ void visitSingleVar(VisitArgs* args) {
   
   FJALAR_DPRINTF("Enter visitSingleVar - var: %s\n", var->name);
 
+  if (compilingVarSelections) {
+    visitedStructsLogStart = beginCompiledVar(var, trace_vars_tree);
+  }
+  else if (skipUntracedVars(var)) {
+    FJALAR_DPRINTF("Exit  visitSingleVar - var: %s (not traced)\n", var->name);
+    return;
+  }
+
   needToDerefCppRef = ((var->referenceLevels > 0) && (numDereferences == 0));
 
   // Reset this counter to get C++ reference parameter variables to work properly:
@@ -1576,9 +2029,13 @@ void visitSingleVar(VisitArgs* args) {
       (fjalar_output_struct_vars ||
        (!((layersBeforeBase == 0) && IS_AGGREGATE_TYPE(var->varType))))) {
 
-    // (Notice that this uses strdup to allocate on the heap)
     tl_assert(fullNameStack.size > 0);
-    fullFjalarName = stringStackStrdup(&fullNameStack);
+    varSelected = selectVar(var, trace_vars_tree, &fullFjalarName);
+    if (varSelected && !fullFjalarName) {
+      // (Notice that this uses strdup to allocate on the heap)
+      fullFjalarName = stringStackStrdup(&fullNameStack);
+    }
+    nameSkipped = !fullFjalarName;
 
     // For disambig: While observing the runtime values, set
     // pointerHasEverBeenObserved to 1 if the contents of a pointer
@@ -1606,7 +2063,7 @@ void visitSingleVar(VisitArgs* args) {
     // interesting. Now we will not return, but simply not
     // pass uninteresting variables to the tool.
     
-    if (interestedInVar(fullFjalarName, trace_vars_tree)) {
+    if (varSelected) {
 
       // Perform the action action for this particular variable:
       tResult = (*performAction)(var,
@@ -1627,9 +2084,11 @@ void visitSingleVar(VisitArgs* args) {
 
       tl_assert(tResult != INVALID_RESULT);
 
-      // Punt!
+      // Punt!  (The variables derived from this one no longer get
+      // visited, so curVarSelectionPos won't match the rest.)
       if (tResult == STOP_TRAVERSAL) {
         VG_(free)((void*)fullFjalarName);
+        curVarSelection = 0;
         return;
       }
     }
@@ -1651,6 +2110,13 @@ void visitSingleVar(VisitArgs* args) {
   // increment this once per call of either visitSingleVar() or
   // visitSequence():
   g_variableIndex++;
+  curVarSelectionPos++;
+
+  // Variables derived from this one need its name (for
+  // enclosingVarNamesStack) even if it isn't traced itself:
+  if (nameSkipped && ((layersBeforeBase > 0) || needToDerefCppRef)) {
+    fullFjalarName = stringStackStrdup(&fullNameStack);
+  }
 
   // Now comes the fun part of deriving variables!
 
@@ -1914,6 +2380,10 @@ void visitSingleVar(VisitArgs* args) {
   }
   if (fullFjalarName)
     VG_(free)((void*)fullFjalarName);
+
+  if (compilingVarSelections) {
+    endCompiledVar(varSelectionPos, visitedStructsLogStart);
+  }
   
   FJALAR_DPRINTF("Exit  visitSingleVar - var: %s\n", var->name);
 }
@@ -1944,6 +2414,10 @@ void visitSequence(VisitArgs* args) {
   VisitArgs new_args;
 
   const HChar* fullFjalarName = NULL;
+  Bool varSelected = False;
+  Bool nameSkipped = False;
+  UInt varSelectionPos = curVarSelectionPos;
+  UInt visitedStructsLogStart = 0;
   int layersBeforeBase;
 
   TraversalResult tResult = INVALID_RESULT;
@@ -1952,6 +2426,14 @@ void visitSequence(VisitArgs* args) {
 
   FJALAR_DPRINTF("Enter visitSequence - var: %s\n", var->name);
 
+  if (compilingVarSelections) {
+    visitedStructsLogStart = beginCompiledVar(var, trace_vars_tree);
+  }
+  else if (skipUntracedVars(var)) {
+    FJALAR_DPRINTF("Exit  visitSequence - var: %s (not traced)\n", var->name);
+    return;
+  }
+
   layersBeforeBase = var->ptrLevels - numDereferences;
 
   // Special hack for strings:
@@ -1984,9 +2466,13 @@ void visitSequence(VisitArgs* args) {
   if (fjalar_output_struct_vars ||
       (!((layersBeforeBase == 0) && IS_AGGREGATE_TYPE(var->varType)))) {
 
-    // (Notice that this uses strdup to allocate on the heap)
     tl_assert(fullNameStack.size > 0);
-    fullFjalarName = stringStackStrdup(&fullNameStack);
+    varSelected = selectVar(var, trace_vars_tree, &fullFjalarName);
+    if (varSelected && !fullFjalarName) {
+      // (Notice that this uses strdup to allocate on the heap)
+      fullFjalarName = stringStackStrdup(&fullNameStack);
+    }
+    nameSkipped = !fullFjalarName;
 
     // For disambig: While observing the runtime values, set
     // var->disambigMultipleElts and var->pointerHasEverBeenObserved
@@ -2039,7 +2525,7 @@ void visitSequence(VisitArgs* args) {
                    fullFjalarName);
 
     // See: PARTIAL_STRUCT_TRAVERSAL
-    if (interestedInVar(fullFjalarName, trace_vars_tree)) {
+    if (varSelected) {
 
       // Perform the action action for this particular variable:
       tResult = (*performAction)(var,
@@ -2060,9 +2546,11 @@ void visitSequence(VisitArgs* args) {
 
       tl_assert(tResult != INVALID_RESULT);
 
-      // Punt!
+      // Punt!  (The variables derived from this one no longer get
+      // visited, so curVarSelectionPos won't match the rest.)
       if (tResult == STOP_TRAVERSAL) {
         VG_(free)((void*)fullFjalarName);
+        curVarSelection = 0;
         return;
       }
     }
@@ -2081,6 +2569,13 @@ void visitSequence(VisitArgs* args) {
   // increment this once per call of either visitSingleVar() or
   // visitSequence():
   g_variableIndex++;
+  curVarSelectionPos++;
+
+  // Variables derived from this one need its name (for
+  // enclosingVarNamesStack) even if it isn't traced itself:
+  if (nameSkipped && ((layersBeforeBase > 0) || IS_AGGREGATE_TYPE(var->varType))) {
+    fullFjalarName = stringStackStrdup(&fullNameStack);
+  }
 
 
   // Now comes the fun part of deriving variables!
@@ -2206,5 +2701,9 @@ void visitSequence(VisitArgs* args) {
   if (fullFjalarName)
     VG_(free)((void*)fullFjalarName);
 
+  if (compilingVarSelections) {
+    endCompiledVar(varSelectionPos, visitedStructsLogStart);
+  }
+
   FJALAR_DPRINTF("Exit  visitSequence - var: %s\n", var->name);
 }
@@ -38,4 +38,6 @@ int stringStackStrLen(StringStack *stack);
 void stringStackPrint(StringStack *stack);
 const HChar* stringStackStrdup(StringStack *stack);
 
+void compileVarSelections(void);
+
 #endif
@@ -42,12 +42,14 @@ static void initFunctionFjalarNames(void);
 static void updateAllGlobalVariableNames(void);
 static void initMemberFuncs(void);
 static void initConstructorsAndDestructors(void);
+static void initClassGraph(void);
 static void createNamesForUnnamedDwarfEntries(void);
 static void updateAllVarTypes(void);
 static void processFunctions(void);
 
 int determineFormalParametersStackByteSize(FunctionEntry* f);
 int determineFormalParametersLowerStackByteSize(FunctionEntry* f);
+static void determineFormalParametersSnapshotRange(FunctionEntry* f);
 
 static void extractFormalParameterVars(FunctionEntry* f, function* dwarfFunctionEntry);
 static void extractLocalArrayAndStructVariables(FunctionEntry* f, function* dwarfFunctionEntry);
@@ -210,6 +212,10 @@ struct genhashtable* FunctionTable = 0;
 struct genhashtable* FunctionTable_by_entryPC = 0;
 struct genhashtable* VisitedStructsTable = 0;
 
+UInt numAggregateTypes = 0;
+
+PtrdiffT fjalar_load_bias = 0;
+
 // Data structure to check for duplicate function names in the
 // debugging information.
 struct genhashtable* FuncNameTable = 0;
@@ -554,6 +560,10 @@ void initializeAllFjalarData(void)
   // to pattern match names to type names:
   initConstructorsAndDestructors();
 
+  // Run after updateAllVarTypes() so that the member variables have
+  // their real types:
+  initClassGraph();
+
 
   // Some post-processing on functions to work around GCC
   // issues
@@ -582,12 +592,81 @@ void initializeAllFjalarData(void)
 // by the executable's symbol table (it lies within the .data, .bss,
 // or .rodata sections):
 Bool addressIsGlobal(Addr addr) {
+  // The section bounds are link-time addresses:
+  addr -= fjalar_load_bias;
   return (((addr >= data_section_addr) && (addr < data_section_addr + data_section_size)) ||
           ((addr >= bss_section_addr) && (addr < bss_section_addr + bss_section_size)) ||
           ((addr >= rodata_section_addr) && (addr < rodata_section_addr + rodata_section_size)) ||
           ((addr >= relrodata_section_addr) && (addr < relrodata_section_addr + relrodata_section_size)));
 }
 
+// Rebuilds a hash table keyed by code address after all of its
+// FunctionEntry values have been moved by relocateAllFjalarData():
+static struct genhashtable* rekeyFunctionTable(struct genhashtable* table,
+                                               Bool byEntryPC) {
+  struct genhashtable* newTable =
+    genallocatehashtable(0, (int (*)(void *,void *)) &equivalentIDs);
+  struct geniterator* it = gengetiterator(table);
+
+  while (!it->finished) {
+    FunctionEntry* f = (FunctionEntry*)gengettable(table, gennext(it));
+    if (f) {
+      genputtable(newTable,
+                  (void*)(byEntryPC ? f->entryPC : f->startPC),
+                  (void*)f);
+    }
+  }
+  genfreeiterator(it);
+  genfreehashtable(table);
+  return newTable;
+}
+
+// Called with --trace-library when the library gets mapped (and again,
+// with the difference, if it is unmapped and mapped somewhere else).
+// All of the model was built from the library's link-time addresses,
+// so only the addresses change; nothing is re-read from the file.
+void relocateAllFjalarData(PtrdiffT delta) {
+  FuncIterator* funcIt;
+  VarNode* node;
+
+  if (delta == 0) {
+    return;
+  }
+
+  FJALAR_DPRINTF("ENTER relocateAllFjalarData(%ld)\n", (long)delta);
+
+  funcIt = newFuncIterator();
+  while (hasNextFunc(funcIt)) {
+    FunctionEntry* f = nextFunc(funcIt);
+    f->startPC += delta;
+    f->endPC += delta;
+    f->entryPC += delta;
+    f->cuBase += delta;
+  }
+  deleteFuncIterator(funcIt);
+
+  FunctionTable = rekeyFunctionTable(FunctionTable, False);
+  FunctionTable_by_entryPC = rekeyFunctionTable(FunctionTable_by_entryPC, True);
+
+  // This covers static member variables too, since they are aliased
+  // in globalVars:
+  for (node = globalVars.first; node != NULL; node = node->next) {
+    VariableEntry* var = node->var;
+    if (IS_GLOBAL_VAR(var)) {
+      if (var->globalVar->globalLocation) {
+        var->globalVar->globalLocation += delta;
+      }
+      if (var->globalVar->functionStartPC) {
+        var->globalVar->functionStartPC += delta;
+      }
+    }
+  }
+
+  fjalar_load_bias += delta;
+
+  FJALAR_DPRINTF("EXIT  relocateAllFjalarData\n");
+}
+
 // Performs a scan over all VariableEntry, TypeEntry, and
 // FunctionEntry instances in various data structures and checks to
 // make sure that all invariants hold true after initialization.
@@ -1746,6 +1825,8 @@ void initializeFunctionTable(void)
           cur_func_entry->formalParamLowerStackByteSize
             = determineFormalParametersLowerStackByteSize(cur_func_entry);
 
+          determineFormalParametersSnapshotRange(cur_func_entry);
+
           num_functions_added++;
         }
     }
@@ -2418,6 +2499,70 @@ int determineFormalParametersLowerStackByteSize(FunctionEntry* f)
 }
 
 
+// Determines the smallest range of bytes around the frame base that
+// holds all of a function's formal parameters, if their locations
+// are known statically.  Otherwise (and for main(), whose stack is
+// realigned, and functions whose prolog we can't skip, where the
+// register-passed params haven't been spilled yet), leaves
+// f->formalParamSnapshotExact False so that enter_function() copies
+// the whole frame.
+static void determineFormalParametersSnapshotRange(FunctionEntry* f)
+{
+  VarNode* cur_node;
+  int low = 0;
+  int high = 0;
+
+  f->formalParamSnapshotExact = False;
+
+  if ((f->entryPC == f->startPC) || VG_STREQ("main", f->name)) {
+    return;
+  }
+
+  for (cur_node = f->formalParameters.first;
+       cur_node != NULL;
+       cur_node = cur_node->next)
+    {
+      VariableEntry* var = cur_node->var;
+      int offset;
+      int byteSize;
+
+      if ((var->location_expression_size != 1) ||
+          (var->location_expression[0].atom != DW_OP_fbreg)) {
+        FJALAR_DPRINTF("  %s: location of %s is not a frame offset\n",
+                       f->name, var->name);
+        return;
+      }
+
+      offset = (int)var->location_expression[0].atom_offset;
+      byteSize = determineVariableByteSize(var);
+      if (byteSize <= 0) {
+        return;
+      }
+
+      if (cur_node == f->formalParameters.first) {
+        low = offset;
+        high = offset + byteSize;
+      } else {
+        low = MIN(low, offset);
+        high = MAX(high, offset + byteSize);
+      }
+    }
+
+  // Keep at least a word, so that the virtual stack is never empty
+  // (for functions without parameters)
+  if (high - low < (int)sizeof(Addr)) {
+    high = low + sizeof(Addr);
+  }
+
+  f->formalParamSnapshotExact = True;
+  f->formalParamSnapshotLow = low;
+  f->formalParamSnapshotHigh = high;
+
+  FJALAR_DPRINTF("  %s: formal parameters are at frame offsets [%d, %d)\n",
+                 f->name, low, high);
+}
+
+
 // dwarfParamEntry->tag_name == DW_TAG_formal_parameter
 static void extractOneFormalParameterVar(FunctionEntry* f,
                                          dwarf_entry* dwarfParamEntry)
@@ -2480,6 +2625,17 @@ static void extractOneFormalParameterVar(FunctionEntry* f,
     FJALAR_DPRINTF(" location_type: %u, byteOffset: %x\n", varPtr->locationType, (unsigned int)varPtr->byteOffset);
   }
 
+  // The location depends on the PC (optimized code), so it gets
+  // evaluated when the function is entered (see enter_function())
+  if (paramPtr->has_loc_list) {
+    varPtr->validLoc = 1;
+    varPtr->hasLocList = True;
+    varPtr->locListOffset = paramPtr->loc_list_offset;
+    varPtr->locListSlot = f->numLocListParams++;
+
+    FJALAR_DPRINTF(" location list at offset %lx, slot %d\n", varPtr->locListOffset, varPtr->locListSlot);
+  }
+
   FJALAR_DPRINTF("EXIT  extractOneFormalParameterVar\n");
 }
 
@@ -3201,6 +3357,73 @@ static void initMemberFuncs(void) {
   deleteTypeIterator(typeIt);
 }
 
+// Numbers the struct/class/union types in TypesTable and gives each
+// the list of the distinct struct/class/union types of its member
+// variables (AggregateType::objectIndex and memberClassList).
+// Together with the superclass lists, this is the graph that tools
+// follow to find the classes reachable from a variable without
+// visiting every variable derived from it.  Takes time linear in the
+// number of types and member variables.
+// Pre: This should only be run after updateAllVarTypes().
+static void initClassGraph(void) {
+  TypeIterator* typeIt = newTypeIterator();
+  // For each type, the objectIndex of the last type whose list it
+  // was added to (so that it isn't added to the same list twice)
+  UInt* lastAddedTo;
+
+  FJALAR_DPRINTF("ENTER initClassGraph\n");
+
+  numAggregateTypes = 0;
+  while (hasNextType(typeIt)) {
+    TypeEntry* t = nextType(typeIt);
+    // (a type may be in TypesTable under more than one name)
+    if (IS_AGGREGATE_TYPE(t) && !t->aggType->objectIndex) {
+      t->aggType->objectIndex = ++numAggregateTypes;
+    }
+  }
+  deleteTypeIterator(typeIt);
+
+  lastAddedTo = VG_(calloc)("generate_fjalar_entries.c: initClassGraph",
+                            numAggregateTypes + 1, sizeof(UInt));
+
+  typeIt = newTypeIterator();
+  while (hasNextType(typeIt)) {
+    TypeEntry* t = nextType(typeIt);
+    VarNode* n;
+
+    if (!IS_AGGREGATE_TYPE(t) || !t->aggType->memberVarList) {
+      continue;
+    }
+
+    for (n = t->aggType->memberVarList->first; n != NULL; n = n->next) {
+      TypeEntry* memberType = n->var->varType;
+      UInt index;
+
+      if (!memberType || !IS_AGGREGATE_TYPE(memberType)) {
+        continue;
+      }
+      // (a type that somehow isn't in TypesTable is left out)
+      index = memberType->aggType->objectIndex;
+      if (!index || (lastAddedTo[index] == t->aggType->objectIndex)) {
+        continue;
+      }
+      lastAddedTo[index] = t->aggType->objectIndex;
+
+      if (!t->aggType->memberClassList) {
+        t->aggType->memberClassList =
+          VG_(calloc)("generate_fjalar_entries.c: initClassGraph.2",
+                      1, sizeof(*(t->aggType->memberClassList)));
+      }
+      SimpleListInsert(t->aggType->memberClassList, memberType);
+    }
+  }
+  deleteTypeIterator(typeIt);
+
+  VG_(free)(lastAddedTo);
+
+  FJALAR_DPRINTF("EXIT  initClassGraph (%u types)\n", numAggregateTypes);
+}
+
 // FunctionTable
 
 // This is SLOW because we must traverse all values, looking for the
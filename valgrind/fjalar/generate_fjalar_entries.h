@@ -75,6 +75,17 @@ struct genhashtable* TypesTable;
 
 void initializeAllFjalarData(void);
 
+// How far the traced object has been moved from its link-time
+// addresses.  This is always 0 when tracing the executable; with
+// --trace-library, it becomes the load bias of the library once it
+// has been mapped (see relocateAllFjalarData()).
+PtrdiffT fjalar_load_bias;
+
+// Moves every code and global variable address in the data
+// structures exported by this file by delta bytes and re-keys the
+// hash tables that are indexed by code addresses:
+void relocateAllFjalarData(PtrdiffT delta);
+
 // Call this function whenever you want to check that the data
 // structures in this file all satisfy their respective
 // rep. invariants.  This can only be run after
@@ -25,6 +25,7 @@
 #include "../my_libc.h"
 
 #include "decls-output.h"
+#include "decls-table.h"
 #include "kvasir_main.h"
 #include "dyncomp_runtime.h"
 #include "dyncomp_main.h"
@@ -37,6 +38,9 @@ const char* EXIT_PPT = ":::EXIT0";
 const char* SIMPLE_EXIT_PPT = ":::EXIT";
 const char* OBJECT_PPT = ":::OBJECT";
 
+// The --dyncomp-partitions file while DC_outputDeclsAtEnd() writes it
+static FILE* partitions_fp = 0;
+
 extern const char* DeclaredTypeString[];
 extern const char* cur_var_name;
 extern const char* func_name;
@@ -86,11 +90,6 @@ static int curr_par_id = 1;
 // Contains a mapping between an object name and it's unique ID
 struct genhashtable* objectIdTable = NULL;
 
-// Contains a mapping between a pointer to a function entry
-// and a hashtable of objects representing all the object types
-// that are referenced during the function's execution
-struct genhashtable* funcObjectTable = NULL;
-
 // Contains a mapping between a string and it's typename
 // (comment added 2008)  
 // RUDD TODO: When I get a chance I need to allow Fjalar to pass
@@ -223,6 +222,7 @@ void printDaikonExternalVarName(VariableEntry* var, const HChar* fjalarName, FIL
 static void printDeclsHeader(void);
 static void printAllFunctionDecls(char faux_decls);
 static void printAllObjectPPTDecls(void);
+static void writeDeclsTable(void);
 
 // Initializes all the data structures needed to perform decls
 void initDecls(void)
@@ -245,12 +245,6 @@ void initDecls(void)
         genallocatehashtable(0,
                              (int (*)(void *,void *)) &equivalentIDs);
     }
-
-  if(!funcObjectTable) {
-      funcObjectTable =
-        genallocatehashtable(0,
-                             (int (*)(void *,void *)) &equivalentIDs);
-    }
 }
 
 void cleanupDecls(void)
@@ -269,7 +263,16 @@ void cleanupDecls(void)
 
 }
 
-static void  harvestAllFunctionObjects(void);
+// A set of classes whose :::OBJECT program points are parents of
+// function program points (see getFunctionObjects())
+typedef struct _FunctionObjects {
+  UInt numTypes;
+  TypeEntry** types;  // Sorted by objectIndex
+} FunctionObjects;
+
+static FunctionObjects* getGlobalObjects(void);
+static FunctionObjects* getFunctionObjects(FunctionEntry* funcPtr);
+static UInt getObjectParentId(FunctionEntry* funcPtr, TypeEntry* t);
 
 // This has different behavior depending on if faux_decls is on.  If
 // faux_decls is on, then we do all the processing but don't actually
@@ -294,15 +297,34 @@ void outputDeclsFile(char faux_decls)
 
   initDecls();
 
-  if(kvasir_object_ppts) {
-    DPRINTF("Object PPTs enabled, attemtping to harvest inheritence heirarchy\n");
-    harvestAllFunctionObjects();
-  }
-
-  printAllFunctionDecls(faux_decls);
+  // With DynComp (which needs the declarations again at the end) or
+  // --decls-cache, the declarations go through the decls table
+  // (see decls-table.c), unless it was read from the --decls-cache
+  if (kvasir_with_dyncomp || kvasir_decls_cache_dirname) {
+    if (!decls_table_load()) {
+      decls_table_begin_recording();
+      printAllFunctionDecls(faux_decls);
+      printAllObjectPPTDecls();
+      decls_table_end_recording();
+    }
 
-  // For DynComp, print this out at the end of execution
-  if (!kvasir_with_dyncomp) {
+    if (kvasir_with_dyncomp) {
+      // Allocate program point data structures for DynComp, with the
+      // number of variables at each program point
+      UInt p;
+      for (p = 0; p < decls_table_num_ppts; p++) {
+        allocate_ppt_structures((DaikonFunctionEntry*)decls_table_ppts[p].func,
+                                decls_table_ppts[p].isEnter,
+                                decls_table_ppts[p].numVarIndices);
+      }
+    }
+    // For DynComp, print this out at the end of execution
+    else {
+      fwrite(decls_table_text, 1, decls_table_text_size, decls_fp);
+    }
+  }
+  else {
+    printAllFunctionDecls(faux_decls);
     printAllObjectPPTDecls();
   }
 
@@ -314,12 +336,68 @@ void outputDeclsFile(char faux_decls)
       fclose(decls_fp);
       decls_fp = 0;
     }
-    cleanupDecls();
   }
+  cleanupDecls();
 }
 
 static TraversalAction printDeclsEntryAction;
 
+// Write out the declarations in the decls table (only used when
+// DynComp is on), with a comparability line after each variable of a
+// function program point, in one pass over the text
+static void writeDeclsTable(void) {
+  ULong written = 0;
+  UInt p, v;
+
+  tl_assert(decls_table_text);
+
+  // (The names of the variables aren't kept in the table)
+  cur_var_name = NULL;
+
+  for (p = 0; p < decls_table_num_ppts; p++) {
+    DeclsTablePpt* ppt = &decls_table_ppts[p];
+    DaikonFunctionEntry* funcPtr = (DaikonFunctionEntry*)ppt->func;
+
+    if (partitions_fp) {
+      fputs("ppt ", partitions_fp);
+      printDaikonFunctionName(ppt->func, partitions_fp);
+      fputs(ppt->isEnter ? ENTER_PPT : EXIT_PPT, partitions_fp);
+      fputs("\n", partitions_fp);
+    }
+
+    // Initialize a global hashtable which associates tags with
+    // sequentially-assigned comparability numbers
+    g_compNumberMap = genallocatehashtable(NULL, // no hash function needed for u_int keys
+                                           (int (*)(void *,void *)) &equivalentIDs);
+    g_curCompNumber = 1;
+
+    if (dyncomp_detailed_mode) {
+      DC_convert_bitmatrix_to_sets(funcPtr, ppt->isEnter);
+    }
+
+    for (v = ppt->firstVar; v < ppt->firstVar + ppt->numVars; v++) {
+      DeclsTableVar* var = &decls_table_vars[v];
+      int comp_number = DC_get_comp_number_for_var(funcPtr,
+                                                   ppt->isEnter,
+                                                   var->varIndex);
+
+      fwrite(decls_table_text + written, 1, var->end - written, decls_fp);
+      written = var->end;
+
+      fprintf(decls_fp, "    comparability %d\n", comp_number);
+      if (partitions_fp) {
+        fprintf(partitions_fp, "%u %d\n", var->varIndex, comp_number);
+      }
+    }
+
+    genfreehashtable(g_compNumberMap);
+  }
+
+  // The rest of the last function program point and the :::OBJECT
+  // program points
+  fwrite(decls_table_text + written, 1, decls_table_text_size - written, decls_fp);
+}
+
 // Print .decls at the end of program execution and then close it
 // (Only used when DynComp is on)
 void DC_outputDeclsAtEnd() {
@@ -329,9 +407,22 @@ void DC_outputDeclsAtEnd() {
   //  printf("DC_outputDeclsAtEnd()\n");
   printDeclsHeader();
   initDecls();
-  if(kvasir_object_ppts) {
-    DPRINTF("Object PPTs enabled, attemtping to harvest inheritence heirarchy\n");
-    harvestAllFunctionObjects();
+
+  // The raw partitions record, for every comparability number written
+  // to the .decls file, the index of its variable at the program point
+  // and the number itself, which identifies a set.  Entries and exits
+  // share their sets unless --dyncomp-separate-entry-exit is on.
+  if (dyncomp_partitions_filename) {
+    partitions_fp = fopen(dyncomp_partitions_filename, "w");
+    if (partitions_fp) {
+      fputs("dyncomp-partitions 1\n", partitions_fp);
+      fprintf(partitions_fp, "separate-entry-exit %s\n",
+              dyncomp_separate_entry_exit ? "yes" : "no");
+    }
+    else {
+      printf("Error: could not write the DynComp partitions to %s\n",
+             dyncomp_partitions_filename);
+    }
   }
 
   if (fjalar_dump_globals) {
@@ -352,8 +443,12 @@ void DC_outputDeclsAtEnd() {
     genfreehashtable(varsDeclaredTable);
   }
 
-  printAllFunctionDecls(0);
-  printAllObjectPPTDecls();
+  writeDeclsTable();
+
+  if (partitions_fp) {
+    fclose(partitions_fp);
+    partitions_fp = 0;
+  }
 
   fclose(decls_fp);
   decls_fp = 0;
@@ -912,13 +1007,9 @@ printDeclsEntryAction(VariableEntry* var,
         // (It is (I think) unlikely for there to be an array of this[]
         // so we can safely assume the sequence is actually a field of
         // the object
-        struct genhashtable *objTable = NULL;
         unsigned int cur_par_id = 0;
         int format = 0;
 
-        objTable = gengettable(funcObjectTable, varFuncInfo);
-        tl_assert(objTable);
-
 
         DPRINTF(" Class variable\n");
         if (((char *)(VG_(strstr)(varName, "this->")) == varName)) {
@@ -933,13 +1024,15 @@ printDeclsEntryAction(VariableEntry* var,
           tl_assert(varFuncInfo && varFuncInfo->parentClass);
 
           if(var->memberVar->structParentType) {
-            tl_assert(cur_par_id = (unsigned int)(ptrdiff_t)gengettable(objTable, var->memberVar->structParentType));
+            cur_par_id = getObjectParentId(varFuncInfo, var->memberVar->structParentType);
+            tl_assert(cur_par_id);
             tl_assert(var->memberVar->structParentType->aggType->memberVarList
                       && (var->memberVar->structParentType->aggType->memberVarList->numVars > 0));
             printDaikonExternalVarName(var, var->memberVar->structParentType->typeName, decls_fp);
             //            fputs(var, var->memberVar->structParentType->typeName, decls_fp);
           } else {
-            tl_assert(cur_par_id = (unsigned int)(ptrdiff_t)gengettable(objTable, varFuncInfo->parentClass));
+            cur_par_id = getObjectParentId(varFuncInfo, varFuncInfo->parentClass);
+            tl_assert(cur_par_id);
             tl_assert(varFuncInfo->parentClass->aggType &&
                       varFuncInfo->parentClass->aggType->memberVarList &&
                       (varFuncInfo->parentClass->aggType->memberVarList->numVars > 0 ));
@@ -969,7 +1062,8 @@ printDeclsEntryAction(VariableEntry* var,
           printDaikonExternalVarName(NULL, var->memberVar->structParentType->typeName, decls_fp);
           //fputs(var->memberVar->structParentType->typeName, decls_fp);
           fputs(OBJECT_PPT, decls_fp);
-          tl_assert(cur_par_id = (unsigned int)(ptrdiff_t)gengettable(objTable, var->memberVar->structParentType));
+          cur_par_id = getObjectParentId(varFuncInfo, var->memberVar->structParentType);
+          tl_assert(cur_par_id);
           tl_assert(var->memberVar->structParentType->aggType &&
                     var->memberVar->structParentType->aggType->memberVarList &&
                     (var->memberVar->structParentType->aggType->memberVarList > 0));
@@ -1007,6 +1101,10 @@ printDeclsEntryAction(VariableEntry* var,
           UInt tag = val_uf_find_leader(get_tag(pValue));
           fprintf(decls_fp, "    tag: %u  leader: %u\n", get_tag(pValue), tag);
           DPRINTF("    tag %u\n", tag);
+        } else if (decls_table_recording) {
+          // The comparability isn't known yet, so writeDeclsTable()
+          // fills it in at the end
+          decls_table_add_var(g_variableIndex);
         } else {
           cur_var_name = varName;
           int comp_number = DC_get_comp_number_for_var((DaikonFunctionEntry*)varFuncInfo,
@@ -1014,6 +1112,9 @@ printDeclsEntryAction(VariableEntry* var,
                                                        g_variableIndex);
 
           fprintf(decls_fp, "    comparability %d\n", comp_number);
+          if (partitions_fp) {
+            fprintf(partitions_fp, "%d %d\n", g_variableIndex, comp_number);
+          }
           DPRINTF("    comparability %d\n", comp_number);
         }
       }
@@ -1073,14 +1174,21 @@ printDeclsEntryAction(VariableEntry* var,
   void printOneFunctionDecl(FunctionEntry* funcPtr,
                             char isEnter,
                             char faux_decls) {
+    // Even a faux pass prints everything while it is writing it to
+    // the decls table
+    Bool printing = !faux_decls || decls_table_recording;
+    TraversalAction* action = (printing ? &printDeclsEntryAction : &nullAction);
+
     // This is a GLOBAL so be careful :)
     // Reset it before doing any traversals
     g_variableIndex = 0;
     DPRINTF("Printing ppt for %s\n", funcPtr->name);
 
-    if (!faux_decls) {
-        struct genhashtable* usedObjTable = NULL;
-        struct geniterator* usedObjIt = NULL;
+    if (decls_table_recording) {
+      decls_table_begin_ppt(funcPtr, isEnter);
+    }
+
+    if (printing) {
         // The format: (entries in brackets are optional, indentation
         //              doesn't matter)
 
@@ -1100,6 +1208,13 @@ printDeclsEntryAction(VariableEntry* var,
           fputs(EXIT_PPT, decls_fp);
         }
 
+        if (partitions_fp) {
+          fputs("ppt ", partitions_fp);
+          printDaikonFunctionName(funcPtr, partitions_fp);
+          fputs(isEnter ? ENTER_PPT : EXIT_PPT, partitions_fp);
+          fputs("\n", partitions_fp);
+        }
+
 
         fputs("\n  ppt-type ", decls_fp);
 
@@ -1136,14 +1251,12 @@ printDeclsEntryAction(VariableEntry* var,
         if (kvasir_object_ppts && funcPtr->parentClass && funcPtr->parentClass->typeName &&
             (funcPtr->parentClass->aggType->memberVarList &&
              (funcPtr->parentClass->aggType->memberVarList->numVars > 0))) {
-          usedObjTable = gengettable(funcObjectTable, funcPtr);
-
           fputs("  parent parent ", decls_fp);
           printDaikonExternalVarName(NULL, funcPtr->parentClass->typeName, decls_fp);
           //          fputs(funcPtr->parentClass->typeName, decls_fp);
           fputs(OBJECT_PPT, decls_fp);
           fputs(" ", decls_fp);
-          fprintf(decls_fp, "%d", (int)(ptrdiff_t)gengettable(usedObjTable, funcPtr->parentClass));
+          fprintf(decls_fp, "%u", getObjectParentId(funcPtr, funcPtr->parentClass));
           //          fputs(ppt_par_id, decls_fp);
           fputs("\n", decls_fp);
         }
@@ -1164,37 +1277,41 @@ printDeclsEntryAction(VariableEntry* var,
         // the printing of duplicates:
         if(kvasir_object_ppts)
         {
-          usedObjTable = gengettable(funcObjectTable, funcPtr);
-          tl_assert(usedObjTable);
+          FunctionObjects* objectSets[2];
+          UInt set, i;
 
-          usedObjIt = gengetiterator(usedObjTable);
+          objectSets[0] = getGlobalObjects();
+          objectSets[1] = getFunctionObjects(funcPtr);
 
-          while(!usedObjIt->finished) {
-            TypeEntry *type = gennext(usedObjIt);
-            DPRINTF("Considering adding %s(%p) to parent user of program point %s\n", type->typeName, type , funcPtr->name);
+          for (set = 0; set < 2; set++) {
+            for (i = 0; i < objectSets[set]->numTypes; i++) {
+              TypeEntry *type = objectSets[set]->types[i];
+              DPRINTF("Considering adding %s(%p) to parent user of program point %s\n", type->typeName, type , funcPtr->name);
 
-            if(gencontains(typeNameStrTable, type->typeName) || !type->aggType->memberVarList || (type->aggType->memberVarList->numVars <= 0)) {
-              continue;
-            }
+              if(gencontains(typeNameStrTable, type->typeName) || !type->aggType->memberVarList || (type->aggType->memberVarList->numVars <= 0)) {
+                continue;
+              }
 
-            DPRINTF("Adding %s(%p) to parent user of program point %s\n", type->typeName, type, funcPtr->name);
+              DPRINTF("Adding %s(%p) to parent user of program point %s\n", type->typeName, type, funcPtr->name);
 
 
-            fputs("  parent user ", decls_fp);
-            printDaikonExternalVarName(NULL, type->typeName, decls_fp);
-            //            fputs(type->typeName, decls_fp);
-            fputs(OBJECT_PPT, decls_fp);
-            fputs(" ", decls_fp);
-            fprintf(decls_fp, "%d", (int)(ptrdiff_t)gengettable(usedObjTable, type));
-            fputs("\n", decls_fp);
-            genputtable(typeNameStrTable, type->typeName, (void *)1);
+              fputs("  parent user ", decls_fp);
+              printDaikonExternalVarName(NULL, type->typeName, decls_fp);
+              //            fputs(type->typeName, decls_fp);
+              fputs(OBJECT_PPT, decls_fp);
+              fputs(" ", decls_fp);
+              fprintf(decls_fp, "%u", type->aggType->objectIndex);
+              fputs("\n", decls_fp);
+              genputtable(typeNameStrTable, type->typeName, (void *)1);
+            }
           }
         }
 
       // For outputting real .decls when running with DynComp,
       // initialize a global hashtable which associates tags with
       // sequentially-assigned comparability numbers
-      if (kvasir_with_dyncomp) {
+      // (writeDeclsTable() does this for what is in the decls table)
+      if (kvasir_with_dyncomp && !decls_table_recording) {
         // This is a GLOBAL so be careful :)
         g_compNumberMap = genallocatehashtable(NULL, // no hash function needed for u_int keys
                                                (int (*)(void *,void *)) &equivalentIDs);
@@ -1222,8 +1339,7 @@ printDeclsEntryAction(VariableEntry* var,
                        isEnter,
                        0,
                        0,
-                       (faux_decls ?
-                        &nullAction : &printDeclsEntryAction));
+                       action);
 
     // Now print out one entry for every formal parameter (actual and derived)
     visitVariableGroup(FUNCTION_FORMAL_PARAM,
@@ -1231,8 +1347,7 @@ printDeclsEntryAction(VariableEntry* var,
                        isEnter,
                        0,
                        0,
-                       (faux_decls ?
-                        &nullAction : &printDeclsEntryAction));
+                       action);
 
     // If EXIT, print out return value
     if (!isEnter) {
@@ -1241,19 +1356,21 @@ printDeclsEntryAction(VariableEntry* var,
                          0,
                          0,
                          0,
-                         (faux_decls ?
-                          &nullAction : &printDeclsEntryAction));
+                         action);
     }
 
     genfreehashtable(varsDeclaredTable);
 
     DPRINTF("Done printing stuff for %s\n", funcPtr->name);
 
-    if (!faux_decls) {
+    if (printing) {
       fputs("\n", decls_fp);
     }
 
-    if (kvasir_with_dyncomp) {
+    if (decls_table_recording) {
+      decls_table_end_ppt(g_variableIndex);
+    }
+    else if (kvasir_with_dyncomp) {
       if (faux_decls) {
         // Allocate program point data structures if we are using DynComp:
         // (This should only be run once for every ppt)
@@ -1266,7 +1383,7 @@ printDeclsEntryAction(VariableEntry* var,
       }
     }
 
-    if (!faux_decls) {
+    if (printing) {
       if(typeNameStrTable) {
         genfreehashtable(typeNameStrTable);
       }
@@ -1676,138 +1793,245 @@ int stringArrayLen(char** stringArr,int start, int end)
    return name;
  }
 
-static struct genhashtable* cur_object_table = NULL;
-static unsigned int cur_par_id = 0;
-
-static TraversalResult
-harvestObject(VariableEntry* var,
-              const HChar* varName,
-              VariableOrigin varOrigin,
-              UInt numDereferences,
-              UInt layersBeforeBase,
-              Bool overrideIsInit,
-              DisambigOverride disambigOverride,
-              Bool isSequence,
-              // pValue only valid if isSequence is false
-              Addr pValue,
-              Addr pValueGuest,
-              // pValueArray and numElts only valid if
-              // isSequence is true
-              Addr* pValueArray,
-              Addr* pValueArrayGuest,
-              UInt numElts,
-              FunctionEntry* varFuncInfo,
-              Bool isEnter) {
-  /* silence unused variable warnings */
-  (void)var; (void)varName; (void)varOrigin; (void)numDereferences;
-  (void)layersBeforeBase; (void)overrideIsInit; (void)disambigOverride;
-  (void)isSequence; (void)pValue; (void)pValueArray; (void)numElts;
-  (void)varFuncInfo; (void)isEnter; (void)pValueGuest; (void)pValueArrayGuest;
-
-  DPRINTF("Examining %s(%p)\n", varName, var);
+// The parents of a function's program points (with --object-ppts)
+// are the :::OBJECT program points of the classes that its variables
+// can refer to: the classes of its formal parameters and of the
+// global variables visible to it, their superclasses, the classes of
+// their member variables and so on, as deep as the traversal goes
+// (--nesting-depth).  These sets are found by a search of the class
+// graph that Fjalar works out once for all types
+// (AggregateType::superclassList and memberClassList) rather than by
+// visiting every variable of every function, and each function's set
+// is kept with its DaikonFunctionEntry.  The relation ID of each
+// class is its objectIndex, which is unique within any program point.
+//
+// The classes reached through the global variables that every
+// function sees are the same for all functions, so they are only
+// worked out once, and the set of each function only has the
+// others.
+
+static FunctionObjects* global_objects = NULL;
+// global_objects as a set (indexed by objectIndex)
+static UChar* in_global_objects = NULL;
+
+// The file-static global variables of struct/class/union type, which
+// are not seen by every function (unless --all-static-vars is on)
+static SimpleList static_object_vars = {0, 0, 0};
+
+// The state of one search of the class graph: for each class, 1 + the
+// smallest nesting depth at which it has been reached (0 if it hasn't
+// been), and the classes that have been reached
+static UInt* reach_depth = NULL;
+static TypeEntry** reached = NULL;
+static UInt num_reached = 0;
+
+// Reach class t at the given nesting depth, as if a variable of type
+// t (or of a pointer to t) had been visited there
+static void reachClass(TypeEntry* t, UInt depth) {
+  AggregateType* agg = t->aggType;
+  UInt index = agg->objectIndex;
+  SimpleNode* n;
+
+  if (!index) {
+    return;
+  }
+  // Already reached at this depth or above, and so already followed
+  // at least as far as it would be now
+  if (reach_depth[index] && (reach_depth[index] <= depth + 1)) {
+    return;
+  }
+  if (!reach_depth[index]) {
+    reached[num_reached++] = t;
+  }
+  reach_depth[index] = depth + 1;
 
-  // We're not interested in values yet, so we only need one of
-  // {function entry, function exit}. We'll choose function exit
-  // to get information on the return variable
-  if(1) {
-    tl_assert(cur_object_table);
-    if(IS_AGGREGATE_TYPE(var->varType)) {
-      DPRINTF("Harvest object %s (%s)\n", varName, var->varType->typeName);
+  // visitClassMemberVariables() doesn't go inside of classes below
+  // this depth
+  if (depth > fjalar_max_visit_nesting_depth) {
+    return;
+  }
 
-      if(!gencontains(cur_object_table, var->varType)) {
-        genputtable(cur_object_table, var->varType, (void *)(ptrdiff_t)cur_par_id);
-        cur_par_id++;
+  // Superclasses are visited at the same depth as their subclass:
+  if (agg->superclassList) {
+    for (n = agg->superclassList->first; n != NULL; n = n->next) {
+      Superclass* s = (Superclass*)n->elt;
+      if (s->class && IS_AGGREGATE_TYPE(s->class)) {
+        reachClass(s->class, depth);
       }
     }
+  }
 
-    if (IS_MEMBER_VAR(var)) {
-      unsigned int i = 0;
-      SimpleList* superList = NULL;
-      SimpleNode* curNode = NULL;
+  // ... and member variables one level deeper:
+  if (agg->memberClassList) {
+    for (n = agg->memberClassList->first; n != NULL; n = n->next) {
+      reachClass((TypeEntry*)n->elt, depth + 1);
+    }
+  }
+}
 
-      // If its a static member it won't have a parent.  (markro)
-      if (!var->memberVar->structParentType) 
-          return DISREGARD_PTR_DEREFS;
+static void reachVariable(VariableEntry* var) {
+  if (fjalar_ignore_constants && var->isConstant) {
+    return;
+  }
+  if (var->varType && IS_AGGREGATE_TYPE(var->varType)) {
+    reachClass(var->varType, 0);
+  }
+}
 
-      tl_assert(var->memberVar && var->memberVar->structParentType);
-      DPRINTF("Harvest object %s\n", var->memberVar->structParentType->typeName);
+static void startReaching(void) {
+  if (!reach_depth) {
+    reach_depth = VG_(calloc)("decls-output.c: startReaching",
+                              numAggregateTypes + 1, sizeof(*reach_depth));
+    reached = VG_(calloc)("decls-output.c: startReaching.2",
+                          numAggregateTypes + 1, sizeof(*reached));
+  }
+  num_reached = 0;
+}
 
-      if(!gencontains(cur_object_table, var->memberVar->structParentType)) {
-        genputtable(cur_object_table, var->memberVar->structParentType, (void *)(ptrdiff_t)cur_par_id);
-        cur_par_id++;
-      }
+static int compareObjectIndices(const void* a, const void* b) {
+  UInt indexA = (*(TypeEntry* const*)a)->aggType->objectIndex;
+  UInt indexB = (*(TypeEntry* const*)b)->aggType->objectIndex;
+  return (indexA > indexB) - (indexA < indexB);
+}
 
-      // We can't be the member of a type that isn't an aggregate.
-      tl_assert(var->memberVar->structParentType->aggType);
-      superList = var->memberVar->structParentType->aggType->superclassList;
-      if(!superList) {
-        return DISREGARD_PTR_DEREFS;
-      }
+// Returns the classes reached since startReaching() (leaving out
+// those in global_objects, if it's been worked out) and clears the
+// state of the search
+static FunctionObjects* finishReaching(void) {
+  FunctionObjects* objects =
+    VG_(calloc)("decls-output.c: finishReaching", 1, sizeof(*objects));
+  UInt i;
+
+  objects->types =
+    VG_(malloc)("decls-output.c: finishReaching.2",
+                (num_reached ? num_reached : 1) * sizeof(*objects->types));
+  for (i = 0; i < num_reached; i++) {
+    TypeEntry* t = reached[i];
+    reach_depth[t->aggType->objectIndex] = 0;
+    if (!in_global_objects || !in_global_objects[t->aggType->objectIndex]) {
+      objects->types[objects->numTypes++] = t;
+    }
+  }
+  num_reached = 0;
 
-      curNode = superList->first;
+  VG_(ssort)(objects->types, objects->numTypes, sizeof(*objects->types),
+             compareObjectIndices);
+  return objects;
+}
 
-      while(curNode && (i < superList->numElts)) {
-        Superclass* curClass = curNode->elt;
+// A global variable that every function sees (see visitVariableGroup())
+static Bool isSeenEverywhere(VariableEntry* var) {
+  return var->globalVar->isExternal || fjalar_all_static_vars;
+}
 
-        if(!gencontains(cur_object_table, curClass->class)) {
-          genputtable(cur_object_table, curClass->class, (void *)(ptrdiff_t)cur_par_id);
-          cur_par_id++;
-        }
-        DPRINTF("Harvest object %s - %u\n", curClass->class->typeName, cur_par_id);
+static FunctionObjects* getGlobalObjects(void) {
+  VarIterator* varIt;
+  UInt i;
 
-        curNode = curNode->next;
-        i++;
-      }
+  if (global_objects) {
+    return global_objects;
+  }
 
+  startReaching();
+  if (!fjalar_ignore_globals) {
+    varIt = newVarIterator(&globalVars);
+    while (hasNextVar(varIt)) {
+      VariableEntry* var = nextVar(varIt);
+      if (!var->name ||
+          (!var->globalVar->isExternal && fjalar_ignore_static_vars)) {
+        continue;
+      }
+      if (isSeenEverywhere(var)) {
+        reachVariable(var);
+      }
+      else if (var->varType && IS_AGGREGATE_TYPE(var->varType)) {
+        SimpleListInsert(&static_object_vars, var);
+      }
     }
+    deleteVarIterator(varIt);
   }
+  global_objects = finishReaching();
 
-  return DISREGARD_PTR_DEREFS;
+  in_global_objects = VG_(calloc)("decls-output.c: getGlobalObjects",
+                                  numAggregateTypes + 1, sizeof(UChar));
+  for (i = 0; i < global_objects->numTypes; i++) {
+    in_global_objects[global_objects->types[i]->aggType->objectIndex] = 1;
+  }
+
+  return global_objects;
 }
 
+// Returns the classes whose :::OBJECT program points are parents of
+// funcPtr's program points, other than those in getGlobalObjects()
+static FunctionObjects* getFunctionObjects(FunctionEntry* funcPtr) {
+  DaikonFunctionEntry* dfunc = (DaikonFunctionEntry*)funcPtr;
+  VarIterator* varIt;
+  SimpleNode* n;
 
+  if (dfunc->objects) {
+    return dfunc->objects;
+  }
 
-static void harvestOneFunctionObject(FunctionEntry* func, struct genhashtable* object_set) {
-  DPRINTF("Harvesting objects for %s (%p)\n", func->name, func);
+  // (so that finishReaching() leaves them out)
+  getGlobalObjects();
 
-  cur_object_table = object_set;
-  cur_par_id = 1;
+  DPRINTF("Finding the objects of %s (%p)\n", funcPtr->name, funcPtr);
+  startReaching();
 
-  if(func->parentClass && !gencontains(cur_object_table, func->parentClass)) {
-      genputtable(cur_object_table, func->parentClass, (void *)(ptrdiff_t)cur_par_id);
-      cur_par_id++;
+  if (funcPtr->parentClass && IS_AGGREGATE_TYPE(funcPtr->parentClass)) {
+    reachClass(funcPtr->parentClass, 0);
   }
 
-  visitVariableGroup(GLOBAL_VAR,
-                     func,
-                     False,
-                     0,
-                     0,
-                     &harvestObject);
-
-  visitVariableGroup(FUNCTION_FORMAL_PARAM,
-                     func,
-                     True,
-                     0,
-                     0,
-                     &harvestObject);
-
-  cur_object_table = NULL;
-}
+  varIt = newVarIterator(&funcPtr->formalParameters);
+  while (hasNextVar(varIt)) {
+    VariableEntry* var = nextVar(varIt);
+    if (var->name) {
+      reachVariable(var);
+    }
+  }
+  deleteVarIterator(varIt);
+
+  // The file-static variables that visitVariableGroup() would visit
+  // at funcPtr's program points:
+  for (n = static_object_vars.first; n != NULL; n = n->next) {
+    VariableEntry* var = (VariableEntry*)n->elt;
+    if (var->globalVar->functionStartPC ?
+        (funcPtr->startPC == var->globalVar->functionStartPC) :
+        VG_STREQ(funcPtr->filename, var->globalVar->fileName)) {
+      reachVariable(var);
+    }
+  }
 
+  dfunc->objects = finishReaching();
+  return dfunc->objects;
+}
 
-static void harvestAllFunctionObjects(void) {
-  FuncIterator* funcIt = newFuncIterator();
-  tl_assert(funcObjectTable);
+// Returns the relation ID of the :::OBJECT program point of class t
+// among the parents of funcPtr's program points (0 if it isn't one)
+static UInt getObjectParentId(FunctionEntry* funcPtr, TypeEntry* t) {
+  FunctionObjects* objects = getFunctionObjects(funcPtr);
+  UInt index = IS_AGGREGATE_TYPE(t) ? t->aggType->objectIndex : 0;
+  UInt lo = 0, hi = objects->numTypes;
 
-  while (hasNextFunc(funcIt)) {
-    struct genhashtable* used_objects;
-    FunctionEntry* cur_entry= nextFunc(funcIt);
-    tl_assert(cur_entry);
-    used_objects = genallocateSMALLhashtable(NULL,
-                                             (int (*)(void *, void *)) &equivalentIDs);
+  if (!index) {
+    return 0;
+  }
+  if (in_global_objects[index]) {
+    return index;
+  }
 
-    harvestOneFunctionObject(cur_entry, used_objects);
-    genputtable(funcObjectTable, cur_entry, used_objects);
+  while (lo < hi) {
+    UInt mid = lo + (hi - lo) / 2;
+    UInt midIndex = objects->types[mid]->aggType->objectIndex;
+    if (midIndex == index) {
+      return index;
+    }
+    else if (midIndex < index) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
   }
+  return 0;
 }
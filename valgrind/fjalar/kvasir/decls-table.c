@@ -0,0 +1,498 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* decls-table.c:
+
+   The declarations of the program points only depend on the debugging
+   information and the command-line options, so they are worked out
+   once, by traversing the variables of every program point, and kept
+   as text.  The only thing that isn't known then is the comparability
+   of each variable with DynComp, so the table also records where each
+   comparability line goes and which variable it is for.  At the end
+   of execution, DC_outputDeclsAtEnd() writes the text back out with
+   the comparability lines filled in, without another traversal.
+
+   With --decls-cache=<dir>, the table is also saved to <dir>, in a
+   file whose name is made from the name of the program and a key
+   that covers everything that the declarations depend on, and the
+   next run with the same program and options reads it from there
+   instead of traversing the variables at all.
+
+   The cache file consists of:
+
+     "KVDECLS1", then the key, the number of program points, the
+     number of variables and the size of the text (ULongs)
+
+     for each program point: isEnter, numVarIndices, numVars and the
+     length of the fjalar_name of its function (UInts), then the
+     fjalar_name itself (without a NUL)
+
+     for each variable: varIndex (UInt) and end (ULong)
+
+     the text
+*/
+
+#include "../my_libc.h"
+
+#include "decls-table.h"
+#include "decls-output.h"
+#include "kvasir_main.h"
+
+#include "pub_tool_libcfile.h"
+
+#define DECLS_CACHE_MAGIC "KVDECLS1"
+
+char* decls_table_text = 0;
+ULong decls_table_text_size = 0;
+DeclsTablePpt* decls_table_ppts = 0;
+UInt decls_table_num_ppts = 0;
+DeclsTableVar* decls_table_vars = 0;
+UInt decls_table_num_vars = 0;
+Bool decls_table_recording = False;
+
+static UInt ppts_capacity = 0;
+static UInt vars_capacity = 0;
+
+// Where decls_fp pointed before recording, and the temporary file
+// that it points to while recording
+static FILE* saved_decls_fp = 0;
+static Int record_fd = -1;
+
+
+/*------------------------------------------------------------*/
+/*--- Recording                                            ---*/
+/*------------------------------------------------------------*/
+
+void decls_table_begin_ppt(FunctionEntry* funcPtr, char isEnter)
+{
+  DeclsTablePpt* ppt;
+
+  tl_assert(decls_table_recording);
+
+  if (decls_table_num_ppts == ppts_capacity) {
+    ppts_capacity = (ppts_capacity ? 2 * ppts_capacity : 256);
+    decls_table_ppts = VG_(realloc)("decls-table.c: decls_table_begin_ppt",
+                                    decls_table_ppts,
+                                    ppts_capacity * sizeof(DeclsTablePpt));
+  }
+
+  ppt = &decls_table_ppts[decls_table_num_ppts++];
+  ppt->func = funcPtr;
+  ppt->isEnter = isEnter;
+  ppt->numVarIndices = 0;
+  ppt->firstVar = decls_table_num_vars;
+  ppt->numVars = 0;
+}
+
+void decls_table_add_var(UInt varIndex)
+{
+  DeclsTableVar* var;
+
+  tl_assert(decls_table_recording && decls_table_num_ppts > 0);
+
+  if (decls_table_num_vars == vars_capacity) {
+    vars_capacity = (vars_capacity ? 2 * vars_capacity : 4096);
+    decls_table_vars = VG_(realloc)("decls-table.c: decls_table_add_var",
+                                    decls_table_vars,
+                                    vars_capacity * sizeof(DeclsTableVar));
+  }
+
+  var = &decls_table_vars[decls_table_num_vars++];
+  var->varIndex = varIndex;
+  var->end = my_libc_bytes_out(decls_fp);
+  decls_table_ppts[decls_table_num_ppts - 1].numVars++;
+}
+
+void decls_table_end_ppt(UInt numVarIndices)
+{
+  tl_assert(decls_table_recording && decls_table_num_ppts > 0);
+  decls_table_ppts[decls_table_num_ppts - 1].numVarIndices = numVarIndices;
+}
+
+void decls_table_begin_recording(void)
+{
+  HChar* tmpName;
+  FILE* fp;
+
+  tl_assert(!decls_table_recording && decls_fp);
+
+  tmpName = VG_(malloc)("decls-table.c: decls_table_begin_recording",
+                        VG_(mkstemp_fullname_bufsz)(VG_(strlen)("kvasir-decls")));
+  record_fd = VG_(mkstemp)("kvasir-decls", tmpName);
+  if (record_fd < 0) {
+    printf("Error: cannot create a temporary file for the declarations\n");
+    VG_(exit)(1);
+  }
+  VG_(unlink)(tmpName);
+  VG_(free)(tmpName);
+
+  fp = fdopen(record_fd, "w");
+  if (!fp) {
+    printf("Error: cannot write the declarations to a temporary file\n");
+    VG_(exit)(1);
+  }
+
+  saved_decls_fp = decls_fp;
+  decls_fp = fp;
+  decls_table_num_ppts = 0;
+  decls_table_num_vars = 0;
+  decls_table_recording = True;
+}
+
+static void saveToCache(void);
+
+void decls_table_end_recording(void)
+{
+  ULong done = 0;
+
+  tl_assert(decls_table_recording);
+  decls_table_recording = False;
+
+  fflush(decls_fp);
+  decls_table_text_size = my_libc_bytes_out(decls_fp);
+  decls_table_text = VG_(malloc)("decls-table.c: decls_table_end_recording",
+                                 decls_table_text_size + 1);
+
+  // Read the text back in through the file descriptor (the stream was
+  // only opened for writing)
+  VG_(lseek)(record_fd, 0, VKI_SEEK_SET);
+  while (done < decls_table_text_size) {
+    ULong left = decls_table_text_size - done;
+    Int n = VG_(read)(record_fd, decls_table_text + done,
+                      (left > 0x100000) ? 0x100000 : (Int)left);
+    if (n <= 0) {
+      printf("Error: cannot read the declarations back from a temporary file\n");
+      VG_(exit)(1);
+    }
+    done += n;
+  }
+  decls_table_text[decls_table_text_size] = '\0';
+
+  fclose(decls_fp);
+  decls_fp = saved_decls_fp;
+  saved_decls_fp = 0;
+  record_fd = -1;
+
+  if (kvasir_decls_cache_dirname) {
+    saveToCache();
+  }
+}
+
+
+/*------------------------------------------------------------*/
+/*--- The --decls-cache                                    ---*/
+/*------------------------------------------------------------*/
+
+// FNV-1a, 64 bits
+static void hashBytes(ULong* key, const void* bytes, SizeT len)
+{
+  const UChar* b = (const UChar*)bytes;
+  SizeT i;
+
+  for (i = 0; i < len; i++) {
+    *key ^= b[i];
+    *key *= 0x100000001b3ULL;
+  }
+}
+
+static void hashUInt(ULong* key, UInt n)
+{
+  hashBytes(key, &n, sizeof(n));
+}
+
+// A file is identified by its name, size and modification time (or
+// by the lack of a name)
+static void hashFile(ULong* key, const HChar* filename)
+{
+  struct vg_stat st;
+
+  if (!filename) {
+    hashUInt(key, 0);
+    return;
+  }
+
+  hashBytes(key, filename, VG_(strlen)(filename) + 1);
+  if (sr_isError(VG_(stat)(filename, &st))) {
+    hashUInt(key, 1);
+  }
+  else {
+    hashBytes(key, &st.size, sizeof(st.size));
+    hashBytes(key, &st.mtime, sizeof(st.mtime));
+    hashBytes(key, &st.mtime_nsec, sizeof(st.mtime_nsec));
+  }
+}
+
+// Everything that the declarations depend on.  An option that changes
+// what is declared must be added here, or a cache file written
+// without it could be used with it.
+static ULong cacheKey(void)
+{
+  ULong key = 0xcbf29ce484222325ULL;
+
+  hashFile(&key, executable_filename);
+  hashFile(&key, fjalar_trace_library);
+  hashFile(&key, fjalar_trace_prog_pts_filename);
+  hashFile(&key, fjalar_trace_vars_filename);
+  hashFile(&key, fjalar_disambig_filename);
+
+  hashUInt(&key, fjalar_ignore_constants);
+  hashUInt(&key, fjalar_merge_constants);
+  hashUInt(&key, fjalar_ignore_globals);
+  hashUInt(&key, fjalar_ignore_static_vars);
+  hashUInt(&key, fjalar_all_static_vars);
+  hashUInt(&key, fjalar_default_disambig);
+  hashUInt(&key, fjalar_smart_disambig);
+  hashUInt(&key, fjalar_output_struct_vars);
+  hashUInt(&key, fjalar_flatten_arrays);
+  hashUInt(&key, fjalar_func_disambig_ptrs);
+  hashUInt(&key, fjalar_disambig_ptrs);
+  hashUInt(&key, (UInt)fjalar_array_length_limit);
+  hashUInt(&key, fjalar_max_visit_struct_depth);
+  hashUInt(&key, fjalar_max_visit_nesting_depth);
+  hashUInt(&key, kvasir_object_ppts);
+  hashUInt(&key, kvasir_with_dyncomp);
+
+  return key;
+}
+
+// <dir>/<program>-<key>.decls-cache
+static HChar* cacheFilename(ULong key)
+{
+  const HChar* base = VG_(strrchr)(executable_filename, '/');
+  HChar* filename;
+
+  base = base ? base + 1 : executable_filename;
+  filename = VG_(malloc)("decls-table.c: cacheFilename",
+                         VG_(strlen)(kvasir_decls_cache_dirname) +
+                         VG_(strlen)(base) + 40);
+  VG_(sprintf)(filename, "%s/%s-%016llx.decls-cache",
+               kvasir_decls_cache_dirname, base, key);
+  return filename;
+}
+
+static void saveToCache(void)
+{
+  ULong key = cacheKey();
+  ULong header[4];
+  HChar* filename = cacheFilename(key);
+  HChar* tmpName;
+  FILE* fp;
+  UInt p, v;
+  Bool ok;
+
+  tmpName = VG_(malloc)("decls-table.c: saveToCache",
+                        VG_(strlen)(filename) + 5);
+  VG_(sprintf)(tmpName, "%s.tmp", filename);
+
+  fp = fopen(tmpName, "w");
+  if (!fp) {
+    printf("Warning: could not write the declarations to the cache file %s\n",
+           tmpName);
+    VG_(free)(tmpName);
+    VG_(free)(filename);
+    return;
+  }
+
+  header[0] = key;
+  header[1] = decls_table_num_ppts;
+  header[2] = decls_table_num_vars;
+  header[3] = decls_table_text_size;
+  ok = (fwrite(DECLS_CACHE_MAGIC, 8, 1, fp) == 1) &&
+       (fwrite(header, sizeof(header), 1, fp) == 1);
+
+  for (p = 0; ok && p < decls_table_num_ppts; p++) {
+    DeclsTablePpt* ppt = &decls_table_ppts[p];
+    UInt fields[4];
+
+    fields[0] = ppt->isEnter;
+    fields[1] = ppt->numVarIndices;
+    fields[2] = ppt->numVars;
+    fields[3] = VG_(strlen)(ppt->func->fjalar_name);
+    ok = (fwrite(fields, sizeof(fields), 1, fp) == 1) &&
+         (fwrite(ppt->func->fjalar_name, 1, fields[3], fp) == fields[3]);
+  }
+
+  for (v = 0; ok && v < decls_table_num_vars; v++) {
+    ok = (fwrite(&decls_table_vars[v].varIndex, sizeof(UInt), 1, fp) == 1) &&
+         (fwrite(&decls_table_vars[v].end, sizeof(ULong), 1, fp) == 1);
+  }
+
+  if (ok) {
+    ok = (fwrite(decls_table_text, 1, decls_table_text_size, fp) ==
+          decls_table_text_size);
+  }
+  if (fclose(fp) != 0) {
+    ok = False;
+  }
+
+  if (!ok || VG_(rename)(tmpName, filename) != 0) {
+    printf("Warning: could not write the declarations to the cache file %s\n",
+           filename);
+    VG_(unlink)(tmpName);
+  }
+
+  VG_(free)(tmpName);
+  VG_(free)(filename);
+}
+
+// The function program points that are declared, in the order in
+// which printAllFunctionDecls() declares them
+static Bool isDeclared(FunctionEntry* funcPtr)
+{
+  return !fjalar_trace_prog_pts_filename ||
+         prog_pts_tree_entry_found(funcPtr);
+}
+
+// Match the program points read from the cache file with the
+// functions of this run.  Returns False if they aren't the same.
+static Bool matchFunctions(HChar** names)
+{
+  FuncIterator* funcIt = newFuncIterator();
+  UInt p = 0;
+  Bool ok = True;
+
+  while (ok && hasNextFunc(funcIt)) {
+    FunctionEntry* cur_entry = nextFunc(funcIt);
+    UInt i;
+
+    if (!isDeclared(cur_entry)) {
+      continue;
+    }
+
+    // An ENTER and an EXIT program point
+    for (i = 0; ok && i < 2; i++) {
+      ok = (p < decls_table_num_ppts) &&
+           (decls_table_ppts[p].isEnter == (i == 0)) &&
+           VG_STREQ(names[p], cur_entry->fjalar_name);
+      if (ok) {
+        decls_table_ppts[p].func = cur_entry;
+        p++;
+      }
+    }
+  }
+  deleteFuncIterator(funcIt);
+
+  return ok && (p == decls_table_num_ppts);
+}
+
+Bool decls_table_load(void)
+{
+  ULong key;
+  ULong header[4];
+  HChar magic[8];
+  HChar* filename;
+  HChar** names = 0;
+  FILE* fp;
+  UInt p, v;
+  UInt numNames = 0;
+  Bool ok;
+
+  if (!kvasir_decls_cache_dirname) {
+    return False;
+  }
+
+  key = cacheKey();
+  filename = cacheFilename(key);
+  fp = fopen(filename, "r");
+  VG_(free)(filename);
+  if (!fp) {
+    return False;
+  }
+
+  ok = (fread(magic, 8, 1, fp) == 1) &&
+       (VG_(memcmp)(magic, DECLS_CACHE_MAGIC, 8) == 0) &&
+       (fread(header, sizeof(header), 1, fp) == 1) &&
+       (header[0] == key);
+
+  if (ok) {
+    decls_table_num_ppts = header[1];
+    decls_table_num_vars = header[2];
+    decls_table_text_size = header[3];
+    ppts_capacity = decls_table_num_ppts ? decls_table_num_ppts : 1;
+    vars_capacity = decls_table_num_vars ? decls_table_num_vars : 1;
+    decls_table_ppts = VG_(realloc)("decls-table.c: decls_table_load",
+                                    decls_table_ppts,
+                                    ppts_capacity * sizeof(DeclsTablePpt));
+    decls_table_vars = VG_(realloc)("decls-table.c: decls_table_load",
+                                    decls_table_vars,
+                                    vars_capacity * sizeof(DeclsTableVar));
+    names = VG_(calloc)("decls-table.c: decls_table_load",
+                        ppts_capacity, sizeof(HChar*));
+  }
+
+  for (p = 0; ok && p < decls_table_num_ppts; p++) {
+    DeclsTablePpt* ppt = &decls_table_ppts[p];
+    UInt fields[4];
+
+    ok = (fread(fields, sizeof(fields), 1, fp) == 1);
+    if (ok) {
+      ppt->func = 0;
+      ppt->isEnter = fields[0];
+      ppt->numVarIndices = fields[1];
+      ppt->numVars = fields[2];
+      ppt->firstVar = (p == 0) ? 0
+                      : decls_table_ppts[p - 1].firstVar + decls_table_ppts[p - 1].numVars;
+      names[p] = VG_(malloc)("decls-table.c: decls_table_load", fields[3] + 1);
+      numNames++;
+      ok = (fread(names[p], 1, fields[3], fp) == fields[3]);
+      names[p][fields[3]] = '\0';
+    }
+  }
+
+  for (v = 0; ok && v < decls_table_num_vars; v++) {
+    ok = (fread(&decls_table_vars[v].varIndex, sizeof(UInt), 1, fp) == 1) &&
+         (fread(&decls_table_vars[v].end, sizeof(ULong), 1, fp) == 1) &&
+         (decls_table_vars[v].end <= decls_table_text_size);
+  }
+
+  if (ok) {
+    decls_table_text = VG_(malloc)("decls-table.c: decls_table_load",
+                                   decls_table_text_size + 1);
+    ok = (fread(decls_table_text, 1, decls_table_text_size, fp) ==
+          decls_table_text_size);
+    decls_table_text[decls_table_text_size] = '\0';
+  }
+
+  fclose(fp);
+
+  if (ok) {
+    ok = (decls_table_num_ppts == 0) ||
+         (decls_table_ppts[decls_table_num_ppts - 1].firstVar +
+          decls_table_ppts[decls_table_num_ppts - 1].numVars == decls_table_num_vars);
+  }
+  if (ok) {
+    ok = matchFunctions(names);
+  }
+
+  for (p = 0; p < numNames; p++) {
+    VG_(free)(names[p]);
+  }
+  if (names) {
+    VG_(free)(names);
+  }
+
+  if (!ok) {
+    // Start over as if there were no cache file
+    if (decls_table_text) {
+      VG_(free)(decls_table_text);
+      decls_table_text = 0;
+    }
+    decls_table_text_size = 0;
+    decls_table_num_ppts = 0;
+    decls_table_num_vars = 0;
+    printf("Warning: ignoring the out-of-date declarations cache in %s\n",
+           kvasir_decls_cache_dirname);
+  }
+
+  return ok;
+}
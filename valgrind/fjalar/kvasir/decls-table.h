@@ -0,0 +1,80 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* decls-table.h:
+   The declarations of all program points, worked out once and kept
+   (and optionally cached across runs with --decls-cache) so that they
+   can be written out again without traversing any variables
+*/
+
+#ifndef DECLS_TABLE_H
+#define DECLS_TABLE_H
+
+#include "../fjalar_include.h"
+#include "../my_libc.h"
+
+// One function program point in the table
+typedef struct {
+  FunctionEntry* func;
+  UInt isEnter;
+  // The number of variables that were visited (g_variableIndex at the
+  // end of the program point), as allocate_ppt_structures() wants it
+  UInt numVarIndices;
+  // The variables declared, which are decls_table_vars[firstVar] to
+  // decls_table_vars[firstVar + numVars - 1]
+  UInt firstVar;
+  UInt numVars;
+} DeclsTablePpt;
+
+// One variable declared at a function program point
+typedef struct {
+  // Its index among the variables visited (g_variableIndex), which
+  // DynComp knows it by
+  UInt varIndex;
+  // Where its comparability line goes in decls_table_text (the end of
+  // the rest of its declaration)
+  ULong end;
+} DeclsTableVar;
+
+// The text of all function and :::OBJECT program point declarations,
+// without comparability lines, and the function program points and
+// their variables in the order in which they appear in it
+char* decls_table_text;
+ULong decls_table_text_size;
+DeclsTablePpt* decls_table_ppts;
+UInt decls_table_num_ppts;
+DeclsTableVar* decls_table_vars;
+UInt decls_table_num_vars;
+
+// True while the declarations are being written to the table (to
+// decls_fp, which then points to a temporary file)
+Bool decls_table_recording;
+
+// Try to fill in the table from the --decls-cache.  Returns True if
+// it was there; the caller must then set up what the traversal of
+// the program points would have.
+Bool decls_table_load(void);
+
+// Bracket writing the declarations to the table.  decls_fp is
+// redirected in between, and decls_table_end_recording() also saves
+// the table to the --decls-cache (if any).
+void decls_table_begin_recording(void);
+void decls_table_end_recording(void);
+
+// While recording: bracket a function program point, and note each
+// variable whose comparability line would come next
+void decls_table_begin_ppt(FunctionEntry* funcPtr, char isEnter);
+void decls_table_end_ppt(UInt numVarIndices);
+void decls_table_add_var(UInt varIndex);
+
+#endif
@@ -0,0 +1,749 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-columnar.c:
+
+   With --dtrace-columnar=<file>, Kvasir writes the executions of
+   program points to a column-oriented trace store instead of the
+   .dtrace file (which still gets the header and the declarations).
+   The samples of each program point are buffered until there are
+   COLUMNAR_SEGMENT_SAMPLES of them (or until the end), and then
+   written out as one segment:
+
+     UInt   numSamples, numVars
+     The program point's name (e.g., "..f(int):::ENTER") and the
+     Daikon names of its numVars variables, each followed by '\n'
+     Padding to a multiple of 8 bytes from the start of the file
+     ULong  seq[numSamples]     Position of each sample in the trace
+     UInt   nonce[numSamples]   this_invocation_nonce
+     Then for each variable (each part padded to a multiple of 8):
+       UInt   kind, elementSize
+       UChar  modbit[numSamples]
+       If kind is 't' (text):
+         UInt offset[numSamples + 1], then the characters of all of
+         the values as they would appear in the .dtrace file (value i
+         runs from offset[i] to offset[i + 1])
+       Otherwise:
+         numSamples values of elementSize bytes each, where kind is
+         the Python struct code of their type ('i' for int, 'd' for
+         double, ...).  Samples with modbit 2 are nonsensical (and
+         stored as 0).
+
+   Values of base types (the bulk of any trace) are stored raw like
+   this, so that a reader can use such a column as an array as it
+   is; anything else (pointers, strings, sequences) is stored as text.
+   A variable's samples within a segment all have the same form.
+
+   The file starts with "KVCOLUMN", a UInt version and a UInt 0, and
+   ends with an index of its segments (for each: ULong offset, UInt
+   numSamples, UInt numVars and the program point's name followed by
+   '\n', padded to 8 bytes), ULong indexOffset, ULong numSegments and
+   "KVCOLEND".  Everything is in the byte order of the traced machine.
+
+   fjalar/tools/columnar_to_dtrace.py turns a store back into .dtrace
+   records, in their original order.
+*/
+
+#include "../my_libc.h"
+
+#include "dtrace-columnar.h"
+#include "dtrace-staging.h"
+#include "decls-output.h"
+#include "kvasir_main.h"
+
+// The maximum number of samples in a segment
+#define COLUMNAR_SEGMENT_SAMPLES 4096
+
+#define COLUMNAR_VERSION 1
+
+// The kinds of column, besides the struct codes of base types:
+#define KIND_UNDECIDED 0   // Every sample so far was nonsensical
+#define KIND_TEXT      't'
+// (and of cells)
+#define KIND_MISSING   '-' // A nonsensical value
+
+// The value of one variable in the sample that is being recorded
+// (besides what was printed for it, which is in staged)
+typedef struct {
+  UInt textOffset;    // Value as text, in staged.text
+  UInt textLength;
+  char kind;          // KIND_TEXT, KIND_MISSING or a struct code
+  UChar modbit;
+  UChar elementSize;
+  UChar value[8];     // Raw value if kind is a struct code
+} StagedCell;
+
+// The samples of one variable at one program point
+typedef struct {
+  StagedVarId id;
+  char kind;
+  UInt elementSize;
+  UChar* modbits;
+  UChar* values;      // numSamples * elementSize bytes
+  UInt* offsets;      // For text: numSamples + 1 of them
+  char* text;
+  UInt textSize;
+  UInt textCapacity;
+} ColumnarColumn;
+
+// The samples of a program point that haven't been written yet
+typedef struct _ColumnarPpt {
+  FunctionEntry* func;
+  char isEnter;
+  UInt numVars;
+  UInt numSamples;
+  UInt capacity;      // Number of samples that the arrays have room for
+  ColumnarColumn* columns;
+  ULong* seqs;
+  UInt* nonces;
+  struct _ColumnarPpt* next;
+} ColumnarPpt;
+
+// An entry of the index at the end of the file
+typedef struct {
+  ULong offset;
+  UInt numSamples;
+  UInt numVars;
+  FunctionEntry* func;
+  char isEnter;
+} ColumnarSegment;
+
+Bool dtrace_columnar_active = False;
+
+static FILE* columnar_fp = 0;
+static ULong columnar_pos = 0;    // Bytes written to columnar_fp
+static const HChar* columnar_filename_pattern = 0;
+
+static ColumnarPpt* all_ppts = 0;
+static ULong next_seq = 0;
+
+static ColumnarSegment* segments = 0;
+static UInt num_segments = 0;
+static UInt segments_capacity = 0;
+
+// The sample that is being recorded
+static FunctionEntry* cur_func = 0;
+static char cur_is_enter = 0;
+static UInt cur_nonce = 0;
+static StagedRecord staged;
+// The cell of each variable in staged
+static StagedCell* cells = 0;
+static UInt cells_capacity = 0;
+
+static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+
+static void columnarWrite(const void* buf, SizeT size)
+{
+  if (size && fwrite(buf, 1, size, columnar_fp) != size) {
+    printf("Error: failed writing to the --dtrace-columnar file\n");
+    VG_(exit)(1);
+  }
+  columnar_pos += size;
+}
+
+static void columnarPad(void)
+{
+  columnarWrite(zeros, (8 - (columnar_pos % 8)) % 8);
+}
+
+// After writing to columnar_fp directly (e.g., through
+// printDaikonFunctionName()), bring columnar_pos up to date
+static void columnarSyncPos(void)
+{
+  long pos = ftell(columnar_fp);
+  tl_assert(pos >= 0);
+  columnar_pos = pos;
+}
+
+static void openColumnarFile(const HChar* filename)
+{
+  UInt version[2] = { COLUMNAR_VERSION, 0 };
+
+  columnar_fp = fopen(filename, "w");
+  if (!columnar_fp) {
+    printf("Failed to open %s for --dtrace-columnar: %s\n",
+           filename, my_strerror(errno));
+    VG_(exit)(1);
+  }
+  columnar_pos = 0;
+  columnarWrite("KVCOLUMN", 8);
+  columnarWrite(version, sizeof(version));
+}
+
+
+// The struct code of the raw values of declared type decType, or 0
+// if they aren't stored raw
+static char kindOfDecType(DeclaredType decType)
+{
+  switch (decType) {
+  case D_BOOL:
+  case D_UNSIGNED_CHAR:          return 'B';
+  case D_CHAR:                   return 'b';
+  case D_UNSIGNED_SHORT:         return 'H';
+  case D_SHORT:                  return 'h';
+  case D_UNSIGNED_INT:           return 'I';
+  case D_INT:
+  case D_ENUMERATION:            return 'i';
+  case D_UNSIGNED_LONG:          return (sizeof(long) == 8) ? 'Q' : 'I';
+  case D_LONG:                   return (sizeof(long) == 8) ? 'q' : 'i';
+  case D_UNSIGNED_LONG_LONG_INT: return 'Q';
+  case D_LONG_LONG_INT:          return 'q';
+  case D_FLOAT:                  return 'f';
+  case D_DOUBLE:                 return 'd';
+  default:                       return 0;
+  }
+}
+
+// Print a raw value as dtrace-output.c would have (see
+// TYPE_FORMAT_STRINGS there)
+static int formatRawValue(char* buf, SizeT size, char kind, const UChar* value)
+{
+  switch (kind) {
+  case 'B': return snprintf(buf, size, "%u", *(const unsigned char*)value);
+  case 'b': return snprintf(buf, size, "%d", *(const signed char*)value);
+  case 'H': return snprintf(buf, size, "%hu", *(const unsigned short*)value);
+  case 'h': return snprintf(buf, size, "%hd", *(const short*)value);
+  case 'I': return snprintf(buf, size, "%u", *(const unsigned int*)value);
+  case 'i': return snprintf(buf, size, "%d", *(const int*)value);
+  case 'Q': return snprintf(buf, size, "%llu", *(const unsigned long long*)value);
+  case 'q': return snprintf(buf, size, "%lld", *(const long long*)value);
+  case 'f': return snprintf(buf, size, "%.9g", *(const float*)value);
+  case 'd': return snprintf(buf, size, "%.17g", *(const double*)value);
+  default:
+    tl_assert(0 && "formatRawValue() - unknown kind");
+    return 0;
+  }
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Recording a sample                                   ---*/
+/*------------------------------------------------------------*/
+
+void dtrace_columnar_begin_ppt(FunctionEntry* funcPtr, char isEnter)
+{
+  cur_func = funcPtr;
+  cur_is_enter = isEnter;
+  cur_nonce = funcPtr->nonce;
+  staged_record_clear(&staged);
+}
+
+void dtrace_columnar_begin_var(VariableEntry* var, const HChar* varName)
+{
+  tl_assert(cur_func);
+
+  staged_record_begin_var(&staged, var, varName);
+  if (staged.numVars > cells_capacity) {
+    cells_capacity = (cells_capacity ? 2 * cells_capacity : 64);
+    cells = VG_(realloc)("dtrace-columnar.c: dtrace_columnar_begin_var",
+                         cells, cells_capacity * sizeof(StagedCell));
+  }
+  cells[staged.numVars - 1].kind = KIND_TEXT;
+}
+
+void dtrace_columnar_printf(const char* format, ...)
+{
+  va_list ap;
+
+  va_start(ap, format);
+  staged_record_vprintf(&staged, format, ap);
+  va_end(ap);
+}
+
+void dtrace_columnar_puts(const char* s)
+{
+  staged_record_puts(&staged, s);
+}
+
+Bool dtrace_columnar_base_value(DeclaredType decType, Addr pValue)
+{
+  extern const int DecTypeByteSizes[];
+  StagedCell* cell = &cells[staged.numVars - 1];
+  char kind = kindOfDecType(decType);
+  int size = DecTypeByteSizes[decType];
+
+  tl_assert(staged.varOpen);
+
+  if (!kind || (size <= 0) || (size > (int)sizeof(cell->value))) {
+    return False;
+  }
+
+  cell->kind = kind;
+  cell->elementSize = size;
+  VG_(memcpy)(cell->value, (void*)pValue, size);
+  return True;
+}
+
+// Split what was printed for the variable ("<value>\n<modbit>\n")
+// into its value and its modbit
+void dtrace_columnar_end_var(void)
+{
+  StagedVar* sv = &staged.vars[staged.numVars - 1];
+  StagedCell* cell = &cells[staged.numVars - 1];
+  char* text;
+  UInt len;
+  int i;
+
+  staged_record_end_var(&staged);
+  text = STAGED_TEXT(&staged, sv);
+  len = sv->textLength;
+  cell->textOffset = sv->textOffset;
+
+  tl_assert((len >= 3) && (text[len - 1] == '\n'));
+  for (i = len - 2; (i >= 0) && (text[i] != '\n'); i--)
+    ;
+  tl_assert(i >= 0);
+
+  cell->modbit = text[i + 1] - '0';
+  cell->textLength = i;
+
+  if (cell->kind != KIND_TEXT) {
+    // A raw value; only the modbit was printed
+    tl_assert(cell->textLength == 0);
+  }
+  else if ((cell->modbit == 2) && (i == 11) &&
+           (VG_(strncmp)(text, "nonsensical", 11) == 0)) {
+    cell->kind = KIND_MISSING;
+  }
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Columns                                              ---*/
+/*------------------------------------------------------------*/
+
+static void appendColumnText(ColumnarColumn* col, UInt sample,
+                             const char* s, UInt len)
+{
+  if (col->textSize + len > col->textCapacity) {
+    col->textCapacity = (col->textCapacity ? 2 * col->textCapacity : 256);
+    while (col->textSize + len > col->textCapacity) {
+      col->textCapacity *= 2;
+    }
+    col->text = VG_(realloc)("dtrace-columnar.c: appendColumnText",
+                             col->text, col->textCapacity);
+  }
+  VG_(memcpy)(col->text + col->textSize, s, len);
+  col->textSize += len;
+  col->offsets[sample + 1] = col->textSize;
+}
+
+static void appendColumnRawValueAsText(ColumnarColumn* col, UInt sample,
+                                       char kind, const UChar* value)
+{
+  char buf[64];
+  int len = formatRawValue(buf, sizeof(buf), kind, value);
+  appendColumnText(col, sample, buf, len);
+}
+
+// Turn col into a text column, which has numSamples samples so far
+static void makeTextColumn(ColumnarPpt* ppt, ColumnarColumn* col,
+                           UInt numSamples)
+{
+  UChar* values = col->values;
+  char kind = col->kind;
+  UInt elementSize = col->elementSize;
+  UInt i;
+
+  col->offsets = VG_(malloc)("dtrace-columnar.c: makeTextColumn",
+                             (ppt->capacity + 1) * sizeof(UInt));
+  col->offsets[0] = 0;
+  col->textSize = 0;
+  col->kind = KIND_TEXT;
+  col->elementSize = 0;
+  col->values = 0;
+
+  for (i = 0; i < numSamples; i++) {
+    if (col->modbits[i] == 2) {
+      appendColumnText(col, i, "nonsensical", 11);
+    }
+    else {
+      appendColumnRawValueAsText(col, i, kind, values + i * elementSize);
+    }
+  }
+
+  if (values) {
+    VG_(free)(values);
+  }
+}
+
+// Turn col, all of whose numSamples samples so far are nonsensical,
+// into a column of raw values like cell's
+static void makeRawColumn(ColumnarPpt* ppt, ColumnarColumn* col,
+                          StagedCell* cell)
+{
+  col->kind = cell->kind;
+  col->elementSize = cell->elementSize;
+  col->values = VG_(calloc)("dtrace-columnar.c: makeRawColumn",
+                            ppt->capacity, col->elementSize);
+}
+
+static void appendCell(ColumnarPpt* ppt, ColumnarColumn* col,
+                       StagedCell* cell, UInt sample)
+{
+  col->modbits[sample] = cell->modbit;
+
+  if (cell->kind == KIND_MISSING) {
+    if (col->kind == KIND_TEXT) {
+      appendColumnText(col, sample, "nonsensical", 11);
+    }
+    else if (col->kind != KIND_UNDECIDED) {
+      VG_(memset)(col->values + sample * col->elementSize, 0, col->elementSize);
+    }
+    return;
+  }
+
+  if (col->kind == KIND_UNDECIDED) {
+    if (cell->kind == KIND_TEXT) {
+      makeTextColumn(ppt, col, sample);
+    }
+    else {
+      makeRawColumn(ppt, col, cell);
+    }
+  }
+  else if ((col->kind != KIND_TEXT) &&
+           ((col->kind != cell->kind) || (col->elementSize != cell->elementSize))) {
+    makeTextColumn(ppt, col, sample);
+  }
+
+  if (col->kind != KIND_TEXT) {
+    VG_(memcpy)(col->values + sample * col->elementSize,
+                cell->value, col->elementSize);
+  }
+  else if (cell->kind == KIND_TEXT) {
+    appendColumnText(col, sample, staged.text + cell->textOffset,
+                     cell->textLength);
+  }
+  else {
+    appendColumnRawValueAsText(col, sample, cell->kind, cell->value);
+  }
+}
+
+// Forget the samples of col (but not its variable)
+static void clearColumn(ColumnarColumn* col)
+{
+  if (col->values) {
+    VG_(free)(col->values);
+    col->values = 0;
+  }
+  if (col->offsets) {
+    VG_(free)(col->offsets);
+    col->offsets = 0;
+  }
+  col->kind = KIND_UNDECIDED;
+  col->elementSize = 0;
+  col->textSize = 0;
+}
+
+static void freeColumns(ColumnarPpt* ppt)
+{
+  UInt v;
+
+  for (v = 0; v < ppt->numVars; v++) {
+    ColumnarColumn* col = &ppt->columns[v];
+    clearColumn(col);
+    staged_var_id_free(&col->id);
+    VG_(free)(col->modbits);
+    if (col->text) {
+      VG_(free)(col->text);
+    }
+  }
+  if (ppt->columns) {
+    VG_(free)(ppt->columns);
+  }
+  ppt->columns = 0;
+  ppt->numVars = 0;
+}
+
+// Whether the staged sample has the same variables as ppt's columns
+static Bool sameVariables(ColumnarPpt* ppt)
+{
+  return staged_record_has_variables(&staged, &ppt->columns[0].id,
+                                     ppt->numVars, sizeof(ColumnarColumn));
+}
+
+// Set up ppt's columns for the variables of the staged sample
+static void setUpColumns(ColumnarPpt* ppt)
+{
+  UInt v;
+
+  freeColumns(ppt);
+  ppt->numVars = staged.numVars;
+  ppt->columns = VG_(calloc)("dtrace-columnar.c: setUpColumns",
+                             staged.numVars ? staged.numVars : 1,
+                             sizeof(ColumnarColumn));
+  for (v = 0; v < staged.numVars; v++) {
+    ColumnarColumn* col = &ppt->columns[v];
+    staged_var_id_set(&col->id, &staged, v);
+    col->modbits = VG_(malloc)("dtrace-columnar.c: setUpColumns",
+                               ppt->capacity ? ppt->capacity : 1);
+  }
+}
+
+// Make room in ppt for one more sample
+static void growPpt(ColumnarPpt* ppt)
+{
+  UInt capacity = (ppt->capacity ? 2 * ppt->capacity : 16);
+  UInt v;
+
+  if (capacity > COLUMNAR_SEGMENT_SAMPLES) {
+    capacity = COLUMNAR_SEGMENT_SAMPLES;
+  }
+  tl_assert(capacity > ppt->capacity);
+
+  ppt->seqs = VG_(realloc)("dtrace-columnar.c: growPpt",
+                           ppt->seqs, capacity * sizeof(ULong));
+  ppt->nonces = VG_(realloc)("dtrace-columnar.c: growPpt",
+                             ppt->nonces, capacity * sizeof(UInt));
+  for (v = 0; v < ppt->numVars; v++) {
+    ColumnarColumn* col = &ppt->columns[v];
+    col->modbits = VG_(realloc)("dtrace-columnar.c: growPpt",
+                                col->modbits, capacity);
+    if (col->values) {
+      col->values = VG_(realloc)("dtrace-columnar.c: growPpt",
+                                 col->values, capacity * col->elementSize);
+    }
+    if (col->offsets) {
+      col->offsets = VG_(realloc)("dtrace-columnar.c: growPpt",
+                                  col->offsets, (capacity + 1) * sizeof(UInt));
+    }
+  }
+  ppt->capacity = capacity;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Writing segments                                     ---*/
+/*------------------------------------------------------------*/
+
+static void printPptName(FunctionEntry* func, char isEnter)
+{
+  printDaikonFunctionName(func, columnar_fp);
+  fputs(isEnter ? ENTER_PPT : EXIT_PPT, columnar_fp);
+  fputs("\n", columnar_fp);
+}
+
+// Write out the buffered samples of ppt as a segment
+static void writeSegment(ColumnarPpt* ppt)
+{
+  UInt n = ppt->numSamples;
+  UInt counts[2] = { n, ppt->numVars };
+  ColumnarSegment* seg;
+  UInt v;
+
+  if (n == 0) {
+    return;
+  }
+
+  if (num_segments == segments_capacity) {
+    segments_capacity = (segments_capacity ? 2 * segments_capacity : 256);
+    segments = VG_(realloc)("dtrace-columnar.c: writeSegment",
+                            segments, segments_capacity * sizeof(ColumnarSegment));
+  }
+  seg = &segments[num_segments++];
+  seg->offset = columnar_pos;
+  seg->numSamples = n;
+  seg->numVars = ppt->numVars;
+  seg->func = ppt->func;
+  seg->isEnter = ppt->isEnter;
+
+  columnarWrite(counts, sizeof(counts));
+  printPptName(ppt->func, ppt->isEnter);
+  for (v = 0; v < ppt->numVars; v++) {
+    printDaikonExternalVarName(ppt->columns[v].id.var, ppt->columns[v].id.name,
+                               columnar_fp);
+    fputs("\n", columnar_fp);
+  }
+  columnarSyncPos();
+  columnarPad();
+
+  columnarWrite(ppt->seqs, n * sizeof(ULong));
+  columnarWrite(ppt->nonces, n * sizeof(UInt));
+  columnarPad();
+
+  for (v = 0; v < ppt->numVars; v++) {
+    ColumnarColumn* col = &ppt->columns[v];
+    UInt header[2];
+
+    if (col->kind == KIND_UNDECIDED) {
+      makeTextColumn(ppt, col, n);
+    }
+    header[0] = col->kind;
+    header[1] = col->elementSize;
+
+    columnarWrite(header, sizeof(header));
+    columnarWrite(col->modbits, n);
+    columnarPad();
+    if (col->kind == KIND_TEXT) {
+      columnarWrite(col->offsets, (n + 1) * sizeof(UInt));
+      columnarWrite(col->text, col->textSize);
+    }
+    else {
+      columnarWrite(col->values, n * col->elementSize);
+    }
+    columnarPad();
+
+    clearColumn(col);
+  }
+
+  ppt->numSamples = 0;
+}
+
+void dtrace_columnar_end_ppt(void)
+{
+  DaikonFunctionEntry* dfunc = (DaikonFunctionEntry*)cur_func;
+  ColumnarPpt** slot;
+  ColumnarPpt* ppt;
+  UInt sample, v;
+
+  tl_assert(cur_func && !staged.varOpen);
+  cur_func = 0;
+
+  // A forked process without a store of its own
+  if (!columnar_fp) {
+    return;
+  }
+
+  slot = cur_is_enter ? &dfunc->columnar_entry_ppt : &dfunc->columnar_exit_ppt;
+  ppt = *slot;
+  if (!ppt) {
+    ppt = VG_(calloc)("dtrace-columnar.c: dtrace_columnar_end_ppt",
+                      1, sizeof(ColumnarPpt));
+    ppt->func = &dfunc->funcEntry;
+    ppt->isEnter = cur_is_enter;
+    ppt->next = all_ppts;
+    all_ppts = ppt;
+    *slot = ppt;
+  }
+
+  // The variables of a program point normally never change, but if
+  // they do, the new ones go to a new segment
+  if (!sameVariables(ppt)) {
+    writeSegment(ppt);
+    setUpColumns(ppt);
+  }
+
+  if (ppt->numSamples == ppt->capacity) {
+    growPpt(ppt);
+  }
+
+  sample = ppt->numSamples;
+  ppt->seqs[sample] = next_seq++;
+  ppt->nonces[sample] = cur_nonce;
+  for (v = 0; v < ppt->numVars; v++) {
+    appendCell(ppt, &ppt->columns[v], &cells[v], sample);
+  }
+  ppt->numSamples++;
+
+  if (ppt->numSamples == COLUMNAR_SEGMENT_SAMPLES) {
+    writeSegment(ppt);
+  }
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Starting and finishing                               ---*/
+/*------------------------------------------------------------*/
+
+void dtrace_columnar_start(const HChar* filename)
+{
+  HChar* expanded = 0;
+
+  if (VG_(strchr)(filename, '%')) {
+    columnar_filename_pattern = filename;
+    expanded = VG_(expand_file_name)("--dtrace-columnar", filename);
+    filename = expanded;
+  }
+
+  openColumnarFile(filename);
+  dtrace_columnar_active = True;
+
+  if (expanded) {
+    VG_(free)(expanded);
+  }
+}
+
+void dtrace_columnar_finish(void)
+{
+  ColumnarPpt* ppt;
+  ULong trailer[2];
+  UInt i;
+
+  if (!dtrace_columnar_active || !columnar_fp) {
+    return;
+  }
+
+  for (ppt = all_ppts; ppt; ppt = ppt->next) {
+    writeSegment(ppt);
+  }
+
+  trailer[0] = columnar_pos;
+  trailer[1] = num_segments;
+  for (i = 0; i < num_segments; i++) {
+    UInt counts[2] = { segments[i].numSamples, segments[i].numVars };
+    columnarWrite(&segments[i].offset, sizeof(ULong));
+    columnarWrite(counts, sizeof(counts));
+    printPptName(segments[i].func, segments[i].isEnter);
+    columnarSyncPos();
+    columnarPad();
+  }
+  columnarWrite(trailer, sizeof(trailer));
+  columnarWrite("KVCOLEND", 8);
+
+  fclose(columnar_fp);
+  columnar_fp = 0;
+}
+
+void dtrace_columnar_pre_fork(void)
+{
+  static Bool warned = False;
+
+  if (dtrace_columnar_active && !columnar_filename_pattern && !warned) {
+    printf("Warning: the program forked, but the --dtrace-columnar file name has no %%p; "
+           "the program point executions of the forked processes are not recorded\n");
+    warned = True;
+  }
+}
+
+void dtrace_columnar_post_fork_child(void)
+{
+  ColumnarPpt* ppt;
+  HChar* filename;
+
+  if (!dtrace_columnar_active) {
+    return;
+  }
+
+  for (ppt = all_ppts; ppt; ppt = ppt->next) {
+    UInt v;
+    for (v = 0; v < ppt->numVars; v++) {
+      clearColumn(&ppt->columns[v]);
+    }
+    ppt->numSamples = 0;
+  }
+  num_segments = 0;
+
+  if (columnar_fp) {
+    fpurge(columnar_fp);
+    fclose(columnar_fp);
+    columnar_fp = 0;
+  }
+
+  if (columnar_filename_pattern) {
+    filename = VG_(expand_file_name)("--dtrace-columnar",
+                                     columnar_filename_pattern);
+    openColumnarFile(filename);
+    VG_(free)(filename);
+  }
+}
@@ -0,0 +1,63 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-columnar.h:
+   Writes program point executions to a column-oriented trace store
+   instead of the .dtrace file (--dtrace-columnar)
+*/
+
+#ifndef DTRACE_COLUMNAR_H
+#define DTRACE_COLUMNAR_H
+
+#include "../fjalar_include.h"
+#include "../my_libc.h"
+
+// True while program point executions go to the --dtrace-columnar
+// file.  dtrace-output.c then hands everything that it would write
+// for them to the functions below instead of writing it to dtrace_fp.
+Bool dtrace_columnar_active;
+
+// Create the store (a %p in filename stands for the process ID)
+void dtrace_columnar_start(const HChar* filename);
+
+// Write out all buffered samples and the index, and close the store
+void dtrace_columnar_finish(void);
+
+// Before a fork(): warn (once) that the child's samples will be lost
+// if the file name has no %p
+void dtrace_columnar_pre_fork(void);
+
+// In the child of a fork(): drop the parent's buffered samples and
+// move on to a store of its own if the file name has a %p (or else
+// drop the child's samples too)
+void dtrace_columnar_post_fork_child(void);
+
+// Bracket the record of one execution of a program point, and within
+// it the value and modbit of each variable (which are passed to
+// dtrace_columnar_printf() and dtrace_columnar_puts() just as they
+// would otherwise go to fprintf(dtrace_fp, ...) and fputs())
+void dtrace_columnar_begin_ppt(FunctionEntry* funcPtr, char isEnter);
+void dtrace_columnar_end_ppt(void);
+void dtrace_columnar_begin_var(VariableEntry* var, const HChar* varName);
+void dtrace_columnar_end_var(void);
+
+void dtrace_columnar_printf(const char* format, ...)
+  __attribute__((__format__(__printf__,1,2)));
+void dtrace_columnar_puts(const char* s);
+
+// Record the value of base type decType at pValue as raw bytes
+// instead of printing it.  Returns False (and records nothing) if
+// values of decType can't be stored that way.
+Bool dtrace_columnar_base_value(DeclaredType decType, Addr pValue);
+
+#endif
@@ -0,0 +1,249 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-delta.c:
+
+   With --dtrace-delta, a program point record in the .dtrace file
+   only has the variables whose value or modbit differ from the
+   previous record of the same program point; the others are left
+   out.  The first record of each program point in a file (and any
+   record whose variables aren't the same as those of the previous
+   one) is written in full, preceded by a "# full" comment line, as
+   is every record once a fork() leaves two processes writing to the
+   same file.
+
+   Daikon can't read such a file as it is.
+   fjalar/tools/expand_delta_dtrace.py fills the missing variables
+   back in from the previous record of their program point.
+*/
+
+#include "../my_libc.h"
+
+#include "dtrace-delta.h"
+#include "dtrace-pipeline.h"
+#include "dtrace-staging.h"
+#include "decls-output.h"
+#include "kvasir_main.h"
+
+// A variable as it was last written for a program point
+typedef struct {
+  StagedVarId id;
+  char* text;         // "<value>\n<modbit>\n"
+  UInt textLength;
+  UInt textCapacity;
+} DeltaVar;
+
+// The previous record of a program point
+typedef struct _DeltaPpt {
+  UInt numVars;
+  DeltaVar* vars;
+  // The value of delta_generation when the record was written; if it
+  // has moved on since then, the next record must be written in full
+  UInt generation;
+} DeltaPpt;
+
+Bool dtrace_delta_active = False;
+
+// Starts at 1, so that a program point that hasn't been written yet
+// (with a generation of 0) is always written in full
+static UInt delta_generation = 1;
+
+// Set by dtrace_delta_stop_deltas()
+static Bool delta_always_full = False;
+
+// The record that is being put together (the value and modbit of
+// each variable, "<value>\n<modbit>\n", are its staged texts):
+static FunctionEntry* cur_func = 0;
+static char cur_is_enter = 0;
+static StagedRecord staged;
+
+
+/*------------------------------------------------------------*/
+/*--- Putting a record together                            ---*/
+/*------------------------------------------------------------*/
+
+void dtrace_delta_begin_ppt(FunctionEntry* funcPtr, char isEnter)
+{
+  cur_func = funcPtr;
+  cur_is_enter = isEnter;
+  staged_record_clear(&staged);
+}
+
+void dtrace_delta_begin_var(VariableEntry* var, const HChar* varName)
+{
+  tl_assert(cur_func);
+  staged_record_begin_var(&staged, var, varName);
+}
+
+void dtrace_delta_printf(const char* format, ...)
+{
+  va_list ap;
+
+  va_start(ap, format);
+  staged_record_vprintf(&staged, format, ap);
+  va_end(ap);
+}
+
+void dtrace_delta_puts(const char* s)
+{
+  staged_record_puts(&staged, s);
+}
+
+void dtrace_delta_end_var(void)
+{
+  staged_record_end_var(&staged);
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Writing a record                                     ---*/
+/*------------------------------------------------------------*/
+
+static void deltaPuts(const char* s)
+{
+  if (dtrace_pipeline_active) {
+    dtrace_pipeline_puts(s);
+  }
+  else {
+    fputs(s, dtrace_fp);
+  }
+}
+
+// Whether the staged record has the same variables as the previous
+// record of ppt
+static Bool sameVariables(DeltaPpt* ppt)
+{
+  return staged_record_has_variables(&staged, &ppt->vars[0].id,
+                                     ppt->numVars, sizeof(DeltaVar));
+}
+
+// Set up ppt's variables for those of the staged record
+static void setUpVariables(DeltaPpt* ppt)
+{
+  UInt v;
+
+  for (v = 0; v < ppt->numVars; v++) {
+    staged_var_id_free(&ppt->vars[v].id);
+    if (ppt->vars[v].text) {
+      VG_(free)(ppt->vars[v].text);
+    }
+  }
+  if (ppt->vars) {
+    VG_(free)(ppt->vars);
+  }
+
+  ppt->numVars = staged.numVars;
+  ppt->vars = VG_(calloc)("dtrace-delta.c: setUpVariables",
+                          staged.numVars ? staged.numVars : 1,
+                          sizeof(DeltaVar));
+  for (v = 0; v < staged.numVars; v++) {
+    staged_var_id_set(&ppt->vars[v].id, &staged, v);
+  }
+}
+
+static void rememberText(DeltaVar* dv, const char* text, UInt len)
+{
+  if (len > dv->textCapacity) {
+    dv->textCapacity = (len < 32) ? 32 : len;
+    dv->text = VG_(realloc)("dtrace-delta.c: rememberText",
+                            dv->text, dv->textCapacity);
+  }
+  VG_(memcpy)(dv->text, text, len);
+  dv->textLength = len;
+}
+
+void dtrace_delta_end_ppt(void)
+{
+  DaikonFunctionEntry* dfunc = (DaikonFunctionEntry*)cur_func;
+  DeltaPpt** slot;
+  DeltaPpt* ppt;
+  Bool full;
+  UInt v;
+
+  tl_assert(cur_func && !staged.varOpen);
+  cur_func = 0;
+
+  slot = cur_is_enter ? &dfunc->delta_entry_ppt : &dfunc->delta_exit_ppt;
+  ppt = *slot;
+  if (!ppt) {
+    ppt = VG_(calloc)("dtrace-delta.c: dtrace_delta_end_ppt",
+                      1, sizeof(DeltaPpt));
+    *slot = ppt;
+  }
+
+  full = delta_always_full ||
+         (ppt->generation != delta_generation) || !sameVariables(ppt);
+  if (full) {
+    setUpVariables(ppt);
+    ppt->generation = delta_generation;
+  }
+
+  deltaPuts("\n");
+  if (full) {
+    deltaPuts("# full\n");
+  }
+  if (dtrace_pipeline_active) {
+    dtrace_pipeline_function_name(&dfunc->funcEntry);
+    dtrace_pipeline_puts(cur_is_enter ? ENTER_PPT : EXIT_PPT);
+    dtrace_pipeline_puts("\n");
+    dtrace_pipeline_printf("this_invocation_nonce\n%u\n", dfunc->funcEntry.nonce);
+  }
+  else {
+    printDaikonFunctionName(&dfunc->funcEntry, dtrace_fp);
+    fputs(cur_is_enter ? ENTER_PPT : EXIT_PPT, dtrace_fp);
+    fputs("\n", dtrace_fp);
+    fprintf(dtrace_fp, "this_invocation_nonce\n%u\n", dfunc->funcEntry.nonce);
+  }
+
+  for (v = 0; v < staged.numVars; v++) {
+    DeltaVar* dv = &ppt->vars[v];
+    StagedVar* sv = &staged.vars[v];
+    const char* text = STAGED_TEXT(&staged, sv);
+    UInt len = sv->textLength;
+
+    if (!full && (len == dv->textLength) &&
+        (VG_(memcmp)(text, dv->text, len) == 0)) {
+      continue;
+    }
+
+    if (dtrace_pipeline_active) {
+      dtrace_pipeline_var_name(sv->var, dv->id.name);
+    }
+    else {
+      printDaikonExternalVarName(sv->var, dv->id.name, dtrace_fp);
+    }
+    deltaPuts("\n");
+    deltaPuts(text);
+    rememberText(dv, text, len);
+  }
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Starting and resetting                               ---*/
+/*------------------------------------------------------------*/
+
+void dtrace_delta_start(void)
+{
+  dtrace_delta_active = True;
+}
+
+void dtrace_delta_reset(void)
+{
+  delta_generation++;
+}
+
+void dtrace_delta_stop_deltas(void)
+{
+  delta_always_full = True;
+}
@@ -0,0 +1,56 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-delta.h:
+   Writes only the variables that changed since the previous execution
+   of the same program point to the .dtrace file (--dtrace-delta)
+*/
+
+#ifndef DTRACE_DELTA_H
+#define DTRACE_DELTA_H
+
+#include "../fjalar_include.h"
+#include "../my_libc.h"
+
+// True while program point records are delta-encoded.  dtrace-output.c
+// then hands everything that it would write for a record to the
+// functions below, which write it out (to dtrace_fp or through
+// --dtrace-pipeline) once the record is complete.
+Bool dtrace_delta_active;
+
+void dtrace_delta_start(void);
+
+// Forget the previous executions of all program points, so that the
+// next record of each is written in full.  Call this whenever the
+// records start going to a new file.
+void dtrace_delta_reset(void);
+
+// Write every record from now on in full.  Call this in both processes
+// when a fork() leaves them appending to the same file, where the
+// previous record of a program point may have come from the other one.
+void dtrace_delta_stop_deltas(void);
+
+// Bracket the record of one execution of a program point, and within
+// it the value and modbit of each variable (which are passed to
+// dtrace_delta_printf() and dtrace_delta_puts() just as they would
+// otherwise go to fprintf(dtrace_fp, ...) and fputs())
+void dtrace_delta_begin_ppt(FunctionEntry* funcPtr, char isEnter);
+void dtrace_delta_end_ppt(void);
+void dtrace_delta_begin_var(VariableEntry* var, const HChar* varName);
+void dtrace_delta_end_var(void);
+
+void dtrace_delta_printf(const char* format, ...)
+  __attribute__((__format__(__printf__,1,2)));
+void dtrace_delta_puts(const char* s);
+
+#endif
@@ -26,6 +26,11 @@
 #include "../my_libc.h"
 
 #include "dtrace-output.h"
+#include "dtrace-pipeline.h"
+#include "dtrace-columnar.h"
+#include "dtrace-delta.h"
+#include "dtrace-staging.h"
+#include "kvasir_stats.h"
 #include "decls-output.h"
 #include "kvasir_main.h"
 #include "../fjalar_include.h"
@@ -41,8 +46,49 @@
 #define max(a, b) ((a) < (b) ? (a) : (b))
 
 
-#define DTRACE_PRINTF(...) do { if (!dyncomp_without_dtrace) \
-       fprintf(dtrace_fp, __VA_ARGS__); } while (0)
+// True if program point executions go to the --dtrace-columnar
+// store rather than to the .dtrace file
+#define DTRACE_COLUMNAR (dtrace_columnar_active && !dyncomp_without_dtrace)
+
+// True if program point records are put together in full before
+// being written (delta-encoded) to the .dtrace file
+#define DTRACE_DELTA (dtrace_delta_active && !dyncomp_without_dtrace)
+
+// True while the value of a global variable is being collected for
+// --dtrace-reuse-globals (see "Reusing the output of unchanged global
+// variables" below) rather than written out
+static Bool capturing_value = False;
+static void captureValuePrintf(const char* format, ...)
+  __attribute__((__format__(__printf__,1,2)));
+static void captureValuePuts(const char* s);
+
+#define DTRACE_PRINTF(...) do { if (!dyncomp_without_dtrace) { \
+       if (capturing_value)                                         \
+         captureValuePrintf(__VA_ARGS__);                           \
+       else if (dtrace_columnar_active)                             \
+         dtrace_columnar_printf(__VA_ARGS__);                       \
+       else if (dtrace_delta_active)                                \
+         dtrace_delta_printf(__VA_ARGS__);                          \
+       else if (dtrace_pipeline_active)                             \
+         dtrace_pipeline_printf(__VA_ARGS__);                       \
+       else                                                         \
+         fprintf(dtrace_fp, __VA_ARGS__); } } while (0)
+
+// Like fputs(str, dtrace_fp), but also works with --dtrace-pipeline,
+// --dtrace-columnar, --dtrace-delta and --dtrace-reuse-globals
+#define DTRACE_PUTS(str) do { if (capturing_value) \
+       captureValuePuts(str);                               \
+     else if (DTRACE_COLUMNAR)                              \
+       dtrace_columnar_puts(str);                           \
+     else if (DTRACE_DELTA)                                 \
+       dtrace_delta_puts(str);                              \
+     else if (dtrace_pipeline_active)                       \
+       dtrace_pipeline_puts(str);                           \
+     else                                                   \
+       fputs(str, dtrace_fp); } while (0)
+
+ULong dtrace_vars_visited = 0;
+ULong dtrace_seq_elts_printed = 0;
 
 // Global variable storing the current variable name.
 // currently used for debugging comparability values
@@ -100,22 +146,44 @@ static void printDtraceFunctionHeader(FunctionEntry* funcPtr, char isEnter)
 {
   DPRINTF("Printing dtrace header for %s\n", funcPtr->fjalar_name);
   DPRINTF("dtrace_fp is %p\n", dtrace_fp);
+
+  // The store has the name and nonce in columns of their own
+  if (DTRACE_COLUMNAR) {
+    dtrace_columnar_begin_ppt(funcPtr, isEnter);
+    return;
+  }
+  // dtrace_delta_end_ppt() writes the header with the rest of the record
+  if (DTRACE_DELTA) {
+    dtrace_delta_begin_ppt(funcPtr, isEnter);
+    return;
+  }
+
   tl_assert(dtrace_fp);
 
-  fputs("\n", dtrace_fp);
-  printDaikonFunctionName(funcPtr, dtrace_fp);
+  DTRACE_PUTS("\n");
+  // Daikon skips comments, but tools/merge_thread_traces.py uses
+  // these to tell where each record came from:
+  if (kvasir_dtrace_per_thread) {
+    DTRACE_PRINTF("# thread %u\n", VG_(get_running_tid)());
+  }
+  if (dtrace_pipeline_active) {
+    dtrace_pipeline_function_name(funcPtr);
+  }
+  else {
+    printDaikonFunctionName(funcPtr, dtrace_fp);
+  }
 
   if (isEnter) {
-    fputs(ENTER_PPT, dtrace_fp);
-    fputs("\n", dtrace_fp);
-    fputs("this_invocation_nonce\n", dtrace_fp);
+    DTRACE_PUTS(ENTER_PPT);
+    DTRACE_PUTS("\n");
+    DTRACE_PUTS("this_invocation_nonce\n");
     DTRACE_PRINTF("%u\n", funcPtr->nonce);
 
   }
   else {
-    fputs(EXIT_PPT, dtrace_fp);
-    fputs("\n", dtrace_fp);
-    fputs("this_invocation_nonce\n", dtrace_fp);
+    DTRACE_PUTS(EXIT_PPT);
+    DTRACE_PUTS("\n");
+    DTRACE_PUTS("this_invocation_nonce\n");
     DTRACE_PRINTF("%u\n", funcPtr->nonce);
   }
 
@@ -578,6 +646,8 @@ static char printDtraceSequence(VariableEntry* var,
     return 0;
   }
 
+  dtrace_seq_elts_printed += numElts;
+
 
   // Pointer (put this check first before the IS_STRING(var) check so
   // that it will work even for pointers to strings):
@@ -727,8 +797,11 @@ char printDtraceSingleBaseValue(Addr pValue,
     }
     else {
       // This is where the acutal printing of the variable is done. This
-      // was a bit hard to figure out.
-      TYPES_SWITCH(DTRACE_PRINT_ONE_VAR)
+      // was a bit hard to figure out.  (--dtrace-columnar stores the
+      // raw value instead.)
+      if (!(DTRACE_COLUMNAR && dtrace_columnar_base_value(decType, pValue))) {
+        TYPES_SWITCH(DTRACE_PRINT_ONE_VAR)
+      }
 
       if (kvasir_with_dyncomp) {
         DYNCOMP_TPRINTF("dtrace call val_uf_union_tags_in_range(%p, %d) (single base)\n",
@@ -980,6 +1053,231 @@ void printDtraceStringSequence(VariableEntry* var,
   }
 }
 
+// Line 1 of a variable's .dtrace entry: its name
+static void printDtraceVarName(VariableEntry* var, const HChar* varName)
+{
+  // The DTRACE_PRINTF() macro had this condition, so we should
+  // follow it too ...
+  if (DTRACE_COLUMNAR) {
+    dtrace_columnar_begin_var(var, varName);
+  }
+  else if (DTRACE_DELTA) {
+    dtrace_delta_begin_var(var, varName);
+  }
+  else if (!dyncomp_without_dtrace) {
+    if (dtrace_pipeline_active) {
+      dtrace_pipeline_var_name(var, varName);
+    }
+    else {
+      printDaikonExternalVarName(var, varName, dtrace_fp);
+    }
+    DTRACE_PUTS("\n");
+  }
+}
+
+// Called once lines 2 & 3 (value and modbit) have been printed too
+static void finishDtraceVar(void)
+{
+  if (DTRACE_COLUMNAR) {
+    dtrace_columnar_end_var();
+  }
+  else if (DTRACE_DELTA) {
+    dtrace_delta_end_var();
+  }
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Reusing the output of unchanged global variables     ---*/
+/*------------------------------------------------------------*/
+
+// With --dtrace-reuse-globals, the first time that a global variable
+// is printed, the lines printed for it and for all variables derived
+// from it are kept, along with a copy of its bytes.  At later program
+// points, if its bytes are the same (and still initialized), the kept
+// lines are printed again without traversing the variable.  This is
+// only done for global variables whose lines depend on nothing but
+// their own bytes, i.e., ones without any pointers inside.
+
+typedef struct {
+  Bool reusable;     // False if the variable can't be reused at all
+  UInt byteSize;
+  UChar* bytes;      // The variable's bytes when vars were printed
+  Bool valid;        // True once vars is complete
+  // The variables printed for the global variable, with the
+  // "<value>\n<modbit>\n" of each as its staged text
+  StagedRecord vars;
+} ReusedGlobal;
+
+// VariableEntry* -> ReusedGlobal*
+static struct genhashtable* reused_globals = 0;
+
+// The global variable whose lines are being collected, or 0
+static ReusedGlobal* cur_reused_global = 0;
+
+static Bool varIsSelfContained(VariableEntry* var);
+
+static void captureValuePrintf(const char* format, ...)
+{
+  va_list ap;
+
+  va_start(ap, format);
+  staged_record_vprintf(&cur_reused_global->vars, format, ap);
+  va_end(ap);
+}
+
+static void captureValuePuts(const char* s)
+{
+  staged_record_puts(&cur_reused_global->vars, s);
+}
+
+// Start collecting the value of var (named varName), which is derived
+// from cur_reused_global
+static void beginCapturedValue(VariableEntry* var, const HChar* varName)
+{
+  staged_record_begin_var(&cur_reused_global->vars, var, varName);
+  capturing_value = True;
+}
+
+// Write out the value collected since beginCapturedValue()
+static void endCapturedValue(void)
+{
+  StagedRecord* rec = &cur_reused_global->vars;
+
+  capturing_value = False;
+  staged_record_end_var(rec);
+  DTRACE_PUTS(STAGED_TEXT(rec, &rec->vars[rec->numVars - 1]));
+}
+
+// Whether the lines printed for a variable of type t (with no
+// pointers to it) depend on nothing but the variable's bytes
+static Bool typeIsSelfContained(TypeEntry* t)
+{
+  if (!IS_AGGREGATE_TYPE(t)) {
+    return ((t->decType != D_NO_TYPE) && (t->decType != D_STRUCT_CLASS) &&
+            (t->decType != D_UNION) && (t->decType != D_FUNCTION) &&
+            (t->decType != D_VOID));
+  }
+
+  // Static members are stored elsewhere
+  if (t->aggType->staticMemberVarList &&
+      t->aggType->staticMemberVarList->numVars > 0) {
+    return False;
+  }
+  if (t->aggType->memberVarList) {
+    VarNode* n;
+    for (n = t->aggType->memberVarList->first; n; n = n->next) {
+      if (!varIsSelfContained(n->var)) {
+        return False;
+      }
+    }
+  }
+  if (t->aggType->superclassList) {
+    SimpleNode* n;
+    for (n = t->aggType->superclassList->first; n; n = n->next) {
+      Superclass* super = (Superclass*)n->elt;
+      if (!super->class || !typeIsSelfContained(super->class)) {
+        return False;
+      }
+    }
+  }
+  return True;
+}
+
+static Bool varIsSelfContained(VariableEntry* var)
+{
+  if (!var->varType || var->referenceLevels > 0) {
+    return False;
+  }
+  // Strings are printed up to their terminating NUL, which may not
+  // be inside a static array
+  if (IS_STRING(var)) {
+    return False;
+  }
+  if (var->ptrLevels > 0 &&
+      !(IS_STATIC_ARRAY_VAR(var) && var->ptrLevels == 1)) {
+    return False;
+  }
+  return typeIsSelfContained(var->varType);
+}
+
+static ReusedGlobal* lookUpReusedGlobal(VariableEntry* var)
+{
+  ReusedGlobal* rg;
+
+  if (!reused_globals) {
+    reused_globals =
+      genallocatehashtable(0, (int (*)(void *,void *)) &equivalentIDs);
+  }
+
+  rg = (ReusedGlobal*)gengettable(reused_globals, (void*)var);
+  if (!rg) {
+    rg = VG_(calloc)("dtrace-output.c: lookUpReusedGlobal",
+                     1, sizeof(ReusedGlobal));
+    if (varIsSelfContained(var) && var->varType->byteSize > 0) {
+      rg->byteSize = var->varType->byteSize;
+      if (IS_STATIC_ARRAY_VAR(var)) {
+        UInt i;
+        for (i = 0; i < var->staticArr->numDimensions; i++) {
+          rg->byteSize *= var->staticArr->upperBounds[i] + 1;
+        }
+      }
+      rg->reusable = (rg->byteSize > 0);
+    }
+    genputtable(reused_globals, (void*)var, rg);
+  }
+  return rg;
+}
+
+// BeforeGlobalVarAction for printDtraceForFunction(): prints the
+// kept lines of var and skips it if it hasn't changed, or else gets
+// ready to keep the lines that its traversal is about to print
+static Bool reuseGlobalVar(VariableEntry* var, Addr pValue,
+                           FunctionEntry* varFuncInfo, Bool isEnter)
+{
+  ReusedGlobal* rg = lookUpReusedGlobal(var);
+  (void)varFuncInfo; (void)isEnter;
+
+  tl_assert(!cur_reused_global);
+
+  if (!rg->reusable || !pValue ||
+      !addressIsInitialized(pValue, rg->byteSize)) {
+    return True;
+  }
+
+  if (rg->valid && VG_(memcmp)(rg->bytes, (void*)pValue, rg->byteSize) == 0) {
+    UInt i;
+    for (i = 0; i < rg->vars.numVars; i++) {
+      StagedVar* sv = &rg->vars.vars[i];
+      printDtraceVarName(sv->var, STAGED_NAME(&rg->vars, sv));
+      DTRACE_PUTS(STAGED_TEXT(&rg->vars, sv));
+      finishDtraceVar();
+    }
+    KVASIR_STATS_ADD(global_vars_reused, rg->vars.numVars);
+    return False;
+  }
+
+  if (!rg->bytes) {
+    rg->bytes = VG_(malloc)("dtrace-output.c: reuseGlobalVar", rg->byteSize);
+  }
+  VG_(memcpy)(rg->bytes, (void*)pValue, rg->byteSize);
+  rg->valid = False;
+  staged_record_clear(&rg->vars);
+  cur_reused_global = rg;
+  return True;
+}
+
+// AfterGlobalVarAction for printDtraceForFunction()
+static void doneWithGlobalVar(VariableEntry* var)
+{
+  (void)var;
+  if (cur_reused_global) {
+    cur_reused_global->valid = True;
+    cur_reused_global = 0;
+  }
+}
+
+
 // This is where all of the action happens!
 // Prints out a .dtrace entry for a variable.
 // This consists of 3 lines:
@@ -1011,6 +1309,7 @@ TraversalResult printDtraceEntryAction(VariableEntry* var,
                                        Bool isEnter) {
   char variableHasBeenObserved = 0;
   Addr firstInitElt = 0;
+  KvasirStatsActivity prevActivity;
 
   char isHashcode = (layersBeforeBase > 0);
 
@@ -1029,13 +1328,15 @@ TraversalResult printDtraceEntryAction(VariableEntry* var,
             (void*)(*(Addr *)pValue));
 
 
+  dtrace_vars_visited++;
+  KVASIR_STATS_INC(vars_visited);
+  prevActivity = kvasir_stats_enter(STATS_TIME_FORMATTING);
+
   // Line 1: Variable name
-    // The DTRACE_PRINTF() macro had this condition, so we should
-    // follow it too ...
-    if (!dyncomp_without_dtrace) {
-      printDaikonExternalVarName(var, varName, dtrace_fp);
-      fputs("\n", dtrace_fp);
-    }
+  printDtraceVarName(var, varName);
+  if (cur_reused_global) {
+    beginCapturedValue(var, varName);
+  }
 
   // Lines 2 & 3: Value and modbit
   if (isSequence) {
@@ -1062,6 +1363,13 @@ TraversalResult printDtraceEntryAction(VariableEntry* var,
                            disambigOverride);
   }
 
+  if (cur_reused_global) {
+    endCapturedValue();
+  }
+  finishDtraceVar();
+
+  kvasir_stats_leave(prevActivity);
+
   // DynComp post-processing after observing a variable:
   if (kvasir_with_dyncomp && variableHasBeenObserved) {
     Addr a = 0;
@@ -1153,8 +1461,6 @@ void printDtraceForFunction(FunctionExecutionState* f_state, char isEnter) {
   funcPtr = f_state->func;
   tl_assert(funcPtr);
 
-  ((DaikonFunctionEntry*)funcPtr)->num_invocations++;  
-
   DPRINTF("* %s %s at FP=%p, lowestSP=%p, startPC=%p\n",
           (isEnter ? "ENTER" : "EXIT "),
           f_state->func->fjalar_name,
@@ -1193,12 +1499,21 @@ static int exit_count = 0;
 #endif
 
   // Print out globals:
-  visitVariableGroup(GLOBAL_VAR,
-                     funcPtr,
-                     isEnter,
-                     0,
-                     0,
-                     &printDtraceEntryAction);
+  if (kvasir_dtrace_reuse_globals && !dyncomp_without_dtrace) {
+    visitGlobalVariables(funcPtr,
+                         isEnter,
+                         &printDtraceEntryAction,
+                         &reuseGlobalVar,
+                         &doneWithGlobalVar);
+  }
+  else {
+    visitVariableGroup(GLOBAL_VAR,
+                       funcPtr,
+                       isEnter,
+                       0,
+                       0,
+                       &printDtraceEntryAction);
+  }
   //  print_info = 0;
 
   // Print out function formal parameters:
@@ -1238,10 +1553,21 @@ static int exit_count = 0;
     decls_fp = saved_decls_fp;
   }
 
+  // With --dtrace-delta, nothing of the record has been written yet:
+  if (DTRACE_DELTA) {
+    dtrace_delta_end_ppt();
+  }
+
   // Flush the buffer so that everything for this program point gets
   // printed to the .dtrace file (useful for observing executions of
   // interactive programs):
-  if (dtrace_fp) {
+  if (DTRACE_COLUMNAR) {
+    dtrace_columnar_end_ppt();
+  }
+  else if (dtrace_pipeline_active) {
+    dtrace_pipeline_flush();
+  }
+  else if (dtrace_fp) {
     fflush(dtrace_fp);
   }
 
@@ -26,4 +26,10 @@
 
 void printDtraceForFunction(FunctionExecutionState* f_state, char isEnter);
 
+// Running totals of the Daikon variables visited and of the sequence
+// elements printed by printDtraceForFunction() (for per-ppt cost
+// accounting)
+ULong dtrace_vars_visited;
+ULong dtrace_seq_elts_printed;
+
 #endif
@@ -0,0 +1,635 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-pipeline.c:
+
+   With --dtrace-pipeline, Kvasir does not format and write the
+   .dtrace file itself.  Instead, it appends compact raw records to a
+   ring buffer in memory that it shares with a writer process, which
+   it forks once the top of the .dtrace file has been written.  The
+   writer formats the records and writes (and possibly gzips) them
+   while the target program keeps running.
+
+   The writer is a fork of Kvasir, so it has its own copy of all the
+   FunctionEntry and VariableEntry structures and of all string
+   constants.  A record therefore only needs to contain pointers to
+   those plus the raw values, and the writer produces exactly the
+   same bytes as the in-process path by making the same calls:
+
+   PIPE_OP_PRINTF     fprintf(dtrace_fp, format, args...): the format
+                      pointer followed by each argument, as 8 raw
+                      bytes (integers, pointers and doubles) or as
+                      NUL-terminated characters (strings)
+   PIPE_OP_PUTS       fputs(str, dtrace_fp): the characters
+   PIPE_OP_FUNC_NAME  printDaikonFunctionName(): the FunctionEntry*
+   PIPE_OP_VAR_NAME   printDaikonExternalVarName(): the VariableEntry*
+                      and the characters of the variable name
+   PIPE_OP_SEGMENT    openDtraceSegment(): the segment number
+   PIPE_OP_END        the writer finishes the .dtrace file and exits
+
+   Every record starts with its size (a multiple of 8 bytes) and its
+   op.  There is exactly one producer (Kvasir, which runs one guest
+   thread at a time) and one consumer (the writer), so the ring needs
+   no locks: the producer only ever advances 'head' and the consumer
+   only ever advances 'tail'.
+*/
+
+#include "../my_libc.h"
+
+#include "dtrace-pipeline.h"
+#include "decls-output.h"
+#include "kvasir_main.h"
+#include "kvasir_stats.h"
+
+#include "pub_tool_aspacemgr.h"
+#include "pub_tool_libcfile.h"
+#include "pub_tool_libcproc.h"
+
+// The size of the ring buffer in bytes (must be a power of 2)
+#define DTRACE_PIPE_SIZE (1 << 24)
+
+#define PIPE_OP_PRINTF    1
+#define PIPE_OP_PUTS      2
+#define PIPE_OP_FUNC_NAME 3
+#define PIPE_OP_VAR_NAME  4
+#define PIPE_OP_SEGMENT   5
+#define PIPE_OP_END       6
+
+// How long the producer (when the ring is full) or the consumer
+// (when it is empty) waits before looking again, in milliseconds
+#define PIPE_WAIT_MS 1
+
+// The start of the shared memory; the ring data comes right after.
+// head and tail are free-running byte counts and are kept on
+// separate cache lines so that the two processes don't keep stealing
+// the line from one another.
+typedef struct {
+  volatile UWord head; // Bytes ever made visible by Kvasir
+  UWord padding1[15];
+  volatile UWord tail; // Bytes ever consumed by the writer
+  UWord padding2[15];
+} DtracePipeControl;
+
+Bool dtrace_pipeline_active = False;
+
+static DtracePipeControl* pipe_control = 0;
+static UChar* pipe_data = 0;
+static Int writer_pid = 0;
+
+// The producer's head, which is only published to pipe_control->head
+// by dtrace_pipeline_flush() (once per program point) or when the
+// producer has to wait for room
+static UWord pipe_head = 0;
+
+// The record currently being built (producer) or processed (writer)
+static UChar* record = 0;
+static UInt record_size = 0;
+static UInt record_capacity = 0;
+
+
+// The classes of printf() arguments, which determine how they are
+// passed through the pipe
+typedef enum {
+  ARG_NONE,      // "%%"
+  ARG_INT,       // also char and short, which are promoted to int
+  ARG_LONG,
+  ARG_LONG_LONG,
+  ARG_DOUBLE,
+  ARG_POINTER,
+  ARG_STRING
+} PipeArgClass;
+
+// Parses the conversion specification starting at spec (just past
+// the '%') into *argClass and returns a pointer just past it
+static const char* parseConversion(const char* spec, PipeArgClass* argClass)
+{
+  int longs = 0;
+  const char* p = spec;
+
+  while (*p && VG_(strchr)("-+ #0123456789.", *p)) {
+    p++;
+  }
+  // A '*' width or precision would take an extra argument:
+  tl_assert(*p != '*');
+
+  while (*p && VG_(strchr)("hlLqjzt", *p)) {
+    if (*p == 'l') {
+      longs++;
+    }
+    else if (*p == 'L' || *p == 'q' || *p == 'j') {
+      longs = 2;
+    }
+    else if (*p == 'z' || *p == 't') {
+      longs = 1;
+    }
+    p++;
+  }
+
+  switch (*p) {
+  case '%':
+    *argClass = ARG_NONE;
+    break;
+  case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+    *argClass = (longs == 0) ? ARG_INT :
+                (longs == 1) ? ARG_LONG : ARG_LONG_LONG;
+    break;
+  case 'f': case 'F': case 'g': case 'G': case 'e': case 'E':
+    *argClass = ARG_DOUBLE;
+    break;
+  case 'p':
+    *argClass = ARG_POINTER;
+    break;
+  case 's':
+    *argClass = ARG_STRING;
+    break;
+  default:
+    printf("Error: unsupported .dtrace format string \"%s\"\n", spec - 1);
+    tl_assert(0);
+  }
+
+  return p + 1;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Ring buffer                                          ---*/
+/*------------------------------------------------------------*/
+
+static void copyToRing(UWord pos, const void* buf, UInt len)
+{
+  UWord offset = pos & (DTRACE_PIPE_SIZE - 1);
+  UWord first = DTRACE_PIPE_SIZE - offset;
+
+  if (first >= len) {
+    VG_(memcpy)(pipe_data + offset, buf, len);
+  }
+  else {
+    VG_(memcpy)(pipe_data + offset, buf, first);
+    VG_(memcpy)(pipe_data, (const UChar*)buf + first, len - first);
+  }
+}
+
+static void copyFromRing(UWord pos, void* buf, UInt len)
+{
+  UWord offset = pos & (DTRACE_PIPE_SIZE - 1);
+  UWord first = DTRACE_PIPE_SIZE - offset;
+
+  if (first >= len) {
+    VG_(memcpy)(buf, pipe_data + offset, len);
+  }
+  else {
+    VG_(memcpy)(buf, pipe_data + offset, first);
+    VG_(memcpy)((UChar*)buf + first, pipe_data, len - first);
+  }
+}
+
+static void ensureRecordCapacity(UInt size)
+{
+  if (size > record_capacity) {
+    while (record_capacity < size) {
+      record_capacity = record_capacity ? record_capacity * 2 : 4096;
+    }
+    record = VG_(realloc)("dtrace-pipeline.c: ensureRecordCapacity",
+                          record, record_capacity);
+  }
+}
+
+static void recordStart(UInt op)
+{
+  ensureRecordCapacity(8);
+  // The size is filled in by recordSend():
+  ((UInt*)record)[1] = op;
+  record_size = 8;
+}
+
+static void recordAppend(const void* buf, UInt len)
+{
+  ensureRecordCapacity(record_size + len);
+  VG_(memcpy)(record + record_size, buf, len);
+  record_size += len;
+}
+
+static void recordAppendString(const char* s)
+{
+  recordAppend(s, VG_(strlen)(s) + 1);
+}
+
+// Appends the current record to the ring, waiting for the writer to
+// make room if necessary
+static void recordSend(void)
+{
+  UInt size = (record_size + 7) & ~7;
+
+  tl_assert(size <= DTRACE_PIPE_SIZE);
+  ensureRecordCapacity(size);
+  VG_(memset)(record + record_size, 0, size - record_size);
+  ((UInt*)record)[0] = size;
+
+  while (DTRACE_PIPE_SIZE -
+         (pipe_head - __atomic_load_n(&pipe_control->tail, __ATOMIC_ACQUIRE))
+         < size) {
+    KvasirStatsActivity prevActivity = kvasir_stats_enter(STATS_TIME_IO);
+    Int status;
+
+    // Let the writer see what we have so far, or we could wait
+    // forever:
+    __atomic_store_n(&pipe_control->head, pipe_head, __ATOMIC_RELEASE);
+
+    if (VG_(waitpid)(writer_pid, &status, VKI_WNOHANG) == writer_pid) {
+      printf("Error: the .dtrace writer process exited unexpectedly\n");
+      VG_(exit)(1);
+    }
+    VG_(poll)(NULL, 0, PIPE_WAIT_MS);
+    kvasir_stats_leave(prevActivity);
+  }
+
+  copyToRing(pipe_head, record, size);
+  pipe_head += size;
+  KVASIR_STATS_ADD(pipeline_bytes, size);
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Producer (Kvasir)                                    ---*/
+/*------------------------------------------------------------*/
+
+void dtrace_pipeline_printf(const char* format, ...)
+{
+  va_list ap;
+  const char* p = format;
+
+  recordStart(PIPE_OP_PRINTF);
+  recordAppend(&format, sizeof(format));
+
+  va_start(ap, format);
+  while (*p) {
+    PipeArgClass argClass;
+    ULong value = 0;
+
+    if (*p++ != '%') {
+      continue;
+    }
+
+    p = parseConversion(p, &argClass);
+    switch (argClass) {
+    case ARG_NONE:
+      continue;
+    case ARG_INT:
+      value = (ULong)(Long)va_arg(ap, int);
+      break;
+    case ARG_LONG:
+      value = (ULong)va_arg(ap, long);
+      break;
+    case ARG_LONG_LONG:
+      value = (ULong)va_arg(ap, long long);
+      break;
+    case ARG_DOUBLE: {
+      double d = va_arg(ap, double);
+      VG_(memcpy)(&value, &d, sizeof(d));
+      break;
+    }
+    case ARG_POINTER:
+      value = (ULong)(Addr)va_arg(ap, void*);
+      break;
+    case ARG_STRING:
+      recordAppendString(va_arg(ap, const char*));
+      continue;
+    }
+    recordAppend(&value, sizeof(value));
+  }
+  va_end(ap);
+
+  recordSend();
+}
+
+void dtrace_pipeline_puts(const char* s)
+{
+  recordStart(PIPE_OP_PUTS);
+  recordAppendString(s);
+  recordSend();
+}
+
+void dtrace_pipeline_function_name(FunctionEntry* funcPtr)
+{
+  recordStart(PIPE_OP_FUNC_NAME);
+  recordAppend(&funcPtr, sizeof(funcPtr));
+  recordSend();
+}
+
+void dtrace_pipeline_var_name(VariableEntry* var, const HChar* varName)
+{
+  recordStart(PIPE_OP_VAR_NAME);
+  recordAppend(&var, sizeof(var));
+  recordAppendString(varName);
+  recordSend();
+}
+
+void dtrace_pipeline_open_segment(UInt segment)
+{
+  recordStart(PIPE_OP_SEGMENT);
+  recordAppend(&segment, sizeof(segment));
+  recordSend();
+  dtrace_pipeline_flush();
+}
+
+void dtrace_pipeline_flush(void)
+{
+  __atomic_store_n(&pipe_control->head, pipe_head, __ATOMIC_RELEASE);
+}
+
+ULong dtrace_pipeline_bytes_sent(void)
+{
+  return pipe_head;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Consumer (the writer process)                        ---*/
+/*------------------------------------------------------------*/
+
+// Replays a PIPE_OP_PRINTF record whose arguments start at args
+static void replayPrintf(const char* format, const UChar* args)
+{
+  // Text between conversions is collected here and written out with
+  // fputs(), so that fprintf() is only ever called with a single
+  // conversion and its one argument:
+  char literal[256];
+  int literal_len = 0;
+  char spec[32];
+  const char* p = format;
+
+  while (*p) {
+    const char* specStart;
+    PipeArgClass argClass;
+    ULong value;
+    double d;
+
+    if (*p != '%') {
+      literal[literal_len++] = *p++;
+      if (literal_len == sizeof(literal) - 1) {
+        literal[literal_len] = '\0';
+        fputs(literal, dtrace_fp);
+        literal_len = 0;
+      }
+      continue;
+    }
+
+    specStart = p++;
+    p = parseConversion(p, &argClass);
+
+    if (argClass == ARG_NONE) {
+      literal[literal_len++] = '%';
+      continue;
+    }
+
+    if (literal_len > 0) {
+      literal[literal_len] = '\0';
+      fputs(literal, dtrace_fp);
+      literal_len = 0;
+    }
+
+    tl_assert(p - specStart < sizeof(spec));
+    VG_(strncpy)(spec, specStart, p - specStart);
+    spec[p - specStart] = '\0';
+
+    if (argClass == ARG_STRING) {
+      fprintf(dtrace_fp, spec, (const char*)args);
+      args += VG_(strlen)((const char*)args) + 1;
+      continue;
+    }
+
+    VG_(memcpy)(&value, args, sizeof(value));
+    args += sizeof(value);
+
+    switch (argClass) {
+    case ARG_INT:
+      fprintf(dtrace_fp, spec, (int)value);
+      break;
+    case ARG_LONG:
+      fprintf(dtrace_fp, spec, (long)value);
+      break;
+    case ARG_LONG_LONG:
+      fprintf(dtrace_fp, spec, (long long)value);
+      break;
+    case ARG_DOUBLE:
+      VG_(memcpy)(&d, &value, sizeof(d));
+      fprintf(dtrace_fp, spec, d);
+      break;
+    case ARG_POINTER:
+      fprintf(dtrace_fp, spec, (void*)(Addr)value);
+      break;
+    default:
+      tl_assert(0);
+    }
+  }
+
+  if (literal_len > 0) {
+    literal[literal_len] = '\0';
+    fputs(literal, dtrace_fp);
+  }
+}
+
+// Carries out the record in 'record'; returns False for PIPE_OP_END
+static Bool replayRecord(void)
+{
+  UInt op = ((UInt*)record)[1];
+  const UChar* payload = record + 8;
+
+  switch (op) {
+  case PIPE_OP_PRINTF: {
+    const char* format;
+    VG_(memcpy)(&format, payload, sizeof(format));
+    replayPrintf(format, payload + sizeof(format));
+    break;
+  }
+  case PIPE_OP_PUTS:
+    fputs((const char*)payload, dtrace_fp);
+    break;
+  case PIPE_OP_FUNC_NAME: {
+    FunctionEntry* funcPtr;
+    VG_(memcpy)(&funcPtr, payload, sizeof(funcPtr));
+    printDaikonFunctionName(funcPtr, dtrace_fp);
+    break;
+  }
+  case PIPE_OP_VAR_NAME: {
+    VariableEntry* var;
+    VG_(memcpy)(&var, payload, sizeof(var));
+    printDaikonExternalVarName(var, (const HChar*)(payload + sizeof(var)),
+                               dtrace_fp);
+    break;
+  }
+  case PIPE_OP_SEGMENT: {
+    UInt segment;
+    VG_(memcpy)(&segment, payload, sizeof(segment));
+    openDtraceSegment(segment);
+    break;
+  }
+  case PIPE_OP_END:
+    return False;
+  default:
+    printf("Error: corrupt .dtrace pipeline record (op %u)\n", op);
+    tl_assert(0);
+  }
+
+  return True;
+}
+
+// The main loop of the writer process (never returns)
+static void dtraceWriter(Int parent_pid)
+{
+  UWord tail = 0;
+
+  while (1) {
+    UWord head = __atomic_load_n(&pipe_control->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+      // Nothing to do: write out what we have, and stop if Kvasir
+      // went away without telling us
+      fflush(dtrace_fp);
+      if (VG_(getppid)() != parent_pid) {
+        VG_(exit)(1);
+      }
+      VG_(poll)(NULL, 0, PIPE_WAIT_MS);
+      continue;
+    }
+
+    while (tail != head) {
+      UInt size;
+
+      copyFromRing(tail, &size, sizeof(size));
+      tl_assert(size >= 8 && (size & 7) == 0 && size <= head - tail);
+      ensureRecordCapacity(size);
+      copyFromRing(tail, record, size);
+      tail += size;
+
+      if (!replayRecord()) {
+        __atomic_store_n(&pipe_control->tail, tail, __ATOMIC_RELEASE);
+        finishDtraceFile();
+        VG_(exit)(0);
+      }
+    }
+
+    __atomic_store_n(&pipe_control->tail, tail, __ATOMIC_RELEASE);
+  }
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Setup and teardown                                   ---*/
+/*------------------------------------------------------------*/
+
+void dtrace_pipeline_start(void)
+{
+  SizeT mapSize = sizeof(DtracePipeControl) + DTRACE_PIPE_SIZE;
+  HChar* tmpName;
+  Int fd, pid, parent_pid;
+  SysRes sr;
+
+  tl_assert(dtrace_fp && !dtrace_pipeline_active);
+
+  // Make a file-backed shared mapping (a temporary file which is
+  // removed right away) for the ring
+  tmpName = VG_(malloc)("dtrace-pipeline.c: dtrace_pipeline_start",
+                        VG_(mkstemp_fullname_bufsz)(VG_(strlen)("kvasir-dtrace")));
+  fd = VG_(mkstemp)("kvasir-dtrace", tmpName);
+  if (fd < 0) {
+    printf("Warning: cannot create a temporary file for --dtrace-pipeline; "
+           "writing the .dtrace file directly\n");
+    VG_(free)(tmpName);
+    return;
+  }
+  VG_(unlink)(tmpName);
+  VG_(free)(tmpName);
+
+  if (VG_(lseek)(fd, mapSize - 1, VKI_SEEK_SET) < 0 ||
+      VG_(write)(fd, "", 1) != 1) {
+    printf("Warning: cannot size the buffer for --dtrace-pipeline; "
+           "writing the .dtrace file directly\n");
+    VG_(close)(fd);
+    return;
+  }
+
+  sr = VG_(am_shared_mmap_file_float_valgrind)(mapSize,
+                                               VKI_PROT_READ | VKI_PROT_WRITE,
+                                               fd, 0);
+  VG_(close)(fd);
+  if (sr_isError(sr)) {
+    printf("Warning: cannot map the buffer for --dtrace-pipeline; "
+           "writing the .dtrace file directly\n");
+    return;
+  }
+
+  pipe_control = (DtracePipeControl*)sr_Res(sr);
+  pipe_data = (UChar*)(pipe_control + 1);
+  pipe_control->head = 0;
+  pipe_control->tail = 0;
+  pipe_head = 0;
+
+  // The writer takes over dtrace_fp, so it must start out empty:
+  fflush(dtrace_fp);
+
+  parent_pid = VG_(getpid)();
+  pid = VG_(fork)();
+  if (pid < 0) {
+    printf("Warning: cannot fork the --dtrace-pipeline writer; "
+           "writing the .dtrace file directly\n");
+    VG_(am_munmap_valgrind)((Addr)pipe_control, mapSize);
+    pipe_control = 0;
+    pipe_data = 0;
+    return;
+  }
+
+  if (pid == 0) {
+    // In the writer
+    dtraceWriter(parent_pid);
+  }
+
+  writer_pid = pid;
+  dtrace_pipeline_active = True;
+}
+
+void dtrace_pipeline_finish(void)
+{
+  Int status;
+
+  if (!dtrace_pipeline_active) {
+    return;
+  }
+
+  recordStart(PIPE_OP_END);
+  recordSend();
+  dtrace_pipeline_flush();
+
+  VG_(waitpid)(writer_pid, &status, 0);
+  writer_pid = 0;
+  dtrace_pipeline_active = False;
+}
+
+void dtrace_pipeline_post_fork_child(void)
+{
+  if (!dtrace_pipeline_active) {
+    return;
+  }
+
+  // There is only room for one producer in the ring.  (dtrace_fp,
+  // which the parent has not written to since the writer took it
+  // over, shares its file offset with the writer's copy, so the
+  // child's records end up after whatever the writer has written.)
+  VG_(am_munmap_valgrind)((Addr)pipe_control,
+                          sizeof(DtracePipeControl) + DTRACE_PIPE_SIZE);
+  pipe_control = 0;
+  pipe_data = 0;
+  pipe_head = 0;
+  writer_pid = 0;
+  dtrace_pipeline_active = False;
+}
@@ -0,0 +1,65 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-pipeline.h:
+   Hands .dtrace output over to a separate writer process through a
+   shared-memory ring buffer (--dtrace-pipeline)
+*/
+
+#ifndef DTRACE_PIPELINE_H
+#define DTRACE_PIPELINE_H
+
+#include "../fjalar_include.h"
+#include "../my_libc.h"
+
+// True while the writer process is running.  From then on, all
+// .dtrace output must go through the functions below; this process
+// must not write to dtrace_fp itself.
+Bool dtrace_pipeline_active;
+
+// Fork the writer process, which takes over dtrace_fp.  Call this
+// after everything that goes at the top of the .dtrace file has been
+// written.  If anything goes wrong, output stays in-process.
+void dtrace_pipeline_start(void);
+
+// Wait for the writer to write out everything and exit
+void dtrace_pipeline_finish(void);
+
+// In the child of a fork(): the ring and the writer belong to the
+// parent, so stop using them and write to dtrace_fp directly
+void dtrace_pipeline_post_fork_child(void);
+
+// Equivalents of fprintf(dtrace_fp, ...) and fputs(s, dtrace_fp).
+// format must be a string constant: only the pointer to it is passed
+// on to the writer.
+void dtrace_pipeline_printf(const char* format, ...)
+  __attribute__((__format__(__printf__,1,2)));
+void dtrace_pipeline_puts(const char* s);
+
+// Equivalents of printDaikonFunctionName(funcPtr, dtrace_fp) and
+// printDaikonExternalVarName(var, varName, dtrace_fp)
+void dtrace_pipeline_function_name(FunctionEntry* funcPtr);
+void dtrace_pipeline_var_name(VariableEntry* var, const HChar* varName);
+
+// Switch the writer over to trace segment 'segment' (see
+// openDtraceSegment() in kvasir_main.c)
+void dtrace_pipeline_open_segment(UInt segment);
+
+// Make everything sent so far visible to the writer; the equivalent
+// of fflush(dtrace_fp)
+void dtrace_pipeline_flush(void);
+
+// The number of bytes sent to the writer so far
+ULong dtrace_pipeline_bytes_sent(void);
+
+#endif
@@ -0,0 +1,150 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-staging.c:
+   Holds on to what dtrace-output.c prints for the variables of a
+   program point record until the record is complete (see
+   dtrace-staging.h).
+*/
+
+#include "../my_libc.h"
+
+#include "dtrace-staging.h"
+
+#include "pub_tool_libcassert.h"
+#include "pub_tool_libcbase.h"
+#include "pub_tool_mallocfree.h"
+
+static void ensureStagedText(StagedRecord* rec, UInt extra)
+{
+  if (rec->textSize + extra > rec->textCapacity) {
+    rec->textCapacity = (rec->textCapacity ? 2 * rec->textCapacity : 256);
+    while (rec->textSize + extra > rec->textCapacity) {
+      rec->textCapacity *= 2;
+    }
+    rec->text = VG_(realloc)("dtrace-staging.c: ensureStagedText",
+                             rec->text, rec->textCapacity);
+  }
+}
+
+static void appendStagedText(StagedRecord* rec, const char* s, UInt len)
+{
+  ensureStagedText(rec, len);
+  VG_(memcpy)(rec->text + rec->textSize, s, len);
+  rec->textSize += len;
+}
+
+void staged_record_clear(StagedRecord* rec)
+{
+  tl_assert(!rec->varOpen);
+  rec->numVars = 0;
+  rec->textSize = 0;
+}
+
+StagedVar* staged_record_begin_var(StagedRecord* rec, VariableEntry* var,
+                                   const HChar* varName)
+{
+  StagedVar* sv;
+
+  tl_assert(!rec->varOpen);
+
+  if (rec->numVars == rec->varsCapacity) {
+    rec->varsCapacity = (rec->varsCapacity ? 2 * rec->varsCapacity : 16);
+    rec->vars = VG_(realloc)("dtrace-staging.c: staged_record_begin_var",
+                             rec->vars, rec->varsCapacity * sizeof(StagedVar));
+  }
+
+  sv = &rec->vars[rec->numVars++];
+  sv->var = var;
+  sv->nameOffset = rec->textSize;
+  appendStagedText(rec, varName, VG_(strlen)(varName) + 1);
+  sv->textOffset = rec->textSize;
+  sv->textLength = 0;
+  rec->varOpen = True;
+  return sv;
+}
+
+void staged_record_end_var(StagedRecord* rec)
+{
+  StagedVar* sv = &rec->vars[rec->numVars - 1];
+
+  tl_assert(rec->varOpen);
+  rec->varOpen = False;
+  sv->textLength = rec->textSize - sv->textOffset;
+  // Terminate the text so that it can be handed to fputs() and the
+  // like as it is
+  appendStagedText(rec, "", 1);
+}
+
+void staged_record_vprintf(StagedRecord* rec, const char* format, va_list ap)
+{
+  va_list again;
+  UInt room;
+  int len;
+
+  tl_assert(rec->varOpen);
+
+  ensureStagedText(rec, 64);
+  room = rec->textCapacity - rec->textSize;
+  va_copy(again, ap);
+  len = vsnprintf(rec->text + rec->textSize, room, format, ap);
+  tl_assert(len >= 0);
+
+  if ((UInt)len >= room) {
+    ensureStagedText(rec, len + 1);
+    vsnprintf(rec->text + rec->textSize, len + 1, format, again);
+  }
+  va_end(again);
+  rec->textSize += len;
+}
+
+void staged_record_puts(StagedRecord* rec, const char* s)
+{
+  tl_assert(rec->varOpen);
+  appendStagedText(rec, s, VG_(strlen)(s));
+}
+
+void staged_var_id_set(StagedVarId* id, const StagedRecord* rec, UInt v)
+{
+  id->var = rec->vars[v].var;
+  id->name = VG_(strdup)("dtrace-staging.c: staged_var_id_set",
+                         STAGED_NAME(rec, &rec->vars[v]));
+}
+
+void staged_var_id_free(StagedVarId* id)
+{
+  if (id->name) {
+    VG_(free)(id->name);
+    id->name = 0;
+  }
+}
+
+Bool staged_record_has_variables(const StagedRecord* rec,
+                                 const StagedVarId* ids, UInt numIds,
+                                 SizeT stride)
+{
+  UInt v;
+
+  if (numIds != rec->numVars) {
+    return False;
+  }
+  for (v = 0; v < numIds; v++) {
+    const StagedVarId* id =
+      (const StagedVarId*)((const char*)ids + v * stride);
+    if ((id->var != rec->vars[v].var) ||
+        !VG_STREQ(id->name, STAGED_NAME(rec, &rec->vars[v]))) {
+      return False;
+    }
+  }
+  return True;
+}
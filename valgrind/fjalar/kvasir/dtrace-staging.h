@@ -0,0 +1,83 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-staging.h:
+   Holds on to what dtrace-output.c prints for the variables of a
+   program point record instead of writing it out right away, for
+   --dtrace-columnar, --dtrace-delta and --dtrace-reuse-globals
+*/
+
+#ifndef DTRACE_STAGING_H
+#define DTRACE_STAGING_H
+
+#include "../fjalar_include.h"
+#include "../my_libc.h"
+
+// What was printed for one variable
+typedef struct {
+  VariableEntry* var;
+  UInt nameOffset;    // Fjalar name of the variable, in text
+  UInt textOffset;    // What was printed for it, in text
+  UInt textLength;    // (without the terminating NUL)
+} StagedVar;
+
+// What was printed for some variables (all of a record's, or those of
+// a global variable), in the order in which they were printed
+typedef struct {
+  StagedVar* vars;
+  UInt numVars;
+  UInt varsCapacity;
+  char* text;         // The NUL-terminated names and texts
+  UInt textSize;
+  UInt textCapacity;
+  Bool varOpen;
+} StagedRecord;
+
+// Fjalar name and text of the staged variable sv of rec
+#define STAGED_NAME(rec, sv) ((rec)->text + (sv)->nameOffset)
+#define STAGED_TEXT(rec, sv) ((rec)->text + (sv)->textOffset)
+
+// Forget all variables of rec (but keep its memory for the next ones).
+// A StagedRecord that is all zeros is empty.
+void staged_record_clear(StagedRecord* rec);
+
+// Bracket what is printed for one variable, which goes to rec with
+// staged_record_vprintf() and staged_record_puts()
+StagedVar* staged_record_begin_var(StagedRecord* rec, VariableEntry* var,
+                                   const HChar* varName);
+void staged_record_end_var(StagedRecord* rec);
+
+void staged_record_vprintf(StagedRecord* rec, const char* format, va_list ap)
+  __attribute__((__format__(__printf__,2,0)));
+void staged_record_puts(StagedRecord* rec, const char* s);
+
+// A variable of an earlier record, kept to tell whether a later one
+// has the same variables
+typedef struct {
+  VariableEntry* var;
+  HChar* name;        // Fjalar name of the variable
+} StagedVarId;
+
+// Set id to (a copy of) the variable and name of rec->vars[v]; free
+// it again with staged_var_id_free()
+void staged_var_id_set(StagedVarId* id, const StagedRecord* rec, UInt v);
+void staged_var_id_free(StagedVarId* id);
+
+// Whether rec has the same variables (with the same names) as the
+// numIds StagedVarIds starting at ids, which are stride bytes apart
+// (e.g., the same member of each element of an array of structs)
+Bool staged_record_has_variables(const StagedRecord* rec,
+                                 const StagedVarId* ids, UInt numIds,
+                                 SizeT stride);
+
+#endif
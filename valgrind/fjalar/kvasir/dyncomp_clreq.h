@@ -0,0 +1,45 @@
+/*
+  This file is part of DynComp, a dynamic comparability analysis tool
+  for C/C++ based upon the Valgrind binary instrumentation framework
+  and the Valgrind MemCheck tool (Copyright (C) 2000-2009 Julian
+  Seward, jseward@acm.org)
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+*/
+
+/* dyncomp_clreq.h:
+   Client requests used by the wrappers in dyncomp_wrappers.c to
+   summarize library functions that DynComp does not instrument (see
+   --dyncomp-scope).  Each request names the wrapped function by the
+   address of its original code and does nothing if that code is
+   instrumented after all, since DynComp then already sees everything
+   the function does.  Each returns 1 if it did something and 0 if it
+   didn't, so that a wrapper can tell whether to do any more of the
+   summary itself.  These are internal to Kvasir: they are not part
+   of the fjalar.h ABI.
+*/
+
+#ifndef DYNCOMP_CLREQ_H
+#define DYNCOMP_CLREQ_H
+
+typedef
+   enum {
+      // (fn, base, nmemb, size): fn sorted the nmemb elements of size
+      // bytes at base, so any element may have ended up anywhere
+      VG_USERREQ__DYNCOMP_MODEL_PERMUTE = VG_USERREQ_TOOL_BASE('D','C'),
+      // (fn, buf, len): fn wrote a new value into the len bytes at buf
+      VG_USERREQ__DYNCOMP_MODEL_FRESH
+   } Vg_DynCompClientRequest;
+
+#endif
@@ -59,8 +59,11 @@
 #include "pub_tool_threadstate.h"
 #include "pub_tool_libcbase.h"
 #include "pub_tool_libcprint.h"
+#include "pub_tool_seqmatch.h"
+#include "pub_tool_clreq.h"
 #include "mc_include.h"
 #include "memcheck.h"
+#include "dyncomp_clreq.h"
 
 // Special reserved tags
 #define MY_UINT_MAX 0xffffffffU
@@ -196,6 +199,7 @@ UInt val_uf_tag_union(UInt tag1, UInt tag2) {
     tag1_obj = GET_UF_OBJECT_PTR(tag1);
     tag2_obj = GET_UF_OBJECT_PTR(tag2);
     leader = uf_union(tag1_obj, tag2_obj);
+    KVASIR_STATS_INC(unions);
     // Describe this (probably live) address with current epoch
     eip_info = VG_(describe_IP)(VG_(current_DiEpoch)(), eip, NULL);
 
@@ -234,6 +238,7 @@ void set_tag_for_GOT(Addr a, SizeT len) {
 // them
 VG_REGPARM(1)
 UInt MC_(helperc_TAG_NOP) ( UInt tag ) {
+   KVASIR_STATS_HELPER(STATS_HELPER_TAG_NOP);
    DYNCOMP_TPRINTF("[DynComp] TAG_NOP: %u \n", tag);
    return tag;
 }
@@ -255,6 +260,8 @@ VG_REGPARM(1)
 void MC_(helperc_STORE_TAG_8) ( Addr a, UInt tag ) {
   UInt tagToWrite;
 
+  KVASIR_STATS_HELPER(STATS_HELPER_STORE_TAG_8);
+
   if (WEAK_FRESH_TAG == tag) {
     tagToWrite = grab_fresh_tag();
   }
@@ -269,6 +276,7 @@ VG_REGPARM(2)
 void MC_(helperc_STORE_TAG_4) ( Addr a, UInt tag ) {
   UInt tagToWrite;
 
+  KVASIR_STATS_HELPER(STATS_HELPER_STORE_TAG_4);
 
   if (WEAK_FRESH_TAG == tag) {
     tagToWrite = grab_fresh_tag();
@@ -284,6 +292,8 @@ VG_REGPARM(2)
 void MC_(helperc_STORE_TAG_2) ( Addr a, UInt tag ) {
   UInt tagToWrite;
 
+  KVASIR_STATS_HELPER(STATS_HELPER_STORE_TAG_2);
+
   if (WEAK_FRESH_TAG == tag) {
     tagToWrite = grab_fresh_tag();
   }
@@ -298,6 +308,8 @@ VG_REGPARM(2)
 void MC_(helperc_STORE_TAG_1) ( Addr a, UInt tag ) {
   UInt tagToWrite;
 
+  KVASIR_STATS_HELPER(STATS_HELPER_STORE_TAG_1);
+
   if (WEAK_FRESH_TAG == tag) {
     tagToWrite = grab_fresh_tag();
   }
@@ -308,6 +320,13 @@ void MC_(helperc_STORE_TAG_1) ( Addr a, UInt tag ) {
   set_tag(a, tagToWrite);
 }
 
+// For stores by code outside of the --dyncomp-scope (see
+// clear_shadow_STle_DC())
+VG_REGPARM(2)
+void MC_(helperc_CLEAR_TAGS) ( Addr a, UWord len ) {
+  set_tag_for_range(a, len, 0);
+}
+
 // Unions the tags belonging to these addresses and set
 // the tags of both to the canonical tag (for efficiency)
 void val_uf_union_tags_at_addr(Addr a1, Addr a2) {
@@ -421,8 +440,10 @@ DYNCOMP_TPRINTF("MLR debug val_uf_union_tags_in_range addr=%p, tag=%u\n", (void
 // garbage-collected.
 VG_REGPARM(1)
 UInt MC_(helperc_CREATE_TAG)(Addr static_id) {
+  UInt newTag;
+  KVASIR_STATS_HELPER(STATS_HELPER_CREATE_TAG);
   DYNCOMP_TPRINTF("[DynComp] CREATE_TAG: %p =>\n", (void *)static_id);
-  UInt newTag = grab_fresh_tag();
+  newTag = grab_fresh_tag();
   (void)static_id;
   return newTag;
 }
@@ -430,6 +451,7 @@ UInt MC_(helperc_CREATE_TAG)(Addr static_id) {
 
 VG_REGPARM(1)
 UInt MC_(helperc_LOAD_TAG_8) ( Addr a ) {
+  KVASIR_STATS_HELPER(STATS_HELPER_LOAD_TAG_8);
   DYNCOMP_TPRINTF("[DynComp] LOAD_TAG_8: %p\n", (void *)a);
   return val_uf_union_tags_in_range(a, 8);
 }
@@ -437,6 +459,7 @@ UInt MC_(helperc_LOAD_TAG_8) ( Addr a ) {
 VG_REGPARM(1)
 UInt MC_(helperc_LOAD_TAG_4) ( Addr a ) {
   UInt first_tag = get_tag(a);
+  KVASIR_STATS_HELPER(STATS_HELPER_LOAD_TAG_4);
   if (first_tag == WEAK_FRESH_TAG) {
     DYNCOMP_TPRINTF("[DynComp] helperx_LOAD_ATG_4: %p =>\n", (void *)a);
     return grab_fresh_tag();
@@ -447,25 +470,18 @@ UInt MC_(helperc_LOAD_TAG_4) ( Addr a ) {
 
 VG_REGPARM(1)
 UInt MC_(helperc_LOAD_TAG_2) ( Addr a ) {
+  KVASIR_STATS_HELPER(STATS_HELPER_LOAD_TAG_2);
   DYNCOMP_TPRINTF("[DynComp] LOAD_TAG_2: %p\n", (void *)a);
   return val_uf_union_tags_in_range(a, 2);
 }
 
 VG_REGPARM(1)
 UInt MC_(helperc_LOAD_TAG_1) ( Addr a ) {
+  KVASIR_STATS_HELPER(STATS_HELPER_LOAD_TAG_1);
   DYNCOMP_TPRINTF("[DynComp] LOAD_TAG_1: %p => %u\n", (void *)a, get_tag(a));
   return val_uf_union_tags_in_range(a, 1);
 }
 
-// Make this const so gcc can eliminate dead code to improve
-// performance:
-const int dyncomp_profile_tags = 0;
-
-UInt mergeTagsCount = 0;
-UInt merge3TagsCount = 0;
-UInt merge4TagsCount = 0;
-UInt mergeTagsReturn0Count = 0;
-
 VG_REGPARM(2)
 UInt tag1_is_new ( UInt tag1, UInt tag2 ) {
   if IS_ZERO_TAG(tag2) {
@@ -496,9 +512,7 @@ UInt MC_(helperc_MERGE_TAGS) ( UInt tag1, UInt tag2 ) {
   // Describe this (probably live) address with current epoch
   eip_info = VG_(describe_IP)(VG_(current_DiEpoch)(), eip, NULL);
 
-  if (dyncomp_profile_tags) {
-    mergeTagsCount++;
-  }
+  KVASIR_STATS_HELPER(STATS_HELPER_MERGE_TAGS);
 
   // Important special case - if one of the tags is 0, then
   // simply return the OTHER tag and don't do any merging.
@@ -531,9 +545,7 @@ UInt MC_(helperc_MERGE_TAGS) ( UInt tag1, UInt tag2 ) {
 // right now (as it should be!):
 VG_REGPARM(3)
 UInt MC_(helperc_MERGE_3_TAGS) (UInt tag1, UInt tag2, UInt tag3) {
-  if (dyncomp_profile_tags) {
-    merge3TagsCount++;
-  }
+  KVASIR_STATS_HELPER(STATS_HELPER_MERGE_3_TAGS);
 
   return MC_(helperc_MERGE_TAGS)(MC_(helperc_MERGE_TAGS)(tag1, tag2),
                                  tag3);
@@ -542,9 +554,7 @@ UInt MC_(helperc_MERGE_3_TAGS) (UInt tag1, UInt tag2, UInt tag3) {
 // Uhhh, I can't do VG_REGPARM(4) :(
 VG_REGPARM(3)
 UInt MC_(helperc_MERGE_4_TAGS) (UInt tag1, UInt tag2, UInt tag3, UInt tag4) {
-  if (dyncomp_profile_tags) {
-    merge4TagsCount++;
-  }
+  KVASIR_STATS_HELPER(STATS_HELPER_MERGE_4_TAGS);
 
   return MC_(helperc_MERGE_TAGS)(MC_(helperc_MERGE_TAGS)(tag1, tag2),
                                  MC_(helperc_MERGE_TAGS)(tag3, tag4));
@@ -556,9 +566,7 @@ UInt MC_(helperc_MERGE_4_TAGS) (UInt tag1, UInt tag2, UInt tag3, UInt tag4) {
 // intended behavior for comparisons, for example).
 VG_REGPARM(2)
 UInt MC_(helperc_MERGE_TAGS_RETURN_0) ( UInt tag1, UInt tag2 ) {
-  if (dyncomp_profile_tags) {
-    mergeTagsReturn0Count++;
-  }
+  KVASIR_STATS_HELPER(STATS_HELPER_MERGE_TAGS_RETURN_0);
 
   // (comment added 2006)  
   // TODO: What do we do about WEAK_FRESH_TAG???
@@ -661,3 +669,153 @@ void clear_list(TagList* listPtr) {
 
   tl_assert(listPtr->numElts == 0);
 }
+
+
+/*------------------------------------------------------------------*/
+/*--- Instrumentation scope (--dyncomp-scope and friends)        ---*/
+/*------------------------------------------------------------------*/
+
+// Returns the part of path after the last '/'
+static const HChar* base_name(const HChar* path) {
+  const HChar* slash = VG_(strrchr)(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+// Returns True if name matches any of the comma-separated patterns
+// in list (which may be 0)
+static Bool matches_pattern_list(const HChar* list, const HChar* name) {
+  HChar pattern[256];
+  const HChar* start = list;
+
+  if (!list || !name) {
+    return False;
+  }
+
+  while (*start) {
+    const HChar* end = start;
+    SizeT len;
+    while (*end && *end != ',') {
+      end++;
+    }
+    len = end - start;
+    if (len > 0 && len < sizeof(pattern)) {
+      VG_(memcpy)(pattern, start, len);
+      pattern[len] = '\0';
+      if (VG_(string_match)(pattern, name)) {
+        return True;
+      }
+    }
+    start = *end ? end + 1 : end;
+  }
+  return False;
+}
+
+// Object patterns may be given either as full paths or as bare file
+// names
+static Bool object_matches_pattern_list(const HChar* list, const HChar* objname) {
+  return matches_pattern_list(list, objname) ||
+    matches_pattern_list(list, base_name(objname));
+}
+
+// Should DynComp instrument the code at address a, which is part of
+// the object objname?  (Called from MC_(instrument) for every block
+// that isn't part of the dynamic loader, which is never instrumented.)
+// Function patterns take precedence over object patterns, which take
+// precedence over --dyncomp-scope.
+Bool dyncomp_code_in_scope(const HChar* objname, Addr a) {
+  const HChar* fnname;
+  Bool in_scope;
+
+  if (!dyncomp_scope_main_only &&
+      !dyncomp_include_objects && !dyncomp_exclude_objects &&
+      !dyncomp_include_functions && !dyncomp_exclude_functions) {
+    return True;
+  }
+
+  // Our own preloaded code (the string function replacements and the
+  // wrappers in dyncomp_wrappers.c) is what keeps the tags right
+  // across calls into uninstrumented libraries, so always instrument
+  // it.
+  if (VG_(strstr)(base_name(objname), "vgpreload_")) {
+    return True;
+  }
+
+  if (dyncomp_include_functions || dyncomp_exclude_functions) {
+    if (VG_(get_fnname)(VG_(current_DiEpoch)(), a, &fnname)) {
+      if (matches_pattern_list(dyncomp_exclude_functions, fnname)) {
+        return False;
+      }
+      if (matches_pattern_list(dyncomp_include_functions, fnname)) {
+        return True;
+      }
+    }
+  }
+
+  if (object_matches_pattern_list(dyncomp_exclude_objects, objname)) {
+    return False;
+  }
+  if (object_matches_pattern_list(dyncomp_include_objects, objname)) {
+    return True;
+  }
+
+  in_scope = !dyncomp_scope_main_only ||
+    VG_STREQ(base_name(objname), base_name(executable_filename));
+  DYNCOMP_DPRINTF("[DynComp] %s is %s scope\n", objname,
+                  in_scope ? "in" : "out of");
+  return in_scope;
+}
+
+// Handles the requests in dyncomp_clreq.h, which the wrappers in
+// dyncomp_wrappers.c make after calling a library function (called
+// from mc_handle_client_request() in mc_main.c).  arg[1] is the
+// address of the function that was called; if it was instrumented,
+// its effect on the tags has already been tracked and there is
+// nothing to do.  *ret is 1 if the request was acted on, else 0.
+Bool dyncomp_handle_client_request(ThreadId tid, UWord* arg, UWord* ret) {
+  const HChar* objname = "UNKNOWN_OBJECT";
+  Addr fn = (Addr)arg[1];
+  DebugInfo* di;
+
+  if (arg[0] != VG_USERREQ__DYNCOMP_MODEL_PERMUTE &&
+      arg[0] != VG_USERREQ__DYNCOMP_MODEL_FRESH) {
+    return False;
+  }
+
+  *ret = 0;
+  if (!kvasir_with_dyncomp) {
+    return True;
+  }
+
+  di = VG_(find_DebugInfo)(VG_(current_DiEpoch)(), fn);
+  if (di) {
+    objname = VG_(DebugInfo_get_filename)(di);
+  }
+  if (dyncomp_code_in_scope(objname, fn)) {
+    return True;
+  }
+
+  switch (arg[0]) {
+  case VG_USERREQ__DYNCOMP_MODEL_PERMUTE: {
+    // Every element may now hold the value of any other, so make byte
+    // k of each element comparable with byte k of all the others
+    Addr base = (Addr)arg[2];
+    SizeT nmemb = (SizeT)arg[3];
+    SizeT size = (SizeT)arg[4];
+    SizeT i, k;
+    for (k = 0; k < size; k++) {
+      for (i = 1; i < nmemb; i++) {
+        val_uf_union_tags_at_addr(base + k, base + (i * size) + k);
+      }
+    }
+    break;
+  }
+  case VG_USERREQ__DYNCOMP_MODEL_FRESH:
+    // The old tags are stale; treat the new contents as a single new
+    // value
+    set_tag_for_range((Addr)arg[2], (SizeT)arg[3], grab_fresh_tag());
+    break;
+  }
+
+  *ret = 1;
+  return True;
+}
@@ -38,6 +38,7 @@
 #include "../mc_include.h"
 #include "union_find.h"
 #include "kvasir/dyncomp_runtime.h"
+#include "kvasir/kvasir_stats.h"
 
 //RUDD-MERGE, no longer in memcheck
 
@@ -131,6 +132,10 @@ UInt val_uf_union_tags_in_range(Addr a, SizeT len);
 void val_uf_union_tags_at_addr(Addr a1, Addr a2);
 void set_tag_for_GOT(Addr a, SizeT len);
 
+// Instrumentation scope (see --dyncomp-scope):
+Bool dyncomp_code_in_scope(const HChar* objname, Addr a);
+Bool dyncomp_handle_client_request(ThreadId tid, UWord* arg, UWord* ret);
+
 static __inline__ void set_tag ( Addr a, UInt tag )
 {
   if (IS_SECONDARY_TAG_MAP_NULL(a)) {
@@ -224,6 +229,7 @@ static __inline__ UInt grab_fresh_tag(void) {
   }
 
   totalNumTagsAssigned++;
+  KVASIR_STATS_INC(tags_created);
 #ifndef MAX_DEBUG_INFO
   if (dyncomp_print_trace_all) {
 #endif
@@ -285,6 +291,7 @@ extern VG_REGPARM(1) void MC_(helperc_STORE_TAG_8) ( Addr, UInt );
 extern VG_REGPARM(2) void MC_(helperc_STORE_TAG_4) ( Addr, UInt );
 extern VG_REGPARM(2) void MC_(helperc_STORE_TAG_2) ( Addr, UInt );
 extern VG_REGPARM(2) void MC_(helperc_STORE_TAG_1) ( Addr, UInt );
+extern VG_REGPARM(2) void MC_(helperc_CLEAR_TAGS) ( Addr, UWord );
 
 extern VG_REGPARM(1) UInt MC_(helperc_LOAD_TAG_8) ( Addr );
 extern VG_REGPARM(1) UInt MC_(helperc_LOAD_TAG_4) ( Addr );
@@ -28,6 +28,7 @@
 #include "../my_libc.h"
 
 #include "pub_tool_basics.h"
+#include "pub_tool_libcfile.h"
 #include "pub_tool_libcprint.h"
 #include "pub_tool_machine.h"
 #include "pub_tool_threadstate.h"
@@ -1078,6 +1079,7 @@ void garbage_collect_tags() {
   UInt* addr;
 
   Bool dyncomp_trace = dyncomp_print_trace_info;
+  KvasirStatsActivity prevActivity = kvasir_stats_enter(STATS_TIME_GC);
   dyncomp_print_trace_info = False;
 
   // Monotonically increases from 1 to whatever is necessary to map
@@ -1275,6 +1277,8 @@ void garbage_collect_tags() {
   printf("   Done garbage collecting (next tag = %u, total assigned = %u)\n",
               nextTag, totalNumTagsAssigned);
 
+  kvasir_stats_leave(prevActivity);
+
   //debug_print_decls();
   //dump_all_function_exit_var_map();
 }
@@ -1580,3 +1584,380 @@ void DC_convert_bitmatrix_to_sets(DaikonFunctionEntry* funcPtr,
     var_tags[var_index] = leader->tag;
   }
 }
+
+
+/*******************************************************************
+
+ Checkpoints (--dyncomp-checkpoint and --dyncomp-resume)
+
+ A checkpoint holds the variable comparability sets of every program
+ point as they stand, normalized to one set id per set (the same
+ format as --dyncomp-partitions):
+
+   dyncomp-partitions 1
+   separate-entry-exit no
+   ppt ..foo():::EXIT0
+   <variable index> <set id>
+   ...
+
+ Only the EXIT structures are written unless
+ --dyncomp-separate-entry-exit is on, since that's all there is.
+ Resuming from a checkpoint puts the variables of every set into one
+ set again before anything runs, so that whatever the new run
+ observes is added to what the earlier runs found.
+
+*******************************************************************/
+
+// Pre: parent[] is a forest over [0, n)
+static UInt find_root(UInt* parent, UInt i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+static void checkpoint_one_ppt(FILE* fp,
+                               DaikonFunctionEntry* funcPtr,
+                               char isEnter,
+                               struct genhashtable* set_ids,
+                               int* next_set_id) {
+  UInt num_daikon_vars;
+  UInt i, j;
+
+  num_daikon_vars = isEnter ? funcPtr->num_entry_daikon_vars :
+                              funcPtr->num_exit_daikon_vars;
+  if (num_daikon_vars == 0) {
+    return;
+  }
+
+  fputs("ppt ", fp);
+  printDaikonFunctionName(&funcPtr->funcEntry, fp);
+  fputs(isEnter ? ENTER_PPT : EXIT_PPT, fp);
+  fputs("\n", fp);
+
+  if (dyncomp_detailed_mode) {
+    // Collapse the pairs in the bitmatrix into sets, the same way that
+    // DC_convert_bitmatrix_to_sets() does at the end:
+    UChar* bitmatrix = isEnter ? funcPtr->ppt_entry_bitmatrix :
+                                 funcPtr->ppt_exit_bitmatrix;
+    UInt* parent = VG_(malloc)("dyncomp_runtime.c: checkpoint_one_ppt",
+                               num_daikon_vars * sizeof(*parent));
+    for (i = 0; i < num_daikon_vars; i++) {
+      parent[i] = i;
+    }
+    for (i = 0; i < num_daikon_vars; i++) {
+      for (j = i + 1; j < num_daikon_vars; j++) {
+        if (isMarked(bitmatrix, num_daikon_vars, i, j)) {
+          UInt root_i = find_root(parent, i);
+          UInt root_j = find_root(parent, j);
+          if (root_i < root_j) {
+            parent[root_j] = root_i;
+          }
+          else {
+            parent[root_i] = root_j;
+          }
+        }
+      }
+    }
+    for (i = 0; i < num_daikon_vars; i++) {
+      fprintf(fp, "%u %d\n", i, *next_set_id + (int)find_root(parent, i));
+    }
+    *next_set_id += num_daikon_vars;
+    VG_(free)(parent);
+  }
+  else {
+    struct genhashtable* var_uf_map = isEnter ? funcPtr->ppt_entry_var_uf_map :
+                                                funcPtr->ppt_exit_var_uf_map;
+    UInt* var_tags = isEnter ? funcPtr->ppt_entry_var_tags :
+                               funcPtr->ppt_exit_var_tags;
+    for (i = 0; i < num_daikon_vars; i++) {
+      int set_id;
+      if (var_tags[i] == 0) {
+        // Never observed, so it's in a set of its own
+        set_id = (*next_set_id)++;
+      }
+      else {
+        // The same leader as DC_get_comp_number_for_var() uses, but
+        // without changing any state
+        UInt leader = val_uf_find_leader(var_uf_map_find_leader(var_uf_map, var_tags[i]));
+        if (gencontains(set_ids, VoidPtr(leader))) {
+          set_id = (ptrdiff_t)gengettable(set_ids, VoidPtr(leader));
+        }
+        else {
+          set_id = (*next_set_id)++;
+          genputtable(set_ids, VoidPtr(leader), VoidPtr(set_id));
+        }
+      }
+      fprintf(fp, "%u %d\n", i, set_id);
+    }
+  }
+}
+
+// Write the current variable comparability sets of all program
+// points to filename (replacing it only once the new checkpoint is
+// complete, so that a crash while writing leaves the old one intact)
+void DC_write_checkpoint(const HChar* filename) {
+  FuncIterator* funcIt;
+  struct genhashtable* set_ids;
+  int next_set_id = 1;
+  HChar* tmpName;
+  FILE* fp;
+
+  tmpName = VG_(malloc)("dyncomp_runtime.c: DC_write_checkpoint",
+                        VG_(strlen)(filename) + 5);
+  VG_(sprintf)(tmpName, "%s.tmp", filename);
+
+  fp = fopen(tmpName, "w");
+  if (!fp) {
+    printf("Error: could not write the DynComp checkpoint to %s\n", tmpName);
+    VG_(free)(tmpName);
+    return;
+  }
+
+  fputs("dyncomp-partitions 1\n", fp);
+  fprintf(fp, "separate-entry-exit %s\n",
+          dyncomp_separate_entry_exit ? "yes" : "no");
+
+  set_ids = genallocatehashtable((unsigned int (*)(void *)) 0,
+                                 (int (*)(void *,void *)) &equivalentTags);
+
+  funcIt = newFuncIterator();
+  while (hasNextFunc(funcIt)) {
+    DaikonFunctionEntry* funcPtr = (DaikonFunctionEntry*)nextFunc(funcIt);
+    if (dyncomp_separate_entry_exit) {
+      checkpoint_one_ppt(fp, funcPtr, 1, set_ids, &next_set_id);
+    }
+    checkpoint_one_ppt(fp, funcPtr, 0, set_ids, &next_set_id);
+  }
+  deleteFuncIterator(funcIt);
+
+  genfreehashtable(set_ids);
+  fclose(fp);
+
+  if (VG_(rename)(tmpName, filename) != 0) {
+    printf("Error: could not rename %s to %s\n", tmpName, filename);
+  }
+  else {
+    DYNCOMP_DPRINTF("[DynComp] Wrote checkpoint to %s\n", filename);
+  }
+  VG_(free)(tmpName);
+}
+
+typedef struct {
+  UInt var_index;
+  int set_id;
+} CheckpointRecord;
+
+static Int compare_records_by_set(const void* a, const void* b) {
+  const CheckpointRecord* ra = (const CheckpointRecord*)a;
+  const CheckpointRecord* rb = (const CheckpointRecord*)b;
+  if (ra->set_id != rb->set_id) {
+    return (ra->set_id < rb->set_id) ? -1 : 1;
+  }
+  return (ra->var_index < rb->var_index) ? -1 : (ra->var_index > rb->var_index);
+}
+
+// Put the variables of every set in records (which belong to the
+// ENTER or EXIT structures of funcPtr) into one set
+static void resume_one_ppt(DaikonFunctionEntry* funcPtr,
+                           char isEnter,
+                           CheckpointRecord* records,
+                           UInt num_records) {
+  UInt num_daikon_vars;
+  UInt first, i, j;
+
+  num_daikon_vars = isEnter ? funcPtr->num_entry_daikon_vars :
+                              funcPtr->num_exit_daikon_vars;
+
+  VG_(ssort)(records, num_records, sizeof(*records), compare_records_by_set);
+
+  for (first = 0; first < num_records; first = i) {
+    UInt rep = records[first].var_index;
+
+    for (i = first + 1;
+         i < num_records && records[i].set_id == records[first].set_id;
+         i++)
+      ;
+
+    // Singleton sets need nothing, and indices that don't exist here
+    // mean that the checkpoint came from a different program:
+    if (i - first < 2) {
+      continue;
+    }
+    if (records[i - 1].var_index >= num_daikon_vars) {
+      printf("Warning: DynComp checkpoint has too many variables for %s; ignoring them\n",
+             funcPtr->funcEntry.name);
+      continue;
+    }
+
+    if (dyncomp_detailed_mode) {
+      UChar* bitmatrix = isEnter ? funcPtr->ppt_entry_bitmatrix :
+                                   funcPtr->ppt_exit_bitmatrix;
+      UInt a, b;
+      for (a = first; a < i; a++) {
+        for (b = a + 1; b < i; b++) {
+          // Sorted by index within the set, so a's is the smaller one:
+          if (records[a].var_index != records[b].var_index) {
+            mark(bitmatrix, num_daikon_vars,
+                 records[a].var_index, records[b].var_index);
+          }
+        }
+      }
+    }
+    else {
+      struct genhashtable* var_uf_map = isEnter ? funcPtr->ppt_entry_var_uf_map :
+                                                  funcPtr->ppt_exit_var_uf_map;
+      UInt* var_tags = isEnter ? funcPtr->ppt_entry_var_tags :
+                                 funcPtr->ppt_exit_var_tags;
+
+      // The first variable of the set gets a fresh tag (unless an
+      // earlier record already gave it one), and the others join its
+      // set.  (Always go through var_tags rather than holding on to
+      // the tag, since grab_fresh_tag() may garbage collect.)
+      if (!var_tags[rep]) {
+        UInt tag = grab_fresh_tag();
+        var_uf_map_insert_and_make_set(var_uf_map, tag);
+        var_tags[rep] = tag;
+      }
+      for (j = first + 1; j < i; j++) {
+        UInt v = records[j].var_index;
+        if (var_tags[v]) {
+          var_tags[v] = var_uf_map_union(var_uf_map, var_tags[v], var_tags[rep]);
+        }
+        else {
+          var_tags[v] = var_tags[rep];
+        }
+      }
+    }
+  }
+}
+
+// Apply the records collected for one program point (see
+// DC_resume_from_checkpoint()).  Without --dyncomp-separate-entry-exit
+// the ENTER records (which a --dyncomp-partitions file has) go to the
+// shared EXIT structures too.
+static void resume_ppt(DaikonFunctionEntry* funcPtr,
+                       char isEnter,
+                       CheckpointRecord* records,
+                       UInt num_records) {
+  if (!funcPtr || num_records == 0) {
+    return;
+  }
+
+  resume_one_ppt(funcPtr, isEnter && dyncomp_separate_entry_exit,
+                 records, num_records);
+}
+
+// Undo the escaping done by printDaikonFunctionName() (in place)
+static void unescape_ppt_name(HChar* name) {
+  HChar* out = name;
+  while (*name) {
+    if (name[0] == '\\' && name[1] == '_') {
+      *out++ = ' ';
+      name += 2;
+    }
+    else if (name[0] == '\\' && name[1] == '\\') {
+      *out++ = '\\';
+      name += 2;
+    }
+    else {
+      *out++ = *name++;
+    }
+  }
+  *out = '\0';
+}
+
+// Seed the variable comparability sets from a checkpoint (or from a
+// --dyncomp-partitions file).  Must be called after the ppt
+// structures have been allocated and before anything is traced.
+void DC_resume_from_checkpoint(const HChar* filename) {
+  static HChar buf[4096];
+  struct genhashtable* funcs_by_name;
+  FuncIterator* funcIt;
+  FILE* fp;
+  DaikonFunctionEntry* cur_func = 0;
+  char cur_is_enter = 0;
+  CheckpointRecord* records = 0;
+  UInt num_records = 0;
+  UInt max_records = 0;
+  UInt num_ppts = 0;
+
+  fp = fopen(filename, "r");
+  if (!fp) {
+    printf("\nError: cannot open DynComp checkpoint %s\nExiting.\n", filename);
+    VG_(exit)(1);
+  }
+
+  if (!fgets(buf, sizeof(buf), fp) ||
+      !VG_STREQN(21, buf, "dyncomp-partitions 1\n")) {
+    printf("\nError: %s is not a DynComp checkpoint\nExiting.\n", filename);
+    VG_(exit)(1);
+  }
+
+  funcs_by_name =
+    genallocatehashtable((unsigned int (*)(void *)) &hashString,
+                         (int (*)(void *,void *)) &equivalentStrings);
+  funcIt = newFuncIterator();
+  while (hasNextFunc(funcIt)) {
+    FunctionEntry* f = nextFunc(funcIt);
+    genputtable(funcs_by_name, (void*)f->fjalar_name, f);
+  }
+  deleteFuncIterator(funcIt);
+
+  while (fgets(buf, sizeof(buf), fp)) {
+    SizeT len = VG_(strlen)(buf);
+    if (len > 0 && buf[len - 1] == '\n') {
+      buf[--len] = '\0';
+    }
+
+    if (VG_STREQN(20, buf, "separate-entry-exit ")) {
+      // Sets are only ever seeded into the structures of this run, so
+      // it doesn't matter how the earlier run kept them
+    }
+    else if (VG_STREQN(4, buf, "ppt ")) {
+      HChar* name = buf + 4;
+      HChar* suffix = VG_(strstr)(name, ":::");
+
+      resume_ppt(cur_func, cur_is_enter, records, num_records);
+      num_records = 0;
+
+      cur_func = 0;
+      if (suffix) {
+        cur_is_enter = VG_STREQ(suffix, ENTER_PPT);
+        *suffix = '\0';
+        unescape_ppt_name(name);
+        cur_func = (DaikonFunctionEntry*)gengettable(funcs_by_name, name);
+      }
+      if (cur_func) {
+        num_ppts++;
+      }
+      else {
+        DYNCOMP_DPRINTF("[DynComp] Checkpoint program point %s not found\n", buf + 4);
+      }
+    }
+    else if (len > 0 && cur_func) {
+      HChar* end;
+      Long var_index = VG_(strtoll10)(buf, &end);
+      Long set_id = VG_(strtoll10)(end, &end);
+      if (var_index < 0) {
+        continue;
+      }
+      if (num_records == max_records) {
+        max_records = max_records ? 2 * max_records : 64;
+        records = VG_(realloc)("dyncomp_runtime.c: DC_resume_from_checkpoint",
+                               records, max_records * sizeof(*records));
+      }
+      records[num_records].var_index = (UInt)var_index;
+      records[num_records].set_id = (int)set_id;
+      num_records++;
+    }
+  }
+  resume_ppt(cur_func, cur_is_enter, records, num_records);
+
+  fclose(fp);
+  VG_(free)(records);
+  genfreehashtable(funcs_by_name);
+
+  DYNCOMP_DPRINTF("[DynComp] Resumed %u program points from %s\n", num_ppts, filename);
+}
@@ -88,4 +88,8 @@ void DC_convert_bitmatrix_to_new_tag_leaders(DaikonFunctionEntry* funcPtr,
                                              char isEnter);
 void DC_convert_bitmatrix_to_sets(DaikonFunctionEntry* funcPtr,
                                   char isEnter);
+
+// Checkpoints (--dyncomp-checkpoint and --dyncomp-resume):
+void DC_write_checkpoint(const HChar* filename);
+void DC_resume_from_checkpoint(const HChar* filename);
 #endif
@@ -37,7 +37,6 @@
 #include "../fjalar_include.h"
 #include "vex_common.h"
 
-extern char dyncomp_profile_tags;
 static
 IRAtom* expr2tags_LDle_DC ( DCEnv* dce, IRType ty, IRAtom* addr, UInt bias );
 
@@ -139,6 +138,22 @@ void do_shadow_PUT_DC ( DCEnv* dce,  Int offset,
          IRStmt_Put( (4 * offset) + (3 * dce->layout->total_sizeB), vatom ) );
 }
 
+// Zero the tag of the guest register at offset, for code that
+// DynComp doesn't instrument (see --dyncomp-scope): whatever that code
+// left in the register has nothing to do with the tag that was there
+// before, and a tag of 0 becomes a fresh comparability type of its
+// own rather than a false merging with the old value.
+void clear_shadow_PUT_DC ( IRSB* bb, const VexGuestLayout* layout,
+                           Int offset )
+{
+   if (offset == layout->offset_SP || offset == layout->offset_FP) {
+      return;
+   }
+
+   addStmtToIRSB( bb, IRStmt_Put( (4 * offset) + (3 * layout->total_sizeB),
+                                  mkU32(0) ) );
+}
+
 // A PUTI stores a value (dynamically indexed) into the guest state
 // (for x86, this seems to be only used for floating point values)
 void do_shadow_PUTI_DC ( DCEnv* dce, IRPutI *puti)
@@ -302,8 +317,6 @@ IRAtom* handleCCall_DC ( DCEnv* dce,
 /*------------------------------------------------------------*/
 
 
-UInt numConsts = 0;
-
 // This is where we need to add calls to helper functions to
 // merge tags because here is where the 'interactions' take place
 
@@ -323,12 +336,12 @@ IRAtom* expr2tags_Qop_DC ( DCEnv* dce,
    IRAtom* vatom4 = expr2tags_DC( dce, atom4 );
 
 
-   if (dyncomp_profile_tags) {
+   if (kvasir_stats) {
       if ((atom1->tag == Iex_Const) ||
           (atom2->tag == Iex_Const) ||
           (atom3->tag == Iex_Const) ||
           (atom4->tag == Iex_Const)) {
-         numConsts++;
+         kvasir_stats_static_const_operands++;
       }
    }
 
@@ -410,11 +423,11 @@ IRAtom* expr2tags_Triop_DC ( DCEnv* dce,
    IRAtom* vatom2 = expr2tags_DC( dce, atom2 );
    IRAtom* vatom3 = expr2tags_DC( dce, atom3 );
 
-   if (dyncomp_profile_tags) {
+   if (kvasir_stats) {
       if ((atom1->tag == Iex_Const) ||
           (atom2->tag == Iex_Const) ||
           (atom3->tag == Iex_Const)) {
-         numConsts++;
+         kvasir_stats_static_const_operands++;
       }
    }
 
@@ -565,10 +578,10 @@ IRAtom* expr2tags_Binop_DC ( DCEnv* dce,
    void*        helper = 0;
    const HChar* hname = 0;
 
-   if (dyncomp_profile_tags) {
+   if (kvasir_stats) {
       if ((atom1->tag == Iex_Const) ||
           (atom2->tag == Iex_Const)) {
-         numConsts++;
+         kvasir_stats_static_const_operands++;
       }
    }
 
@@ -2508,6 +2521,25 @@ void do_shadow_STle_DC ( DCEnv* dce,
 
 }
 
+// Zero the tags of the bytes written by a store (if guard, which may
+// be 0, holds) in code that DynComp doesn't instrument, for the same
+// reason as clear_shadow_PUT_DC(): otherwise the tags that were there
+// before stick to whatever that code copies there (e.g., with a
+// memcpy in the C library) and falsely merge with it later.
+void clear_shadow_STle_DC ( IRSB* bb, IRAtom* addr, IRAtom* data,
+                            IRAtom* guard )
+{
+   IRType ty = typeOfIRExpr(bb->tyenv, data);
+   IRDirty* di = unsafeIRDirty_0_N(
+                    2/*regparms*/, "MC_(helperc_CLEAR_TAGS)",
+                    &MC_(helperc_CLEAR_TAGS),
+                    mkIRExprVec_2( addr, mkIRExpr_HWord(sizeofIRType(ty)) ));
+   if (guard) {
+      di->guard = guard;
+   }
+   addStmtToIRSB( bb, IRStmt_Dirty(di) );
+}
+
 // Handle dirty calls really stupidly by simply creating a fresh tag
 // as the result of the dirty call.  This ignores all the stuff that
 // goes on inside of the dirty call, but that should be okay.
@@ -34,7 +34,11 @@ IRExpr* expr2tags_DC ( DCEnv* dce, IRExpr* e );
 void do_shadow_PUT_DC ( DCEnv* dce,  Int offset,
                         IRAtom* atom, IRAtom* vatom );
 void do_shadow_PUTI_DC ( DCEnv* dce, IRPutI *puti );
+void clear_shadow_PUT_DC ( IRSB* bb, const VexGuestLayout* layout,
+                           Int offset );
 void do_shadow_STle_DC ( DCEnv* dce, IRAtom* addr, IRAtom* data );
+void clear_shadow_STle_DC ( IRSB* bb, IRAtom* addr, IRAtom* data,
+                            IRAtom* guard );
 IRAtom* do_shadow_cond_exit_DC (DCEnv* dce, IRExpr* guard);
 
 void do_shadow_CAS_DC ( DCEnv* dce, IRCAS* cas );
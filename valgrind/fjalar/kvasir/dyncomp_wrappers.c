@@ -26,7 +26,10 @@
    requests if they want to modify DynComp's behavior beyond what
    regular code can do. */
 
+#include <stdarg.h>
+
 #include "pub_tool_clreq.h"
+#include "dyncomp_clreq.h"
 
 /* Return a word-sized value with the same value as the argument, but
    a different tag, via loopholes in DynComp's checking. Perhaps this
@@ -152,3 +155,159 @@ void *I_WRAP_SONAME_FNNAME_ZU(libstdcZpZpZa, _ZNSolsEt)
 /* XXX Should support float, double, long double, and long long too,
    but I'm not confident how to pass them through CALL_FN safely, nor
    be 64-bit clean. */
+
+
+/* Summaries of C library functions for when DynComp doesn't
+   instrument the library (see --dyncomp-scope). The string and memory
+   functions that just move bytes around (memcpy, strlen, ...) are
+   replaced outright in mc_replace_strmem.c, which is always
+   instrumented; the ones below do too much to replace, so they are
+   wrapped instead, and the wrapper tells DynComp what the call did to
+   the tags. DynComp ignores that if it instrumented the function
+   after all. */
+
+/* qsort moves the elements around, so afterwards any element may
+   hold any other's value. */
+void I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, qsort)
+     (void *base, unsigned long nmemb, unsigned long size,
+      int (*compar)(const void *, const void *));
+void I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, qsort)
+     (void *base, unsigned long nmemb, unsigned long size,
+      int (*compar)(const void *, const void *)) {
+    OrigFn fn;
+    VALGRIND_GET_ORIG_FN(fn);
+    CALL_FN_v_WWWW(fn, base, nmemb, size, compar);
+    VALGRIND_DO_CLIENT_REQUEST_STMT(VG_USERREQ__DYNCOMP_MODEL_PERMUTE,
+                                    fn.nraddr, base, nmemb, size, 0);
+}
+
+/* The formatted string is a new value, and so is its length. (The
+   request is made even if nothing was written, to find out whether
+   the length needs a new tag too.) */
+static int summarize_sprintf(OrigFn fn, char *str, int result) {
+    unsigned long summarized = VALGRIND_DO_CLIENT_REQUEST_EXPR(0,
+        VG_USERREQ__DYNCOMP_MODEL_FRESH,
+        fn.nraddr, str, result >= 0 ? result + 1 : 0, 0, 0);
+    return summarized ? tag_launder_long(result) : result;
+}
+
+static int summarize_snprintf(OrigFn fn, char *str, unsigned long size,
+                              int result) {
+    unsigned long written = 0;
+    unsigned long summarized;
+    if (result >= 0 && size > 0) {
+        written = (unsigned long)result < size ?
+            (unsigned long)result + 1 : size;
+    }
+    summarized = VALGRIND_DO_CLIENT_REQUEST_EXPR(0,
+        VG_USERREQ__DYNCOMP_MODEL_FRESH,
+        fn.nraddr, str, written, 0, 0);
+    return summarized ? tag_launder_long(result) : result;
+}
+
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, vsprintf)
+    (char *str, const char *format, va_list ap);
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, vsprintf)
+    (char *str, const char *format, va_list ap) {
+    OrigFn fn;
+    int result;
+    VALGRIND_GET_ORIG_FN(fn);
+    CALL_FN_W_WWW(result, fn, str, format, ap);
+    return summarize_sprintf(fn, str, result);
+}
+
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, vsnprintf)
+    (char *str, unsigned long size, const char *format, va_list ap);
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, vsnprintf)
+    (char *str, unsigned long size, const char *format, va_list ap) {
+    OrigFn fn;
+    int result;
+    VALGRIND_GET_ORIG_FN(fn);
+    CALL_FN_W_WWWW(result, fn, str, size, format, ap);
+    return summarize_snprintf(fn, str, size, result);
+}
+
+/* What -D_FORTIFY_SOURCE turns sprintf and friends into */
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, __vsprintf_chk)
+    (char *str, int flag, unsigned long slen, const char *format, va_list ap);
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, __vsprintf_chk)
+    (char *str, int flag, unsigned long slen, const char *format, va_list ap) {
+    OrigFn fn;
+    int result;
+    VALGRIND_GET_ORIG_FN(fn);
+    CALL_FN_W_5W(result, fn, str, flag, slen, format, ap);
+    return summarize_sprintf(fn, str, result);
+}
+
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, __vsnprintf_chk)
+    (char *str, unsigned long size, int flag, unsigned long slen,
+     const char *format, va_list ap);
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, __vsnprintf_chk)
+    (char *str, unsigned long size, int flag, unsigned long slen,
+     const char *format, va_list ap) {
+    OrigFn fn;
+    int result;
+    VALGRIND_GET_ORIG_FN(fn);
+    CALL_FN_W_6W(result, fn, str, size, flag, slen, format, ap);
+    return summarize_snprintf(fn, str, size, result);
+}
+
+/* There's no way to pass the arguments of a varargs function on to
+   the original, so sprintf and snprintf (and their checking versions)
+   are reimplemented with the (wrapped) va_list versions. */
+int vsprintf(char *str, const char *format, va_list ap);
+int vsnprintf(char *str, unsigned long size, const char *format, va_list ap);
+int __vsprintf_chk(char *str, int flag, unsigned long slen,
+                   const char *format, va_list ap);
+int __vsnprintf_chk(char *str, unsigned long size, int flag,
+                    unsigned long slen, const char *format, va_list ap);
+
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, sprintf)
+    (char *str, const char *format, ...);
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, sprintf)
+    (char *str, const char *format, ...) {
+    va_list ap;
+    int result;
+    va_start(ap, format);
+    result = vsprintf(str, format, ap);
+    va_end(ap);
+    return result;
+}
+
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, snprintf)
+    (char *str, unsigned long size, const char *format, ...);
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, snprintf)
+    (char *str, unsigned long size, const char *format, ...) {
+    va_list ap;
+    int result;
+    va_start(ap, format);
+    result = vsnprintf(str, size, format, ap);
+    va_end(ap);
+    return result;
+}
+
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, __sprintf_chk)
+    (char *str, int flag, unsigned long slen, const char *format, ...);
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, __sprintf_chk)
+    (char *str, int flag, unsigned long slen, const char *format, ...) {
+    va_list ap;
+    int result;
+    va_start(ap, format);
+    result = __vsprintf_chk(str, flag, slen, format, ap);
+    va_end(ap);
+    return result;
+}
+
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, __snprintf_chk)
+    (char *str, unsigned long size, int flag, unsigned long slen,
+     const char *format, ...);
+int I_WRAP_SONAME_FNNAME_ZU(libcZdsoZa, __snprintf_chk)
+    (char *str, unsigned long size, int flag, unsigned long slen,
+     const char *format, ...) {
+    va_list ap;
+    int result;
+    va_start(ap, format);
+    result = __vsnprintf_chk(str, size, flag, slen, format, ap);
+    va_end(ap);
+    return result;
+}
@@ -35,6 +35,10 @@
 #include "kvasir_main.h"
 #include "decls-output.h"
 #include "dtrace-output.h"
+#include "dtrace-pipeline.h"
+#include "dtrace-columnar.h"
+#include "dtrace-delta.h"
+#include "kvasir_stats.h"
 
 #include "dyncomp_main.h"
 #include "dyncomp_runtime.h"
@@ -43,18 +47,37 @@ extern void setNOBUF(FILE *stream);
 
 // Global variables that are set by command-line options
 const HChar* kvasir_decls_filename = 0;
+const HChar* kvasir_decls_cache_dirname = 0;
 const HChar* kvasir_dtrace_filename = 0;
 const HChar* kvasir_program_stdout_filename = 0;
 const HChar* kvasir_program_stderr_filename = 0;
 Bool kvasir_dtrace_append = False;
+Bool kvasir_dtrace_atomic_append = False;
+Bool kvasir_dtrace_writer_header = False;
 Bool kvasir_dtrace_no_decls = False;
 Bool kvasir_dtrace_gzip = False;
+Bool kvasir_dtrace_pipeline = False;
+Bool kvasir_dtrace_per_thread = False;
+const HChar* kvasir_dtrace_columnar_filename = 0;
+Bool kvasir_dtrace_delta = False;
+Bool kvasir_dtrace_reuse_globals = False;
 Bool kvasir_output_fifo = False;
 Bool kvasir_decls_only = False;
 Bool kvasir_print_debug_info = False;
 Bool actually_output_separate_decls_dtrace = 0;
 Bool print_declarations = 1;
 
+// Per-ppt sampling (see kvasir_sample_invocation())
+KvasirSamplePolicy kvasir_sample_policy = SAMPLE_ALL;
+int  kvasir_sample_size = 100;
+Bool kvasir_sample_dyncomp = True;
+static UInt sample_seed = 12345;
+
+// Per-ppt cost accounting (see kvasir_stats.c)
+const HChar* kvasir_ppt_cost_report_filename = 0;
+const HChar* kvasir_ppt_cost_list_filename = 0;
+int  kvasir_ppt_cost_exclude = 10;
+
 Bool kvasir_with_dyncomp = True;
 Bool dyncomp_no_gc = False;
 Bool dyncomp_approximate_literals = False;
@@ -76,6 +99,16 @@ Bool dyncomp_units_mode = False;                // Tries to be consistent with u
 Bool dyncomp_dataflow_only_mode = False;        // Nothing is an interaction
 Bool dyncomp_dataflow_comparisons_mode = False; // Only comparisons are interactions
 
+Bool dyncomp_scope_main_only = False;
+const HChar* dyncomp_include_objects = 0;
+const HChar* dyncomp_exclude_objects = 0;
+const HChar* dyncomp_include_functions = 0;
+const HChar* dyncomp_exclude_functions = 0;
+const HChar* dyncomp_partitions_filename = 0;
+const HChar* dyncomp_checkpoint_filename = 0;
+int  dyncomp_checkpoint_interval = 600;
+const HChar* dyncomp_resume_filename = 0;
+
 
 FILE* decls_fp = 0; // File pointer for .decls file (this will point
                     // to the same thing as dtrace_fp by default since
@@ -85,20 +118,27 @@ FILE* decls_fp = 0; // File pointer for .decls file (this will point
 FILE* dtrace_fp = 0; // File pointer for dtrace file (from dtrace-output.c)
 static const char *dtrace_filename; /* File name to open dtrace_fp on */
 
+// --dtrace-file and --decls-file as given, if they contain a %p (to
+// be replaced by the process ID, see VG_(expand_file_name)()): a
+// process forked by the program writes files of its own
+static const HChar* dtrace_filename_pattern = 0;
+static const HChar* decls_filename_pattern = 0;
+
 const char* decls_folder = "daikon-output/";
 static const char* decls_ext = ".decls";
 static const char* dtrace_ext = ".dtrace";
 
 static int createFIFO(const char *filename);
 static int openDtraceFile(const char *fname);
+static void finishThreadDtraceStreams(void);
 static char splitDirectoryAndFilename(const char* input, char** dirnamePtr, char** filenamePtr);
 
 // Lots of boring file-handling stuff:
 
+// (dtrace_filename is kept around afterwards because the names of
+// later trace segments are derived from it.)
 static void openTheDtraceFile(void) {
   openDtraceFile(dtrace_filename);
-  VG_(free)((void*)dtrace_filename);
-  dtrace_filename = 0;
 }
 
 // if (actually_output_separate_decls_dtrace):
@@ -369,10 +409,9 @@ static int openRedirectFile(const char *fname) {
 
 static int gzip_pid = 0;
 
-static int openDtraceFile(const char *fname) {
+// Opens dtrace_fp on fname (or on a gzip process writing fname.gz)
+static int openDtraceStream(const char *fname) {
   const char *mode_str;
-  const char *stdout_redir = kvasir_program_stdout_filename;
-  const char *stderr_redir = kvasir_program_stderr_filename;
 
   char *env_val = VG_(getenv)("DTRACEAPPEND");
   if (env_val || kvasir_dtrace_append) {
@@ -394,15 +433,6 @@ static int openDtraceFile(const char *fname) {
     mode_str = "w";
   }
 
-  // If we're sending trace data to stdout, we definitely don't want the
-  // program's output going to the same place.
-  if (VG_STREQ(fname, "-") && !stdout_redir) {
-      // But if we're debugging - we probably do.  (markro)
-      if (!kvasir_print_debug_info) {
-          stdout_redir = "/dev/tty";
-      }    
-  }
-
   if (kvasir_dtrace_gzip || VG_(getenv)("DTRACEGZIP")) {
     int fds[2]; /* fds[0] for reading (child), fds[1] for writing (parent) */
     vki_pid_t pid;
@@ -472,6 +502,32 @@ static int openDtraceFile(const char *fname) {
     }
   }
 
+  // Each fflush() (at the end of each program point record) is then
+  // a single write() to the end of the file
+  if (kvasir_dtrace_atomic_append) {
+    setRECORDBUF(dtrace_fp);
+  }
+
+  return 1;
+}
+
+static int openDtraceFile(const char *fname) {
+  const char *stdout_redir = kvasir_program_stdout_filename;
+  const char *stderr_redir = kvasir_program_stderr_filename;
+
+  // If we're sending trace data to stdout, we definitely don't want the
+  // program's output going to the same place.
+  if (VG_STREQ(fname, "-") && !stdout_redir) {
+      // But if we're debugging - we probably do.  (markro)
+      if (!kvasir_print_debug_info) {
+          stdout_redir = "/dev/tty";
+      }    
+  }
+
+  if (!openDtraceStream(fname)) {
+    return 0;
+  }
+
   if (stdout_redir) {
     int new_stdout = openRedirectFile(stdout_redir);
     if (new_stdout == -1)
@@ -503,8 +559,9 @@ static int openDtraceFile(const char *fname) {
 
 // Close the stream and finish writing the .dtrace file
 // as well as all other open file streams
-static void finishDtraceFile(void)
+void finishDtraceFile(void)
 {
+  finishThreadDtraceStreams();
   if (dtrace_fp) /* If something goes wrong, we can be called with this null */
     fclose(dtrace_fp);
   if (gzip_pid) {
@@ -515,7 +572,366 @@ static void finishDtraceFile(void)
   }
 }
 
+// With --dtrace-writer-header, a comment that marks the start of
+// what this process writes to dtrace_fp, which other processes may be
+// appending to as well
+static void outputWriterHeader(void)
+{
+  if (dtrace_fp && kvasir_dtrace_writer_header) {
+    fprintf(dtrace_fp, "# writer pid %d program %s\n",
+            VG_(getpid)(), executable_filename);
+  }
+}
+
+// The header at the top of every .dtrace file (or trace segment)
+static void outputDtraceHeader(void)
+{
+  outputWriterHeader();
+
+  if (dtrace_fp && !kvasir_dtrace_append) {
+
+      fputs("input-language C/C++\n", dtrace_fp);
+
+      //Decls version
+      fputs("decl-version 2.0\n", dtrace_fp);
+
+      if (kvasir_with_dyncomp) {
+        fputs("var-comparability implicit\n", dtrace_fp);
+      }
+      else {
+        fputs("var-comparability none\n", dtrace_fp);
+      }
+      if (kvasir_dtrace_delta) {
+        fputs("# delta-encoded: expand with fjalar/tools/expand_delta_dtrace.py\n", dtrace_fp);
+      }
+      fputs("\n", dtrace_fp);
+  }
+}
+
+// Inserts suffix into fname in front of its .dtrace extension (or
+// appends it if fname doesn't end in .dtrace).  The caller must
+// VG_(free) the result.
+static char* dtraceFilenameWithSuffix(const char* fname, const char* suffix)
+{
+  int len = VG_(strlen)(fname);
+  int ext_len = VG_(strlen)(dtrace_ext);
+  int base_len = len;
+  char* new_fname;
+
+  if (len > ext_len && VG_STREQ(fname + len - ext_len, dtrace_ext)) {
+    base_len = len - ext_len;
+  }
+
+  new_fname = VG_(malloc)("kvasir_main.c: dtraceFilenameWithSuffix",
+                          len + VG_(strlen)(suffix) + 1);
+  VG_(strncpy)(new_fname, fname, base_len);
+  VG_(strcpy)(new_fname + base_len, suffix);
+  VG_(strcat)(new_fname, fname + base_len);
+  return new_fname;
+}
+
+// Trace segment n (n > 0) of foo.dtrace goes to foo-n.dtrace (or to
+// foo-n if the .dtrace file doesn't end in .dtrace).  The caller
+// must VG_(free) the result.
+static char* segmentFilename(const char* fname, UInt segment)
+{
+  char suffix[16];
+  VG_(sprintf)(suffix, "-%u", segment);
+  return dtraceFilenameWithSuffix(fname, suffix);
+}
+
+// With --dtrace-per-thread, every thread but the main thread (which
+// writes to dtrace_fp as usual) gets a .dtrace stream of its own,
+// opened when it first reaches a program point.  Indexed by
+// ThreadId.  Valgrind reuses the ThreadId of a thread that has
+// exited, so a later thread may carry on in an earlier one's stream;
+// its nonces carry on, too, since they are counted per ThreadId.
+static FILE** thread_dtrace_fps = 0;
+
+// The trace segment that dtrace_fp is on
+static UInt cur_dtrace_segment = 0;
+
+// Thread tid's part of foo.dtrace goes to foo-thread<tid>.dtrace (and
+// its part of trace segment n to foo-n-thread<tid>.dtrace)
+static FILE* threadDtraceStream(ThreadId tid)
+{
+  FILE* main_fp = dtrace_fp;
+  char* segment_fname;
+  char* thread_fname;
+  char suffix[32];
+
+  if (tid == 1 || tid >= VG_N_THREADS) {
+    return dtrace_fp;
+  }
+  if (thread_dtrace_fps[tid]) {
+    return thread_dtrace_fps[tid];
+  }
+
+  segment_fname = cur_dtrace_segment ?
+    segmentFilename(dtrace_filename, cur_dtrace_segment) :
+    (char*)dtrace_filename;
+  VG_(sprintf)(suffix, "-thread%u", tid);
+  thread_fname = dtraceFilenameWithSuffix(segment_fname, suffix);
+
+  thread_dtrace_fps[tid] = fopen(thread_fname,
+                                 kvasir_dtrace_append ? "a" : "w");
+  if (!thread_dtrace_fps[tid]) {
+    printf("Failed to open %s for thread %u: %s\n",
+           thread_fname, tid, my_strerror(errno));
+    VG_(exit)(1);
+  }
+  if (kvasir_dtrace_atomic_append) {
+    setRECORDBUF(thread_dtrace_fps[tid]);
+  }
+
+  if (segment_fname != dtrace_filename) {
+    VG_(free)(segment_fname);
+  }
+  VG_(free)(thread_fname);
+
+  // Each stream is a complete .dtrace file on its own:
+  dtrace_fp = thread_dtrace_fps[tid];
+  outputDtraceHeader();
+  dtrace_fp = main_fp;
+
+  return thread_dtrace_fps[tid];
+}
+
+static void finishThreadDtraceStreams(void)
+{
+  ThreadId tid;
+
+  if (!thread_dtrace_fps) {
+    return;
+  }
+  for (tid = 0; tid < VG_N_THREADS; tid++) {
+    if (thread_dtrace_fps[tid]) {
+      fclose(thread_dtrace_fps[tid]);
+      thread_dtrace_fps[tid] = 0;
+    }
+  }
+}
+
+// Switch dtrace_fp over to trace segment 'segment'
+void openDtraceSegment(UInt segment)
+{
+  char* segment_fname = segmentFilename(dtrace_filename, segment);
+
+  finishDtraceFile();
+  dtrace_fp = 0;
+  cur_dtrace_segment = segment;
+
+  if (!openDtraceStream(segment_fname)) {
+    printf("Failed to open %s for trace segment %u: %s\n",
+           segment_fname, segment, my_strerror(errno));
+    VG_(exit)(1);
+  }
+  VG_(free)(segment_fname);
+
+  outputDtraceHeader();
+}
+
+// Nothing that is buffered for the output files may cross a fork()
+// of the program, or both processes would end up writing it
+static void kvasir_pre_fork(ThreadId tid)
+{
+  if (dtrace_pipeline_active) {
+    dtrace_pipeline_flush();
+  }
+  else if (dtrace_fp) {
+    fflush(dtrace_fp);
+  }
+  if (thread_dtrace_fps) {
+    for (tid = 0; tid < VG_N_THREADS; tid++) {
+      if (thread_dtrace_fps[tid]) {
+        fflush(thread_dtrace_fps[tid]);
+      }
+    }
+  }
+  if (decls_fp && decls_fp != dtrace_fp) {
+    fflush(decls_fp);
+  }
+  if (dtrace_columnar_active) {
+    dtrace_columnar_pre_fork();
+  }
+}
+
+// Unless the child moves on to a .dtrace file of its own (see
+// kvasir_post_fork_child()), the records of both processes end up
+// interleaved in the same file, so a delta-encoded record could not
+// be matched up with the previous record of its program point.
+static void kvasir_post_fork_parent(ThreadId tid)
+{
+  if (dtrace_delta_active && !dtrace_filename_pattern) {
+    dtrace_delta_stop_deltas();
+  }
+}
+
+// Drops the child's copy of stream without writing anything more to
+// it (the parent still owns the file)
+static void discardInheritedStream(FILE* stream)
+{
+  fpurge(stream);
+  fclose(stream);
+}
+
+// The child of a fork() moves on to files of its own if their names
+// contain a %p.  Otherwise it keeps writing to the parent's .dtrace
+// file, and leaves writing the .decls file at the end (with DynComp)
+// to the parent.
+static void kvasir_post_fork_child(ThreadId tid)
+{
+  Bool decls_in_dtrace = (decls_fp == dtrace_fp);
+
+  if (dtrace_filename_pattern && dtrace_fp) {
+    if (thread_dtrace_fps) {
+      for (tid = 0; tid < VG_N_THREADS; tid++) {
+        if (thread_dtrace_fps[tid]) {
+          discardInheritedStream(thread_dtrace_fps[tid]);
+          thread_dtrace_fps[tid] = 0;
+        }
+      }
+    }
+    discardInheritedStream(dtrace_fp);
+    dtrace_fp = 0;
+    // The parent's gzip process is not ours to wait for:
+    gzip_pid = 0;
+
+    dtrace_filename = VG_(expand_file_name)("--dtrace-file",
+                                            dtrace_filename_pattern);
+    if (cur_dtrace_segment) {
+      openDtraceSegment(cur_dtrace_segment);
+    }
+    else {
+      if (!openDtraceStream(dtrace_filename)) {
+        printf("Failed to open %s for the forked process: %s\n",
+               dtrace_filename, my_strerror(errno));
+        VG_(exit)(1);
+      }
+      outputDtraceHeader();
+    }
+
+    if (decls_in_dtrace) {
+      decls_fp = dtrace_fp;
+    }
+    if (dtrace_delta_active) {
+      dtrace_delta_reset();
+    }
+  }
+  else {
+    dtrace_pipeline_post_fork_child();
+    // The child's records go to the parent's .dtrace file after this:
+    outputWriterHeader();
+    if (dtrace_delta_active) {
+      dtrace_delta_stop_deltas();
+    }
+  }
+
+  if (decls_fp && !decls_in_dtrace && kvasir_with_dyncomp) {
+    discardInheritedStream(decls_fp);
+    decls_fp = 0;
+    if (decls_filename_pattern) {
+      HChar* decls_filename = VG_(expand_file_name)("--decls-file",
+                                                    decls_filename_pattern);
+      decls_fp = fopen(decls_filename, "w");
+      if (!decls_fp) {
+        printf("Failed to open %s for declarations: %s\n",
+               decls_filename, my_strerror(errno));
+      }
+      VG_(free)(decls_filename);
+    }
+  }
+
+  if (dtrace_columnar_active) {
+    dtrace_columnar_post_fork_child();
+  }
+}
+
+// Each tracing window (see ../fjalar.h) after the first goes to its
+// own trace segment.  Later segments only contain the .dtrace header;
+// the declarations are in the .decls file or in the first segment.
+// If the trace is going to stdout or to a FIFO, all segments are
+// simply written one after the other.
+void fjalar_tool_trace_window_opened(UInt segment)
+{
+  if (segment == 0 || !dtrace_fp || dyncomp_without_dtrace ||
+      kvasir_output_fifo || VG_STREQ(dtrace_filename, "-")) {
+    return;
+  }
+
+  if (dtrace_pipeline_active) {
+    dtrace_pipeline_open_segment(segment);
+  }
+  else {
+    openDtraceSegment(segment);
+  }
+  // Each segment has to be expandable on its own:
+  if (dtrace_delta_active) {
+    dtrace_delta_reset();
+  }
+}
+
+void fjalar_tool_trace_window_closed(UInt segment)
+{
+  if (dtrace_pipeline_active) {
+    dtrace_pipeline_flush();
+  }
+  else if (dtrace_fp) {
+    fflush(dtrace_fp);
+    if (thread_dtrace_fps) {
+      ThreadId tid;
+      for (tid = 0; tid < VG_N_THREADS; tid++) {
+        if (thread_dtrace_fps[tid]) {
+          fflush(thread_dtrace_fps[tid]);
+        }
+      }
+    }
+  }
+}
+
+void fjalar_tool_checkpoint(void)
+{
+  if (kvasir_with_dyncomp && dyncomp_checkpoint_filename) {
+    DC_write_checkpoint(dyncomp_checkpoint_filename);
+  }
+  else {
+    printf("Kvasir: no DynComp checkpoints are being written (see --dyncomp-checkpoint)\n");
+  }
+}
+
+void fjalar_tool_dump_stats(void)
+{
+  if (kvasir_stats) {
+    kvasir_stats_dump(False);
+  }
+  else {
+    printf("Kvasir: no statistics are being collected (see --kvasir-stats)\n");
+  }
+}
+
+
+
+// When the next periodic --dyncomp-checkpoint is due (in terms of
+// VG_(read_millisecond_timer)()), or 0 if there are none.  The timer
+// is only read every so many program point exits.
+static UInt dyncomp_checkpoint_due_ms = 0;
+static UInt dyncomp_checkpoint_countdown = 0;
+#define DYNCOMP_CHECKPOINT_POLL_INTERVAL 1000
+
+static void maybe_write_dyncomp_checkpoint(void) {
+  UInt now;
+
+  if (--dyncomp_checkpoint_countdown > 0) {
+    return;
+  }
+  dyncomp_checkpoint_countdown = DYNCOMP_CHECKPOINT_POLL_INTERVAL;
 
+  now = VG_(read_millisecond_timer)();
+  if (now >= dyncomp_checkpoint_due_ms) {
+    DC_write_checkpoint(dyncomp_checkpoint_filename);
+    dyncomp_checkpoint_due_ms = now + (UInt)dyncomp_checkpoint_interval * 1000;
+  }
+}
 
 void fjalar_tool_pre_clo_init(void)
 {
@@ -537,6 +953,63 @@ void fjalar_tool_post_clo_init(void)
       dyncomp_print_trace_info = True;
   }
 
+  // --dyncomp-print-inc writes declarations into the middle of the
+  // .dtrace file, which the --dtrace-pipeline writer can't do:
+  if (kvasir_dtrace_pipeline && dyncomp_print_incremental) {
+      printf("\nError: --dtrace-pipeline cannot be used with --dyncomp-print-inc\nExiting.\n");
+      VG_(exit)(1);
+  }
+
+  // --dtrace-columnar takes over the program point records, which
+  // these would otherwise write or rearrange:
+  if (kvasir_dtrace_columnar_filename &&
+      (kvasir_dtrace_pipeline || kvasir_dtrace_per_thread || dyncomp_print_incremental)) {
+      printf("\nError: --dtrace-columnar cannot be used with --dtrace-pipeline, --dtrace-per-thread\n"
+             "or --dyncomp-print-inc\nExiting.\n");
+      VG_(exit)(1);
+  }
+
+  // A delta-encoded record can only be expanded from the previous
+  // record of its program point in the same file, written by the same
+  // process (which isn't so when several runs append to one file):
+  if (kvasir_dtrace_delta &&
+      (kvasir_dtrace_columnar_filename || kvasir_dtrace_per_thread || dyncomp_print_incremental ||
+       kvasir_dtrace_atomic_append)) {
+      printf("\nError: --dtrace-delta cannot be used with --dtrace-columnar, --dtrace-per-thread,\n"
+             "--dyncomp-print-inc or --dtrace-atomic-append\nExiting.\n");
+      VG_(exit)(1);
+  }
+
+  // DynComp has to see every variable at every program point, the
+  // columnar store wants raw values rather than text, and variable
+  // selection is tracked by the position of each variable visited:
+  if (kvasir_dtrace_reuse_globals &&
+      (kvasir_with_dyncomp || kvasir_dtrace_columnar_filename || fjalar_trace_vars_filename)) {
+      printf("\nError: --dtrace-reuse-globals cannot be used with --dyncomp, --dtrace-columnar\n"
+             "or --var-list-file\nExiting.\n");
+      VG_(exit)(1);
+  }
+
+  if ((dyncomp_checkpoint_filename || dyncomp_resume_filename ||
+       dyncomp_partitions_filename) && !kvasir_with_dyncomp) {
+      printf("\nError: --dyncomp-partitions, --dyncomp-checkpoint and --dyncomp-resume require --dyncomp\nExiting.\n");
+      VG_(exit)(1);
+  }
+
+  if (dyncomp_checkpoint_filename && dyncomp_checkpoint_interval > 0) {
+      dyncomp_checkpoint_due_ms = VG_(read_millisecond_timer)() +
+        (UInt)dyncomp_checkpoint_interval * 1000;
+      dyncomp_checkpoint_countdown = DYNCOMP_CHECKPOINT_POLL_INTERVAL;
+  }
+
+  if (kvasir_stats_filename) {
+      kvasir_stats_init();
+  }
+
+  if (kvasir_ppt_cost_report_filename || kvasir_ppt_cost_list_filename) {
+      kvasir_ppt_costs = True;
+  }
+
   if (dyncomp_trace_startup) {
       dyncomp_delayed_trace = False;
       dyncomp_delayed_print_IR = False;
@@ -570,6 +1043,51 @@ void fjalar_tool_post_clo_init(void)
     }
   }
 
+  // A %p in a file name stands for the process ID:
+  if (kvasir_dtrace_filename && VG_(strchr)(kvasir_dtrace_filename, '%')) {
+    dtrace_filename_pattern = kvasir_dtrace_filename;
+    kvasir_dtrace_filename = VG_(expand_file_name)("--dtrace-file",
+                                                   dtrace_filename_pattern);
+    if (kvasir_dtrace_pipeline || kvasir_output_fifo) {
+      printf("\nError: a --dtrace-file with %%p cannot be used with --dtrace-pipeline or --output-fifo\nExiting.\n");
+      VG_(exit)(1);
+    }
+  }
+  if (kvasir_decls_filename && VG_(strchr)(kvasir_decls_filename, '%')) {
+    decls_filename_pattern = kvasir_decls_filename;
+    kvasir_decls_filename = VG_(expand_file_name)("--decls-file",
+                                                  decls_filename_pattern);
+  }
+
+  // Each thread's stream is an ordinary file of its own:
+  if (kvasir_dtrace_per_thread) {
+    if (kvasir_dtrace_pipeline || kvasir_dtrace_gzip || kvasir_output_fifo ||
+        dyncomp_print_incremental ||
+        (kvasir_dtrace_filename && VG_STREQ(kvasir_dtrace_filename, "-"))) {
+      printf("\nError: --dtrace-per-thread cannot be used with --dtrace-pipeline, --dtrace-gzip,\n"
+             "--output-fifo, --dyncomp-print-inc or --dtrace-file=-\nExiting.\n");
+      VG_(exit)(1);
+    }
+    thread_dtrace_fps = VG_(calloc)("kvasir_main.c: fjalar_tool_post_clo_init",
+                                    VG_N_THREADS, sizeof(FILE*));
+    fjalar_per_thread_nonces = True;
+  }
+
+  // A write() to the end of an ordinary file lands there in one piece,
+  // but one to a pipe (to gzip, the --dtrace-pipeline writer, a FIFO
+  // or whatever stdout is) may not, and the columnar store isn't
+  // appended to at all:
+  if (kvasir_dtrace_atomic_append) {
+    if (kvasir_dtrace_pipeline || kvasir_dtrace_gzip || VG_(getenv)("DTRACEGZIP") ||
+        kvasir_output_fifo || kvasir_dtrace_columnar_filename ||
+        (kvasir_dtrace_filename && VG_STREQ(kvasir_dtrace_filename, "-"))) {
+      printf("\nError: --dtrace-atomic-append cannot be used with --dtrace-pipeline, --dtrace-gzip,\n"
+             "--output-fifo, --dtrace-columnar or --dtrace-file=-\nExiting.\n");
+      VG_(exit)(1);
+    }
+    kvasir_dtrace_append = True;
+  }
+
   // Output separate .decls and .dtrace files if:
   // --decls-only is on OR --decls-file=<filename> is on
   // OR kvasir_with_dyncomp is ON (since DynComp needs to create .decls
@@ -606,6 +1124,11 @@ void fjalar_tool_post_clo_init(void)
   // the proper data structures
   outputDeclsFile(kvasir_with_dyncomp);
 
+  // ... which --dyncomp-resume then seeds with earlier results
+  if (kvasir_with_dyncomp && dyncomp_resume_filename) {
+    DC_resume_from_checkpoint(dyncomp_resume_filename);
+  }
+
   // if --decls-only PUNT now!
   if (kvasir_decls_only) {
     if (decls_fp) {
@@ -626,22 +1149,25 @@ void fjalar_tool_post_clo_init(void)
   // 2.0 decls header at the top of the dtrace.
   // Is this still an issue?  markro 08/10/16
 
-  if (dtrace_fp && !kvasir_dtrace_append) {
+  outputDtraceHeader();
 
-      fputs("input-language C/C++\n", dtrace_fp);
+  VG_(atfork)(kvasir_pre_fork, kvasir_post_fork_parent,
+              kvasir_post_fork_child);
 
-      //Decls version
-      fputs("decl-version 2.0\n", dtrace_fp);
+  // The .dtrace file keeps its header (and declarations), but the
+  // program point records go to the columnar store:
+  if (kvasir_dtrace_columnar_filename && !dyncomp_without_dtrace) {
+    dtrace_columnar_start(kvasir_dtrace_columnar_filename);
+  }
 
-      if (kvasir_with_dyncomp) {
-        fputs("var-comparability implicit\n", dtrace_fp);
-      }
-      else {
-        fputs("var-comparability none\n", dtrace_fp);
-      }
-      fputs("\n", dtrace_fp);
+  if (kvasir_dtrace_delta && dtrace_fp && !dyncomp_without_dtrace) {
+    dtrace_delta_start();
   }
 
+  // Everything from here on can be handed to the writer process:
+  if (kvasir_dtrace_pipeline && dtrace_fp && !dyncomp_without_dtrace) {
+    dtrace_pipeline_start();
+  }
 }
 
 void fjalar_tool_print_usage()
@@ -652,20 +1178,65 @@ void fjalar_tool_print_usage()
 "\n  Output file format:\n"
 "    --decls-file=<string>    The output .decls file location\n"
 "                             (forces generation of separate .decls file)\n"
+"                             (%%p stands for the process ID, as for --dtrace-file)\n"
 "    --decls-only             Exit after creating .decls file [--no-decls-only]\n"
+"    --decls-cache=<dir>      Keep the declarations of the program points in <dir>\n"
+"                             and reuse them in later runs of the same program\n"
+"                             with the same options\n"
 "    --dtrace-file=<string>   The output .dtrace file location\n"
 "                             [daikon-output/PROGRAM_NAME.dtrace]\n"
+"                             (%%p stands for the process ID, so that a process\n"
+"                             forked by the program writes a file of its own;\n"
+"                             combine them with fjalar/tools/concat_process_traces.py)\n"
 "    --dtrace-no-decls        Do not include declarations in .dtrace file\n"
 "                             [--no-dtrace-no-decls]\n"
 "    --dtrace-append          Appends .dtrace data to the end of an existing .dtrace file\n"
 "                             [--no-dtrace-append]\n"
+"    --dtrace-atomic-append   Append to the .dtrace file with one write() per program\n"
+"                             point record, so that runs appending to the same file\n"
+"                             at once don't mix up their records\n"
+"                             [--no-dtrace-atomic-append]\n"
+"    --dtrace-writer-header   Start what each process writes to the .dtrace file with\n"
+"                             a '# writer pid <pid> program <program>' comment\n"
+"                             [--no-dtrace-writer-header]\n"
 "    --dtrace-gzip            Compresses .dtrace data [--no-dtrace-gzip]\n"
 "                             (Automatically ON if --dtrace-file string ends in '.gz')\n"
+"    --dtrace-pipeline        Format and write .dtrace data in a separate process\n"
+"                             [--no-dtrace-pipeline]\n"
+"    --dtrace-columnar=<file> Write the program point executions to a column-oriented\n"
+"                             store in <file> (one array per variable and program\n"
+"                             point) instead of to the .dtrace file, which only gets\n"
+"                             the header and declarations; turn it back into .dtrace\n"
+"                             records with fjalar/tools/columnar_to_dtrace.py\n"
+"                             (%%p stands for the process ID, as for --dtrace-file;\n"
+"                             without it, forked processes are not recorded)\n"
+"    --dtrace-delta           Only write the variables whose value or modbit changed\n"
+"                             since the previous record of the same program point;\n"
+"                             expand the .dtrace file for Daikon with\n"
+"                             fjalar/tools/expand_delta_dtrace.py [--no-dtrace-delta]\n"
+"    --dtrace-reuse-globals   Print a global variable without pointers inside it again\n"
+"                             from what was printed for it last time if its bytes\n"
+"                             haven't changed since [--no-dtrace-reuse-globals]\n"
+"    --dtrace-per-thread      Write each thread's .dtrace data to a file of its own\n"
+"                             (foo-thread<N>.dtrace), with nonces numbered per\n"
+"                             thread; combine them with\n"
+"                             fjalar/tools/merge_thread_traces.py\n"
+"                             [--no-dtrace-per-thread]\n"
 "    --object-ppts            Enables printing of object program points for structs and classes\n"
 "    --output-fifo            Create output files as named pipes [--no-output-fifo]\n"
 "    --program-stdout=<file>  Redirect instrumented program stdout to file\n"
 "                             [Kvasir's stdout, or /dev/tty if --dtrace-file=-]\n"
 "    --program-stderr=<file>  Redirect instrumented program stderr to file\n"
+"    --sample-policy=all      Write every execution of every program point (default)\n"
+"    --sample-policy=first    Only write the first N executions of each program point\n"
+"    --sample-policy=every    Only write every Nth execution of each program point\n"
+"    --sample-policy=backoff  Write the first N executions, then every 2nd for\n"
+"                             the next N, then every 4th, and so on\n"
+"    --sample-policy=reservoir  Write the first N executions, then execution i\n"
+"                             with probability N/i\n"
+"    --sample-size=<number>   The N used by --sample-policy [100]\n"
+"    --sample-dyncomp         Let DynComp observe executions that are not written\n"
+"                             to the .dtrace file [--sample-dyncomp]\n"
 
 "\n  DynComp dynamic comparability analysis\n"
 "    --dyncomp                Enables DynComp comparability analysis\n"
@@ -688,6 +1259,28 @@ void fjalar_tool_print_usage()
 "    --dyncomp-interactions=units        Only counts interactions that are consistent with units\n"
 "    --dyncomp-interactions=comparisons  Only counts comparison operations as interactions\n"
 "    --dyncomp-interactions=none         Tracks no interactions, just dataflow\n"
+"    --dyncomp-scope=all      Instruments all code except the dynamic loader (default)\n"
+"    --dyncomp-scope=main     Only instruments the main executable; calls into other\n"
+"                             objects are summarized at the call boundary\n"
+"    --dyncomp-include-objects=<patterns>  Also instrument the objects (shared\n"
+"                             libraries) whose file names match any of the\n"
+"                             comma-separated patterns (* and ? are wildcards)\n"
+"    --dyncomp-exclude-objects=<patterns>  Don't instrument the matching objects\n"
+"    --dyncomp-include-functions=<patterns>  Always instrument the matching functions\n"
+"    --dyncomp-exclude-functions=<patterns>  Never instrument the matching functions\n"
+"    --dyncomp-partitions=<file>  Also write the variable partitions behind the\n"
+"                             comparability numbers to <file>, so that the results\n"
+"                             of several runs can be combined with\n"
+"                             fjalar/tools/merge_partitions.py\n"
+"    --dyncomp-checkpoint=<file>  Save the comparability sets found so far to <file>\n"
+"                             periodically, at exit, and whenever the program asks\n"
+"                             for it with FJALAR_CHECKPOINT or a 'checkpoint'\n"
+"                             command arrives through --trace-control-file\n"
+"    --dyncomp-checkpoint-interval=<number>  Seconds between periodic checkpoints\n"
+"                             (default 600; 0 turns them off)\n"
+"    --dyncomp-resume=<file>  Start from the comparability sets in a checkpoint (or\n"
+"                             a --dyncomp-partitions file) of an earlier run of the\n"
+"                             same program\n"
 "\n  Debugging:\n"
 "    --kvasir-debug           Print Kvasir-internal debug messages [--no-debug]\n"
 "    --dyncomp-debug          Print DynComp debug messages (--dyncomp must also be on)\n"
@@ -700,6 +1293,17 @@ void fjalar_tool_print_usage()
 "                             [default is don't start trace until 'main']\n"
 "    --dyncomp-print-inc      Print DynComp comp. numbers at the execution of every program\n"
 "                             point - requires separate dtrace file (for debug only)\n"
+"    --kvasir-stats=<file>    Collect run-time counters and timers and write them to\n"
+"                             <file> as JSON at exit (and whenever the program asks\n"
+"                             for it with FJALAR_DUMP_STATS or a 'stats' command\n"
+"                             arrives through --trace-control-file)\n"
+"    --ppt-cost-report=<file> Write the time, variables, sequence elements and\n"
+"                             .dtrace bytes spent on each program point to <file>,\n"
+"                             costliest first\n"
+"    --ppt-cost-list=<file>   Write a --ppt-list-file with the costliest program\n"
+"                             points commented out to <file>\n"
+"    --ppt-cost-exclude=<number>  How many program points --ppt-cost-list\n"
+"                             comments out [10]\n"
 "\n"
    );
 }
@@ -710,14 +1314,40 @@ Bool fjalar_tool_process_cmd_line_option(const HChar* arg)
   if VG_STR_CLO(arg, "--decls-file", kvasir_decls_filename) {}
   else if VG_STR_CLO(arg, "--dtrace-file", kvasir_dtrace_filename) {}
   else if VG_YESNO_CLO(arg, "dtrace-append",    kvasir_dtrace_append) {}
+  else if VG_YESNO_CLO(arg, "dtrace-atomic-append", kvasir_dtrace_atomic_append) {}
+  else if VG_YESNO_CLO(arg, "dtrace-writer-header", kvasir_dtrace_writer_header) {}
   else if VG_YESNO_CLO(arg, "object-ppts",      kvasir_object_ppts) {}
   else if VG_YESNO_CLO(arg, "dtrace-no-decls",  kvasir_dtrace_no_decls) {}
   else if VG_YESNO_CLO(arg, "dtrace-gzip",      kvasir_dtrace_gzip) {}
+  else if VG_YESNO_CLO(arg, "dtrace-pipeline",  kvasir_dtrace_pipeline) {}
+  else if VG_YESNO_CLO(arg, "dtrace-per-thread", kvasir_dtrace_per_thread) {}
+  else if VG_YESNO_CLO(arg, "dtrace-delta",     kvasir_dtrace_delta) {}
+  else if VG_YESNO_CLO(arg, "dtrace-reuse-globals", kvasir_dtrace_reuse_globals) {}
+  else if VG_STR_CLO(arg, "--dtrace-columnar",  kvasir_dtrace_columnar_filename) {}
   else if VG_YESNO_CLO(arg, "output-fifo",      kvasir_output_fifo) {}
   else if VG_YESNO_CLO(arg, "decls-only",       kvasir_decls_only) {}
+  else if VG_STR_CLO(arg, "--decls-cache",      kvasir_decls_cache_dirname) {}
   else if VG_YESNO_CLO(arg, "kvasir-debug",     kvasir_print_debug_info) {}
+  else if VG_STR_CLO(arg, "--kvasir-stats",     kvasir_stats_filename) {}
+  else if VG_STR_CLO(arg, "--ppt-cost-report",  kvasir_ppt_cost_report_filename) {}
+  else if VG_STR_CLO(arg, "--ppt-cost-list",    kvasir_ppt_cost_list_filename) {}
+  else if VG_BINT_CLO(arg, "--ppt-cost-exclude", kvasir_ppt_cost_exclude,
+                      0, 0x7fffffff) {}
   else if VG_STR_CLO(arg, "--program-stdout",   kvasir_program_stdout_filename){}
   else if VG_STR_CLO(arg, "--program-stderr",   kvasir_program_stderr_filename){}
+  else if VG_XACT_CLO(arg, "--sample-policy=all",
+                      kvasir_sample_policy, SAMPLE_ALL) {}
+  else if VG_XACT_CLO(arg, "--sample-policy=first",
+                      kvasir_sample_policy, SAMPLE_FIRST_N) {}
+  else if VG_XACT_CLO(arg, "--sample-policy=every",
+                      kvasir_sample_policy, SAMPLE_EVERY_K) {}
+  else if VG_XACT_CLO(arg, "--sample-policy=backoff",
+                      kvasir_sample_policy, SAMPLE_BACKOFF) {}
+  else if VG_XACT_CLO(arg, "--sample-policy=reservoir",
+                      kvasir_sample_policy, SAMPLE_RESERVOIR) {}
+  else if VG_BINT_CLO(arg, "--sample-size", kvasir_sample_size,
+                      1, 0x7fffffff) {}
+  else if VG_YESNO_CLO(arg, "sample-dyncomp",   kvasir_sample_dyncomp) {}
   else if VG_YESNO_CLO(arg, "dyncomp",          kvasir_with_dyncomp) {}
   else if VG_YESNO_CLO(arg, "dyncomp-approximate-literals", dyncomp_approximate_literals) {}
   else if VG_YESNO_CLO(arg, "dyncomp-detailed-mode", dyncomp_detailed_mode) {}
@@ -732,6 +1362,17 @@ Bool fjalar_tool_process_cmd_line_option(const HChar* arg)
   else if VG_XACT_CLO(arg, "--dyncomp-interactions=all",
                       dyncomp_dataflow_only_mode,        False) {
                       dyncomp_dataflow_comparisons_mode = dyncomp_units_mode = False; }
+  else if VG_XACT_CLO(arg, "--dyncomp-scope=all",  dyncomp_scope_main_only, False) {}
+  else if VG_XACT_CLO(arg, "--dyncomp-scope=main", dyncomp_scope_main_only, True) {}
+  else if VG_STR_CLO(arg, "--dyncomp-include-objects",   dyncomp_include_objects) {}
+  else if VG_STR_CLO(arg, "--dyncomp-exclude-objects",   dyncomp_exclude_objects) {}
+  else if VG_STR_CLO(arg, "--dyncomp-include-functions", dyncomp_include_functions) {}
+  else if VG_STR_CLO(arg, "--dyncomp-exclude-functions", dyncomp_exclude_functions) {}
+  else if VG_STR_CLO(arg, "--dyncomp-partitions", dyncomp_partitions_filename) {}
+  else if VG_STR_CLO(arg, "--dyncomp-checkpoint", dyncomp_checkpoint_filename) {}
+  else if VG_BINT_CLO(arg, "--dyncomp-checkpoint-interval", dyncomp_checkpoint_interval,
+                      0, 0x7fffffff) {}
+  else if VG_STR_CLO(arg, "--dyncomp-resume",     dyncomp_resume_filename) {}
   else if VG_YESNO_CLO(arg, "dyncomp-debug",  dyncomp_print_debug_info) {}
   else if VG_YESNO_CLO(arg, "dyncomp-trace",  dyncomp_print_trace_all) {}
   else if VG_YESNO_CLO(arg, "dyncomp-trace-merge",  dyncomp_print_trace_info) {}
@@ -767,48 +1408,160 @@ static void kvasir_late_init(void) {
 void fjalar_tool_finish() {
   if (kvasir_with_dyncomp) {
 
-    extern char dyncomp_profile_tags;
-    extern UInt numConsts;
-    extern UInt mergeTagsCount;
-    extern UInt merge3TagsCount;
-    extern UInt merge4TagsCount;
-    extern UInt mergeTagsReturn0Count;
-
     // Do one extra propagation of variable comparability at the end
     // of execution once all of the value comparability sets have
     // been properly updated:
     DC_extra_propagate_val_to_var_sets();
 
-    // Now print out the .decls file at the very end of execution:
-    DC_outputDeclsAtEnd();
+    if (dyncomp_checkpoint_filename) {
+      DC_write_checkpoint(dyncomp_checkpoint_filename);
+    }
 
-    if (dyncomp_profile_tags) {
-      printf("num. static consts in bin/tri/quad ops = %u\n", numConsts);
-      printf("MERGE_TAGS calls = %u\n", mergeTagsCount);
-      printf("MERGE_3_TAGS calls = %u\n", merge3TagsCount);
-      printf("MERGE_4_TAGS calls = %u\n", merge4TagsCount);
-      printf("MERGE_TAGS_RETURN_0 calls = %u\n", mergeTagsReturn0Count);
-      printf("next tag = %u, total assigned = %u\n", nextTag, totalNumTagsAssigned);
+    // Now print out the .decls file at the very end of execution
+    // (unless this is a forked process that leaves it to its parent):
+    if (decls_fp) {
+      DC_outputDeclsAtEnd();
     }
 
   }
 
   if (!dyncomp_without_dtrace) {
+     dtrace_pipeline_finish();
+     dtrace_columnar_finish();
      finishDtraceFile();
   }
+
+  kvasir_stats_dump(True);
+  kvasir_ppt_cost_finish();
 }
 
 Bool kvasir_late_init_done = False;
 
-void fjalar_tool_handle_function_entrance(FunctionExecutionState* f_state) {
+// Decide whether the current invocation of funcPtr (the
+// num_invocations'th, counting from 0) should be written to the
+// .dtrace file according to --sample-policy.  This is only called at
+// function entrance; the decision is remembered in the
+// FunctionExecutionState so that the matching exit (which has the
+// same invocation nonce) is always treated the same way.
+static Bool kvasir_sample_invocation(DaikonFunctionEntry* funcPtr) {
+  UInt i = funcPtr->num_invocations;
+  UInt n = (UInt)kvasir_sample_size;
+
+  switch (kvasir_sample_policy) {
+  case SAMPLE_FIRST_N:
+    return (i < n);
+
+  case SAMPLE_EVERY_K:
+    return ((i % n) == 0);
+
+  case SAMPLE_BACKOFF:
+    if (funcPtr->sample_stride == 0) {
+      funcPtr->sample_stride = 1;
+    }
+    if (i != funcPtr->sample_next) {
+      return False;
+    }
+    // Double the distance between samples after every n samples
+    if ((funcPtr->num_sampled_invocations + 1) % n == 0) {
+      funcPtr->sample_stride *= 2;
+    }
+    funcPtr->sample_next += funcPtr->sample_stride;
+    return True;
+
+  case SAMPLE_RESERVOIR:
+    // We can't take back records that have already been written, so
+    // this is the acceptance test of reservoir sampling without the
+    // eviction: after the first n, invocation i is kept with
+    // probability n/(i+1).
+    if (i < n) {
+      return True;
+    }
+    return ((VG_(random)(&sample_seed) % (i + 1)) < n);
+
+  case SAMPLE_ALL:
+  default:
+    return True;
+  }
+}
+
+// Prints the .dtrace record for f_state unless it is for an
+// invocation that was not sampled.  Invocations that were not
+// sampled are still traversed (with all output suppressed) when
+// DynComp is on so that comparability sets see every invocation.
+static void kvasir_print_dtrace_for_function(FunctionExecutionState* f_state,
+                                             char isEnter) {
+  Bool saved_dyncomp_without_dtrace = dyncomp_without_dtrace;
+  KvasirStatsActivity prevActivity;
+
+  if (f_state->toolData == INVOCATION_SKIPPED) {
+    return;
+  }
+
+  prevActivity = kvasir_stats_enter(STATS_TIME_TRAVERSAL);
+
+  if (f_state->toolData == INVOCATION_OBSERVE_ONLY) {
+    // HACK ALERT: Borrow the DynComp-only mode for the duration of
+    // this program point so that nothing reaches the .dtrace file.
+    dyncomp_without_dtrace = True;
+    printDtraceForFunction(f_state, isEnter);
+    dyncomp_without_dtrace = saved_dyncomp_without_dtrace;
+  }
+  else {
+    printDtraceForFunction(f_state, isEnter);
+  }
+
+  kvasir_stats_leave(prevActivity);
+}
+
+static void handle_function_entrance(FunctionExecutionState* f_state) {
+  DaikonFunctionEntry* funcPtr = (DaikonFunctionEntry*)f_state->func;
+
   if (!kvasir_late_init_done) {
     kvasir_late_init();
     kvasir_late_init_done = True;
   }
-  printDtraceForFunction(f_state, 1);
+
+  KVASIR_STATS_INC(ppt_enters);
+
+  if (kvasir_sample_policy != SAMPLE_ALL) {
+    if (kvasir_sample_invocation(funcPtr)) {
+      funcPtr->num_sampled_invocations++;
+      f_state->toolData = INVOCATION_SAMPLED;
+    }
+    else if (kvasir_with_dyncomp && kvasir_sample_dyncomp) {
+      f_state->toolData = INVOCATION_OBSERVE_ONLY;
+    }
+    else {
+      f_state->toolData = INVOCATION_SKIPPED;
+    }
+
+    // With --sample-policy=first, once a program point has used up
+    // its budget (and DynComp doesn't need to keep watching it),
+    // nothing more will ever be done for it, so have Fjalar take out
+    // its instrumentation altogether.  This invocation's exit is
+    // still handled normally.
+    if ((kvasir_sample_policy == SAMPLE_FIRST_N) &&
+        (funcPtr->num_sampled_invocations >= (UInt)kvasir_sample_size) &&
+        !(kvasir_with_dyncomp && kvasir_sample_dyncomp)) {
+      fjalar_retire_function(f_state->func);
+    }
+  }
+
+  funcPtr->num_invocations++;
+  kvasir_print_dtrace_for_function(f_state, 1);
 }
 
-void fjalar_tool_handle_function_exit(FunctionExecutionState* f_state) {
+static void handle_function_exit(FunctionExecutionState* f_state) {
+
+  KVASIR_STATS_INC(ppt_exits);
+
+  if (dyncomp_checkpoint_due_ms) {
+    maybe_write_dyncomp_checkpoint();
+  }
+
+  if (f_state->toolData == INVOCATION_SKIPPED) {
+    return;
+  }
 
   if (kvasir_with_dyncomp) {
     ThreadId currentTID = VG_(get_running_tid)();
@@ -839,7 +1592,51 @@ void fjalar_tool_handle_function_exit(FunctionExecutionState* f_state) {
     }
   }
 
-  printDtraceForFunction(f_state, 0);
+  kvasir_print_dtrace_for_function(f_state, 0);
+}
+
+// With --ppt-cost-report or --ppt-cost-list, everything spent on
+// handling an entry or exit is charged to its program point.  With
+// --dtrace-per-thread, dtrace_fp is pointed at the running thread's
+// stream for the duration.
+void fjalar_tool_handle_function_entrance(FunctionExecutionState* f_state) {
+  PptCostSample sample;
+  FILE* main_dtrace_fp = dtrace_fp;
+
+  if (thread_dtrace_fps && dtrace_fp) {
+    dtrace_fp = threadDtraceStream(VG_(get_running_tid)());
+  }
+
+  if (!kvasir_ppt_costs) {
+    handle_function_entrance(f_state);
+  }
+  else {
+    kvasir_ppt_cost_begin(&sample);
+    handle_function_entrance(f_state);
+    kvasir_ppt_cost_end(&sample, f_state->func);
+  }
+
+  dtrace_fp = main_dtrace_fp;
+}
+
+void fjalar_tool_handle_function_exit(FunctionExecutionState* f_state) {
+  PptCostSample sample;
+  FILE* main_dtrace_fp = dtrace_fp;
+
+  if (thread_dtrace_fps && dtrace_fp) {
+    dtrace_fp = threadDtraceStream(VG_(get_running_tid)());
+  }
+
+  if (!kvasir_ppt_costs) {
+    handle_function_exit(f_state);
+  }
+  else {
+    kvasir_ppt_cost_begin(&sample);
+    handle_function_exit(f_state);
+    kvasir_ppt_cost_end(&sample, f_state->func);
+  }
+
+  dtrace_fp = main_dtrace_fp;
 }
 
 
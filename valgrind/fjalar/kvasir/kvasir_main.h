@@ -133,23 +133,85 @@ typedef struct {
   // The number of invocations of this function
   UInt num_invocations;
 
+  // Per-ppt sampling state (see --sample-policy):
+  // The number of invocations that were actually written to .dtrace
+  UInt num_sampled_invocations;
+  // For --sample-policy=backoff: the index of the next invocation to
+  // sample and the current distance between samples
+  UInt sample_next;
+  UInt sample_stride;
+
+  // Per-ppt cost accounting (see --ppt-cost-report): the time spent
+  // handling this function's entries and exits, the Daikon variables
+  // visited and sequence elements printed there, and the .dtrace
+  // bytes written for it
+  ULong cost_ns;
+  ULong cost_vars;
+  ULong cost_seq_elts;
+  ULong cost_dtrace_bytes;
+
+  // The samples of the entry and exit program points that are waiting
+  // to be written to the --dtrace-columnar store (see
+  // dtrace-columnar.c), or 0
+  struct _ColumnarPpt* columnar_entry_ppt;
+  struct _ColumnarPpt* columnar_exit_ppt;
+
+  // The classes whose :::OBJECT program points are parents of this
+  // function's program points, for --object-ppts (see
+  // getFunctionObjects() in decls-output.c), or 0 until they're needed
+  struct _FunctionObjects* objects;
+
+  // The previous records of the entry and exit program points, for
+  // --dtrace-delta (see dtrace-delta.c), or 0
+  struct _DeltaPpt* delta_entry_ppt;
+  struct _DeltaPpt* delta_exit_ppt;
+
 } DaikonFunctionEntry;
 
+// Policies for deciding which invocations of a program point get
+// written to the .dtrace file (--sample-policy):
+typedef enum {
+  SAMPLE_ALL,        // Every invocation (default)
+  SAMPLE_FIRST_N,    // Only the first N invocations
+  SAMPLE_EVERY_K,    // Every Kth invocation, starting with the first
+  SAMPLE_BACKOFF,    // First N, then every 2nd for N more, every 4th, ...
+  SAMPLE_RESERVOIR   // First N, then invocation i with probability N/i
+} KvasirSamplePolicy;
+
+// Values of FunctionExecutionState.toolData for sampling:
+#define INVOCATION_SAMPLED      0 // Written to .dtrace as usual
+#define INVOCATION_OBSERVE_ONLY 1 // Traversed for DynComp, not written
+#define INVOCATION_SKIPPED      2 // Not traversed at all
+
 // Kvasir/DynComp-specific global variables that are set by
 // command-line options
 const HChar* kvasir_decls_filename;
+const HChar* kvasir_decls_cache_dirname;
 const HChar* kvasir_dtrace_filename;
 const HChar* kvasir_program_stdout_filename;
 const HChar* kvasir_program_stderr_filename;
 Bool kvasir_dtrace_append;
+Bool kvasir_dtrace_atomic_append;
+Bool kvasir_dtrace_writer_header;
 Bool kvasir_dtrace_no_decls;
 Bool kvasir_dtrace_gzip;
+Bool kvasir_dtrace_pipeline;
+Bool kvasir_dtrace_per_thread;
+const HChar* kvasir_dtrace_columnar_filename;
+Bool kvasir_dtrace_delta;
+Bool kvasir_dtrace_reuse_globals;
 Bool kvasir_output_fifo;
 Bool kvasir_decls_only;
 Bool kvasir_print_debug_info;
 Bool actually_output_separate_decls_dtrace;
 Bool print_declarations;
 Bool kvasir_object_ppts;
+KvasirSamplePolicy kvasir_sample_policy;
+int  kvasir_sample_size;
+Bool kvasir_sample_dyncomp;
+const HChar* kvasir_ppt_cost_report_filename;
+const HChar* kvasir_ppt_cost_list_filename;
+int  kvasir_ppt_cost_exclude;
 
 Bool kvasir_with_dyncomp;
 Bool dyncomp_no_gc;
@@ -169,6 +231,32 @@ Bool dyncomp_units_mode;
 Bool dyncomp_dataflow_only_mode;
 Bool dyncomp_dataflow_comparisons_mode;
 
+// Which code DynComp instruments (see dyncomp_code_in_scope() in
+// dyncomp_main.c):
+Bool dyncomp_scope_main_only;          // --dyncomp-scope=main
+const HChar* dyncomp_include_objects;  // Comma-separated patterns
+const HChar* dyncomp_exclude_objects;
+const HChar* dyncomp_include_functions;
+const HChar* dyncomp_exclude_functions;
+
+// Where to write the raw variable partitions behind the comparability
+// numbers in the .decls file (--dyncomp-partitions), or 0
+const HChar* dyncomp_partitions_filename;
+
+// Checkpoints of the variable comparability sets: where to write them
+// (--dyncomp-checkpoint), how often (in seconds; 0 for only at exit
+// and on request) and where to start from (--dyncomp-resume)
+const HChar* dyncomp_checkpoint_filename;
+int  dyncomp_checkpoint_interval;
+const HChar* dyncomp_resume_filename;
+
+// .dtrace file handling that is shared with the --dtrace-pipeline
+// writer process (dtrace-pipeline.c):
+// Close dtrace_fp and finish writing the .dtrace file
+void finishDtraceFile(void);
+// Close dtrace_fp and re-open it on trace segment 'segment'
+void openDtraceSegment(UInt segment);
+
 // Define MAX_DEBUG_INFO to turn on all sorts of
 // debugging printouts.  WARNING: you will get
 // a LOT of data.
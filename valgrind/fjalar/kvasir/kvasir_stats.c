@@ -0,0 +1,455 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* kvasir_stats.c:
+   Run-time counters and timers for Kvasir and DynComp, written out
+   as JSON (--kvasir-stats=<file>), and per-program-point costs
+   (--ppt-cost-report=<file> and --ppt-cost-list=<file>)
+
+   Valgrind only ever runs one thread at a time, so the counters need
+   no locking; each thread gets its own set, and kvasir_stats_cur is
+   switched over whenever Valgrind schedules a different thread.
+*/
+
+#include "../my_libc.h"
+
+#include "pub_tool_basics.h"
+#include "pub_tool_libcbase.h"
+#include "pub_tool_libcfile.h"
+#include "pub_tool_libcprint.h"
+#include "pub_tool_libcproc.h"
+#include "pub_tool_mallocfree.h"
+#include "pub_tool_threadstate.h"
+#include "pub_tool_tooliface.h"
+
+#include "kvasir_main.h"
+#include "kvasir_stats.h"
+#include "dtrace-output.h"
+#include "dtrace-pipeline.h"
+#include "dyncomp_main.h"
+
+const HChar* kvasir_stats_filename = 0;
+Bool kvasir_stats = False;
+KvasirStats* kvasir_stats_cur = 0;
+KvasirStatsActivity kvasir_stats_activity = STATS_TIME_PROGRAM;
+ULong kvasir_stats_static_const_operands = 0;
+Bool kvasir_ppt_costs = False;
+
+// Indexed by ThreadId (VG_N_THREADS entries)
+static KvasirStats* per_thread = 0;
+
+// When the run started, when time was last charged to an activity,
+// and when the current activity started
+static ULong start_time = 0;
+static ULong last_charge_time = 0;
+static ULong activity_start_time = 0;
+
+static UInt num_dumps = 0;
+
+static const char* helper_names[STATS_NUM_HELPERS] = {
+  "TAG_NOP",
+  "CREATE_TAG",
+  "LOAD_TAG_1",
+  "LOAD_TAG_2",
+  "LOAD_TAG_4",
+  "LOAD_TAG_8",
+  "STORE_TAG_1",
+  "STORE_TAG_2",
+  "STORE_TAG_4",
+  "STORE_TAG_8",
+  "MERGE_TAGS",
+  "MERGE_3_TAGS",
+  "MERGE_4_TAGS",
+  "MERGE_TAGS_RETURN_0",
+};
+
+static const char* activity_names[STATS_NUM_ACTIVITIES] = {
+  "program",
+  "traversal",
+  "formatting",
+  "io",
+  "gc",
+};
+
+ULong kvasir_stats_now(void) {
+  struct vki_timespec ts;
+  VG_(clock_gettime)(&ts, VKI_CLOCK_MONOTONIC);
+  return (ULong)ts.tv_sec * 1000000000ULL + (ULong)ts.tv_nsec;
+}
+
+// Charge the time since the last charge to the current activity of
+// the current thread
+static ULong charge_time(void) {
+  ULong now = kvasir_stats_now();
+  kvasir_stats_cur->time_ns[kvasir_stats_activity] += now - last_charge_time;
+  last_charge_time = now;
+  return now;
+}
+
+void kvasir_stats_switch(KvasirStatsActivity activity) {
+  ULong now = charge_time();
+
+  if (kvasir_stats_activity == STATS_TIME_GC) {
+    ULong pause = now - activity_start_time;
+    kvasir_stats_cur->gc_runs++;
+    if (pause > kvasir_stats_cur->gc_max_pause_ns) {
+      kvasir_stats_cur->gc_max_pause_ns = pause;
+    }
+  }
+
+  kvasir_stats_activity = activity;
+  activity_start_time = now;
+}
+
+// Called by Valgrind whenever it is about to run tid
+static void stats_start_client_code(ThreadId tid, ULong blocks_done) {
+  (void)blocks_done;
+
+  if (kvasir_stats_cur != &per_thread[tid]) {
+    charge_time();
+    kvasir_stats_cur = &per_thread[tid];
+  }
+}
+
+// The activity to go back to once a write() is done
+static KvasirStatsActivity io_prev_activity = STATS_TIME_PROGRAM;
+
+// Called by my_libc before (done == 0) and after every write() it
+// does; only the writes to the .dtrace file are of interest
+static void stats_write_hook(FILE* stream, size_t len, int done) {
+  if (stream != dtrace_fp) {
+    return;
+  }
+
+  if (!done) {
+    io_prev_activity = kvasir_stats_activity;
+    kvasir_stats_switch(STATS_TIME_IO);
+  }
+  else {
+    kvasir_stats_cur->dtrace_bytes += len;
+    kvasir_stats_switch(io_prev_activity);
+  }
+}
+
+void kvasir_stats_init(void) {
+  per_thread = VG_(calloc)("kvasir_stats.c: kvasir_stats_init",
+                           VG_N_THREADS, sizeof(*per_thread));
+  kvasir_stats_cur = &per_thread[0];
+  kvasir_stats_activity = STATS_TIME_PROGRAM;
+  start_time = last_charge_time = activity_start_time = kvasir_stats_now();
+
+  VG_(track_start_client_code)(stats_start_client_code);
+  my_libc_write_hook = stats_write_hook;
+
+  kvasir_stats = True;
+}
+
+static void add_stats(KvasirStats* total, const KvasirStats* s) {
+  int i;
+
+  for (i = 0; i < STATS_NUM_HELPERS; i++) {
+    total->helper_calls[i] += s->helper_calls[i];
+  }
+  total->tags_created += s->tags_created;
+  total->unions += s->unions;
+  total->gc_runs += s->gc_runs;
+  if (s->gc_max_pause_ns > total->gc_max_pause_ns) {
+    total->gc_max_pause_ns = s->gc_max_pause_ns;
+  }
+  total->ppt_enters += s->ppt_enters;
+  total->ppt_exits += s->ppt_exits;
+  total->vars_visited += s->vars_visited;
+  total->global_vars_reused += s->global_vars_reused;
+  total->dtrace_bytes += s->dtrace_bytes;
+  total->pipeline_bytes += s->pipeline_bytes;
+  for (i = 0; i < STATS_NUM_ACTIVITIES; i++) {
+    total->time_ns[i] += s->time_ns[i];
+  }
+}
+
+static Bool is_empty(const KvasirStats* s) {
+  const UChar* p = (const UChar*)s;
+  UInt i;
+
+  for (i = 0; i < sizeof(*s); i++) {
+    if (p[i]) {
+      return False;
+    }
+  }
+  return True;
+}
+
+// Prints the members of a JSON object holding the counters in s
+static void print_stats(FILE* fp, const KvasirStats* s, const char* indent) {
+  int i;
+
+  fprintf(fp, "%s\"helper_calls\": {", indent);
+  for (i = 0; i < STATS_NUM_HELPERS; i++) {
+    fprintf(fp, "%s\"%s\": %llu", (i ? ", " : ""),
+            helper_names[i], s->helper_calls[i]);
+  }
+  fprintf(fp, "},\n");
+  fprintf(fp, "%s\"tags_created\": %llu,\n", indent, s->tags_created);
+  fprintf(fp, "%s\"unions\": %llu,\n", indent, s->unions);
+  fprintf(fp, "%s\"gc_runs\": %llu,\n", indent, s->gc_runs);
+  fprintf(fp, "%s\"gc_max_pause_ns\": %llu,\n", indent, s->gc_max_pause_ns);
+  fprintf(fp, "%s\"ppt_enters\": %llu,\n", indent, s->ppt_enters);
+  fprintf(fp, "%s\"ppt_exits\": %llu,\n", indent, s->ppt_exits);
+  fprintf(fp, "%s\"vars_visited\": %llu,\n", indent, s->vars_visited);
+  fprintf(fp, "%s\"global_vars_reused\": %llu,\n", indent, s->global_vars_reused);
+  fprintf(fp, "%s\"dtrace_bytes\": %llu,\n", indent, s->dtrace_bytes);
+  fprintf(fp, "%s\"pipeline_bytes\": %llu,\n", indent, s->pipeline_bytes);
+  fprintf(fp, "%s\"time_ns\": {", indent);
+  for (i = 0; i < STATS_NUM_ACTIVITIES; i++) {
+    fprintf(fp, "%s\"%s\": %llu", (i ? ", " : ""),
+            activity_names[i], s->time_ns[i]);
+  }
+  fprintf(fp, "}");
+}
+
+void kvasir_stats_dump(Bool final) {
+  KvasirStats total;
+  FILE* fp;
+  ThreadId tid;
+  Bool first = True;
+  ULong now;
+  HChar* tmpName;
+
+  if (!kvasir_stats) {
+    return;
+  }
+
+  now = charge_time();
+  num_dumps++;
+
+  VG_(memset)(&total, 0, sizeof(total));
+  for (tid = 0; tid < VG_N_THREADS; tid++) {
+    add_stats(&total, &per_thread[tid]);
+  }
+
+  // Write to a temporary file and rename it so that whoever is
+  // watching kvasir_stats_filename never sees a partial dump:
+  tmpName = VG_(malloc)("kvasir_stats.c: kvasir_stats_dump",
+                        VG_(strlen)(kvasir_stats_filename) + 5);
+  VG_(sprintf)(tmpName, "%s.tmp", kvasir_stats_filename);
+
+  fp = fopen(tmpName, "w");
+  if (!fp) {
+    printf("Error: could not write Kvasir statistics to %s\n", tmpName);
+    VG_(free)(tmpName);
+    return;
+  }
+
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"dump\": %u,\n", num_dumps);
+  fprintf(fp, "  \"final\": %s,\n", final ? "true" : "false");
+  fprintf(fp, "  \"elapsed_ns\": %llu,\n", now - start_time);
+  fprintf(fp, "  \"dyncomp\": {\"next_tag\": %u, \"total_tags_assigned\": %u, "
+          "\"static_const_operands\": %llu},\n",
+          nextTag, totalNumTagsAssigned, kvasir_stats_static_const_operands);
+  fprintf(fp, "  \"total\": {\n");
+  print_stats(fp, &total, "    ");
+  fprintf(fp, "\n  },\n");
+  fprintf(fp, "  \"threads\": [");
+  for (tid = 0; tid < VG_N_THREADS; tid++) {
+    if (is_empty(&per_thread[tid])) {
+      continue;
+    }
+    fprintf(fp, "%s\n    {\n      \"tid\": %u,\n", first ? "" : ",", tid);
+    print_stats(fp, &per_thread[tid], "      ");
+    fprintf(fp, "\n    }");
+    first = False;
+  }
+  fprintf(fp, "\n  ]\n}\n");
+  fclose(fp);
+
+  VG_(rename)(tmpName, kvasir_stats_filename);
+  VG_(free)(tmpName);
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Per-program-point costs                              ---*/
+/*------------------------------------------------------------*/
+
+// The number of bytes of .dtrace output produced so far
+static ULong dtrace_bytes_so_far(void) {
+  if (dtrace_pipeline_active) {
+    return dtrace_pipeline_bytes_sent();
+  }
+  else if (dtrace_fp) {
+    return my_libc_bytes_out(dtrace_fp);
+  }
+  return 0;
+}
+
+void kvasir_ppt_cost_begin(PptCostSample* sample) {
+  sample->vars = dtrace_vars_visited;
+  sample->seq_elts = dtrace_seq_elts_printed;
+  sample->dtrace_bytes = dtrace_bytes_so_far();
+  sample->start_ns = kvasir_stats_now();
+}
+
+void kvasir_ppt_cost_end(PptCostSample* sample, FunctionEntry* funcPtr) {
+  DaikonFunctionEntry* daikonFuncPtr = (DaikonFunctionEntry*)funcPtr;
+  ULong bytes;
+
+  daikonFuncPtr->cost_ns += kvasir_stats_now() - sample->start_ns;
+  daikonFuncPtr->cost_vars += dtrace_vars_visited - sample->vars;
+  daikonFuncPtr->cost_seq_elts += dtrace_seq_elts_printed - sample->seq_elts;
+
+  // (The .dtrace file may have been switched in the meantime)
+  bytes = dtrace_bytes_so_far();
+  if (bytes > sample->dtrace_bytes) {
+    daikonFuncPtr->cost_dtrace_bytes += bytes - sample->dtrace_bytes;
+  }
+}
+
+// Costliest first
+static Int compareCosts(const void* a, const void* b) {
+  const DaikonFunctionEntry* f1 = *(DaikonFunctionEntry* const*)a;
+  const DaikonFunctionEntry* f2 = *(DaikonFunctionEntry* const*)b;
+
+  if (f1->cost_ns != f2->cost_ns) {
+    return (f1->cost_ns > f2->cost_ns) ? -1 : 1;
+  }
+  return VG_(strcmp)(f1->funcEntry.fjalar_name, f2->funcEntry.fjalar_name);
+}
+
+// Returns all program points that are being traced, costliest first,
+// and their number in *num
+static DaikonFunctionEntry** sortedByCost(UInt* num) {
+  FuncIterator* funcIt;
+  DaikonFunctionEntry** entries;
+  UInt n = 0, capacity = 64;
+
+  entries = VG_(malloc)("kvasir_stats.c: sortedByCost",
+                        capacity * sizeof(*entries));
+
+  funcIt = newFuncIterator();
+  while (hasNextFunc(funcIt)) {
+    FunctionEntry* cur_entry = nextFunc(funcIt);
+
+    // Program points left out by --ppt-list-file were never traced:
+    if (fjalar_trace_prog_pts_filename &&
+        !prog_pts_tree_entry_found(cur_entry)) {
+      continue;
+    }
+
+    if (n == capacity) {
+      capacity *= 2;
+      entries = VG_(realloc)("kvasir_stats.c: sortedByCost", entries,
+                             capacity * sizeof(*entries));
+    }
+    entries[n++] = (DaikonFunctionEntry*)cur_entry;
+  }
+  deleteFuncIterator(funcIt);
+
+  VG_(ssort)(entries, n, sizeof(*entries), compareCosts);
+  *num = n;
+  return entries;
+}
+
+// Lists the program points that were executed, costliest first, e.g.:
+/*
+# time_ms    time%  invocations   variables    seq_elts  dtrace_bytes  program point
+   1520.337   61.2        20000     1400000       40000      31200871  ..insert(int*, int)
+    402.118   16.2        20001      160008           0       3240119  ..main()
+*/
+static void writeCostReport(DaikonFunctionEntry** entries, UInt n) {
+  FILE* fp = fopen(kvasir_ppt_cost_report_filename, "w");
+  ULong total_ns = 0;
+  UInt i;
+
+  if (!fp) {
+    printf("Error: could not write the program point cost report to %s\n",
+           kvasir_ppt_cost_report_filename);
+    return;
+  }
+
+  for (i = 0; i < n; i++) {
+    total_ns += entries[i]->cost_ns;
+  }
+
+  fprintf(fp, "# Kvasir program point costs, costliest first\n");
+  fprintf(fp, "# (time spent handling the entries and exits of each program point)\n");
+  fprintf(fp, "# time_ms    time%%  invocations   variables    seq_elts  dtrace_bytes  program point\n");
+
+  for (i = 0; i < n; i++) {
+    DaikonFunctionEntry* f = entries[i];
+    ULong permille = total_ns ? (f->cost_ns * 1000) / total_ns : 0;
+
+    if (!f->num_invocations) {
+      continue;
+    }
+
+    fprintf(fp, "%7llu.%03llu %5llu.%llu %12u %11llu %11llu %13llu  %s\n",
+            f->cost_ns / 1000000, (f->cost_ns / 1000) % 1000,
+            permille / 10, permille % 10,
+            f->num_invocations,
+            f->cost_vars,
+            f->cost_seq_elts,
+            f->cost_dtrace_bytes,
+            f->funcEntry.fjalar_name);
+  }
+
+  fclose(fp);
+}
+
+// Writes a --ppt-list-file with every program point that was being
+// traced, except that the kvasir_ppt_cost_exclude costliest ones are
+// commented out
+static void writeCostList(DaikonFunctionEntry** entries, UInt n) {
+  FILE* fp = fopen(kvasir_ppt_cost_list_filename, "w");
+  UInt i;
+
+  if (!fp) {
+    printf("Error: could not write the program point list to %s\n",
+           kvasir_ppt_cost_list_filename);
+    return;
+  }
+
+  fprintf(fp, "# Program point list for --ppt-list-file, written by Kvasir\n");
+  fprintf(fp, "# The %d costliest program points are commented out:\n",
+          kvasir_ppt_cost_exclude);
+
+  for (i = 0; i < n; i++) {
+    if (i < (UInt)kvasir_ppt_cost_exclude && entries[i]->cost_ns) {
+      fputs("#", fp);
+    }
+    fputs(entries[i]->funcEntry.fjalar_name, fp);
+    fputs("\n", fp);
+  }
+
+  fclose(fp);
+}
+
+void kvasir_ppt_cost_finish(void) {
+  DaikonFunctionEntry** entries;
+  UInt n;
+
+  if (!kvasir_ppt_costs) {
+    return;
+  }
+
+  entries = sortedByCost(&n);
+
+  if (kvasir_ppt_cost_report_filename) {
+    writeCostReport(entries, n);
+  }
+  if (kvasir_ppt_cost_list_filename) {
+    writeCostList(entries, n);
+  }
+
+  VG_(free)(entries);
+}
@@ -0,0 +1,160 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2022 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* kvasir_stats.h:
+   Run-time counters and timers for Kvasir and DynComp, written out
+   as JSON (--kvasir-stats=<file>), and per-program-point costs
+   (--ppt-cost-report=<file> and --ppt-cost-list=<file>)
+*/
+
+#ifndef KVASIR_STATS_H
+#define KVASIR_STATS_H
+
+#include "pub_tool_basics.h"
+
+#include "../fjalar_include.h"
+
+// The file that statistics are dumped to (--kvasir-stats); 0 if no
+// statistics are being collected
+const HChar* kvasir_stats_filename;
+
+// True while statistics are being collected.  Everything below
+// should only be touched if this is set, so that it costs no more
+// than a test and branch otherwise.
+Bool kvasir_stats;
+
+// The DynComp helper functions called from instrumented code (see
+// dyncomp_main.c):
+typedef enum {
+  STATS_HELPER_TAG_NOP,
+  STATS_HELPER_CREATE_TAG,
+  STATS_HELPER_LOAD_TAG_1,
+  STATS_HELPER_LOAD_TAG_2,
+  STATS_HELPER_LOAD_TAG_4,
+  STATS_HELPER_LOAD_TAG_8,
+  STATS_HELPER_STORE_TAG_1,
+  STATS_HELPER_STORE_TAG_2,
+  STATS_HELPER_STORE_TAG_4,
+  STATS_HELPER_STORE_TAG_8,
+  STATS_HELPER_MERGE_TAGS,
+  STATS_HELPER_MERGE_3_TAGS,
+  STATS_HELPER_MERGE_4_TAGS,
+  STATS_HELPER_MERGE_TAGS_RETURN_0,
+  STATS_NUM_HELPERS
+} KvasirStatsHelper;
+
+// What the time is being spent on.  At any moment exactly one of
+// these is being charged, so they add up to the total running time.
+typedef enum {
+  STATS_TIME_PROGRAM,    // Anything else (mostly running the program)
+  STATS_TIME_TRAVERSAL,  // Handling program points, except for:
+  STATS_TIME_FORMATTING, // Writing out variable names and values
+  STATS_TIME_IO,         // Writing .dtrace data to the file (or
+                         // waiting for the --dtrace-pipeline writer)
+  STATS_TIME_GC,         // DynComp tag garbage collection
+  STATS_NUM_ACTIVITIES
+} KvasirStatsActivity;
+
+// The counters that are kept for each thread
+typedef struct {
+  ULong helper_calls[STATS_NUM_HELPERS];
+  ULong tags_created;
+  ULong unions;           // Calls to val_uf_tag_union()
+  ULong gc_runs;
+  ULong gc_max_pause_ns;
+  ULong ppt_enters;       // Program point executions reported by Fjalar
+  ULong ppt_exits;
+  ULong vars_visited;
+  ULong global_vars_reused; // Printed again by --dtrace-reuse-globals
+  ULong dtrace_bytes;     // Bytes written to the .dtrace file
+  ULong pipeline_bytes;   // Bytes handed to the --dtrace-pipeline writer
+  ULong time_ns[STATS_NUM_ACTIVITIES];
+} KvasirStats;
+
+// The counters of the thread that is running (or of thread 0, which
+// collects everything that happens outside of any thread)
+KvasirStats* kvasir_stats_cur;
+
+// The activity currently being charged
+KvasirStatsActivity kvasir_stats_activity;
+
+// Counted while instrumenting, not while running:
+ULong kvasir_stats_static_const_operands;
+
+#define KVASIR_STATS_INC(field) do { if (kvasir_stats) \
+      kvasir_stats_cur->field++; } while (0)
+
+#define KVASIR_STATS_ADD(field, n) do { if (kvasir_stats) \
+      kvasir_stats_cur->field += (n); } while (0)
+
+#define KVASIR_STATS_HELPER(kind) KVASIR_STATS_INC(helper_calls[kind])
+
+void kvasir_stats_switch(KvasirStatsActivity activity);
+
+// Start charging time to activity.  Returns the activity that was
+// being charged before, which should be passed to kvasir_stats_leave()
+// when done.
+static __inline__ KvasirStatsActivity kvasir_stats_enter(KvasirStatsActivity activity) {
+  KvasirStatsActivity prev = kvasir_stats_activity;
+  if (kvasir_stats && activity != prev) {
+    kvasir_stats_switch(activity);
+  }
+  return prev;
+}
+
+static __inline__ void kvasir_stats_leave(KvasirStatsActivity prev) {
+  if (kvasir_stats && prev != kvasir_stats_activity) {
+    kvasir_stats_switch(prev);
+  }
+}
+
+// Start collecting statistics (called after command-line options are
+// processed if --kvasir-stats was given)
+void kvasir_stats_init(void);
+
+// Write out all statistics so far to kvasir_stats_filename,
+// replacing whatever an earlier dump wrote there.  final is True for
+// the dump at the end of the run.
+void kvasir_stats_dump(Bool final);
+
+// The current time in nanoseconds (from an arbitrary starting point)
+ULong kvasir_stats_now(void);
+
+
+// Per-program-point cost accounting (--ppt-cost-report and
+// --ppt-cost-list).  The costs themselves are kept in the cost_*
+// fields of DaikonFunctionEntry.
+
+// True if per-ppt costs are being collected
+Bool kvasir_ppt_costs;
+
+// What the counters stood at when the handling of a program point
+// started
+typedef struct {
+  ULong start_ns;
+  ULong vars;
+  ULong seq_elts;
+  ULong dtrace_bytes;
+} PptCostSample;
+
+void kvasir_ppt_cost_begin(PptCostSample* sample);
+
+// Charge everything since kvasir_ppt_cost_begin(sample) to funcPtr
+// (a DaikonFunctionEntry)
+void kvasir_ppt_cost_end(PptCostSample* sample, FunctionEntry* funcPtr);
+
+// Write the --ppt-cost-report and --ppt-cost-list files (at the end
+// of the run)
+void kvasir_ppt_cost_finish(void);
+
+#endif
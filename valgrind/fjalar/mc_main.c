@@ -4749,8 +4749,8 @@ static
 void mc_new_mem_mmap ( Addr a, SizeT len, Bool rr, Bool ww, Bool xx,
                         ULong di_handle )
 {
-  // Silence GCC warnings - RUDD
-   (void)di_handle;
+   // Fjalar - this is where --trace-library notices its library
+   fjalar_new_mem_mmap(a, di_handle);
 
     if (rr || ww || xx) {
       /* (2) mmap/mprotect other -> defined */
@@ -7208,6 +7208,17 @@ static Bool mc_handle_client_request ( ThreadId tid, UWord* arg, UWord* ret )
    Int   i;
    Addr  bad_addr;
 
+   // Fjalar's own requests (see fjalar.h)
+   if (VG_IS_TOOL_USERREQ('F','J',arg[0]))
+      return fjalar_handle_client_request(tid, arg, ret);
+
+#ifndef _NO_DYNCOMP
+   // DynComp's models of uninstrumented library calls (see
+   // kvasir/dyncomp_clreq.h)
+   if (VG_IS_TOOL_USERREQ('D','C',arg[0]))
+      return dyncomp_handle_client_request(tid, arg, ret);
+#endif /* _NO_DYNCOMP */
+
    if (!VG_IS_TOOL_USERREQ('M','C',arg[0])
        && VG_USERREQ__MALLOCLIKE_BLOCK != arg[0]
        && VG_USERREQ__RESIZEINPLACE_BLOCK != arg[0]
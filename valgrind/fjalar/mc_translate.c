@@ -8463,9 +8463,14 @@ IRSB* MC_(instrument) ( VgCallbackClosure* closure,
       DYNCOMP_DPRINTF("address: %p fnname: %s\n", (void*)closure->readdr, fnname);
    }
 
+   /* Code outside of the --dyncomp-scope isn't instrumented either,
+      but the tags of the registers and memory it writes are cleared
+      so that no stale tags flow back into the instrumented code.  */
+
    static Bool first_time = True;
    static const HChar* loader_name = "GaRbAgE";
    Bool do_dyncomp = False;
+   Bool clear_dyncomp_regs = False;
    const DiEpoch cur_ep = VG_(current_DiEpoch)();
 
    if (first_time) {
@@ -8483,7 +8488,9 @@ IRSB* MC_(instrument) ( VgCallbackClosure* closure,
       DYNCOMP_DPRINTF("objname: %s\n\n", objname);
       // if its not part of the loader, go ahead and process
       if (VG_(strcmp)(objname, loader_name)) {
-         do_dyncomp = kvasir_with_dyncomp;
+         do_dyncomp = kvasir_with_dyncomp &&
+            dyncomp_code_in_scope(objname, closure->readdr);
+         clear_dyncomp_regs = kvasir_with_dyncomp && !do_dyncomp;
       }
    }
 
@@ -8756,6 +8763,8 @@ IRSB* MC_(instrument) ( VgCallbackClosure* closure,
                               st->Ist.Put.offset,
                               st->Ist.Put.data,
                               NULL /* shadow atom */ );
+            else if (clear_dyncomp_regs)
+               clear_shadow_PUT_DC( sb_out, layout, st->Ist.Put.offset );
 #endif /* _NO_DYNCOMP */
             break;
 
@@ -8776,11 +8785,20 @@ IRSB* MC_(instrument) ( VgCallbackClosure* closure,
 #ifndef _NO_DYNCOMP
             if (do_dyncomp)
                do_shadow_STle_DC( &dce, st->Ist.Store.addr, st->Ist.Store.data);
+            else if (clear_dyncomp_regs)
+               clear_shadow_STle_DC( sb_out, st->Ist.Store.addr,
+                                     st->Ist.Store.data, NULL );
 #endif /* _NO_DYNCOMP */
             break;
 
          case Ist_StoreG:
             do_shadow_StoreG( &mce, st->Ist.StoreG.details );
+#ifndef _NO_DYNCOMP
+            if (clear_dyncomp_regs)
+               clear_shadow_STle_DC( sb_out, st->Ist.StoreG.details->addr,
+                                     st->Ist.StoreG.details->data,
+                                     st->Ist.StoreG.details->guard );
+#endif /* _NO_DYNCOMP */
             break;
 
          case Ist_LoadG:
@@ -81,6 +81,7 @@ struct __stdio_file {
   vki_pid_t popen_kludge;
   unsigned char ungetbuf;
   char ungotten;
+  unsigned long long nwritten;  /* bytes passed to write() so far */
 };
 
 static FILE *__stdio_root;
@@ -94,6 +95,7 @@ static FILE *__stdio_root;
 #define FDPIPE 64
 #define CANREAD 128
 #define CANWRITE 256
+#define RECORDBUF 512
 
 static char __stdin_buf[BUFSIZE];
 static FILE __stdin = {
@@ -143,6 +145,21 @@ void setNOBUF(FILE *stream) {
     stream->flags |= NOBUF;
 }    
 
+void setRECORDBUF(FILE *stream) {
+    tl_assert(!(stream->flags&STATICBUF));
+    stream->flags |= RECORDBUF;
+}
+
+/* For RECORDBUF: make room for len more bytes in the buffer rather
+   than write it out */
+static void __stdio_grow(FILE *stream, size_t len) {
+  UInt newlen = stream->buflen;
+  if (stream->bm + len < newlen) return;
+  while (stream->bm + len >= newlen) newlen *= 2;
+  stream->buf = VG_(realloc)("my_libc.c: stdio_grow", stream->buf, newlen);
+  stream->buflen = newlen;
+}
+
 static int __stdio_parse_mode(const char *mode) {
   int f=0;
   for (;;) {
@@ -188,6 +205,7 @@ err_out:
   tmp->next=__stdio_root;
   __stdio_root=tmp;
   tmp->ungotten=0;
+  tmp->nwritten=0;
   return tmp;
 }
 
@@ -216,6 +234,22 @@ FILE *fdopen(int filedes, const char *mode) {
 }
 
 
+// Optional hook around the write()s done for a FILE (see my_libc.h)
+void (*my_libc_write_hook)(FILE *stream, size_t len, int done) = 0;
+
+static int __stdio_write(FILE *stream, const void *buf, size_t len) {
+  int ret;
+  if (my_libc_write_hook) my_libc_write_hook(stream, len, 0);
+  ret = VG_(write)(stream->fd, buf, len);
+  if (ret > 0) stream->nwritten += ret;
+  if (my_libc_write_hook) my_libc_write_hook(stream, ret > 0 ? ret : 0, 1);
+  return ret;
+}
+
+unsigned long long my_libc_bytes_out(FILE *stream) {
+  return stream->nwritten + ((stream->flags&BUFINPUT) ? 0 : stream->bm);
+}
+
 int fflush(FILE *stream) {
   if (stream->flags&BUFINPUT) {
     register int tmp;
@@ -224,7 +258,7 @@ int fflush(FILE *stream) {
     }
     stream->bs=stream->bm=0;
   } else if (stream->bm) {
-    int ret = VG_(write)(stream->fd,stream->buf,stream->bm);
+    int ret = __stdio_write(stream,stream->buf,stream->bm);
     if (ret == -1 || (UInt)ret != stream->bm) {
       stream->flags|=ERRORINDICATOR;
       return -1;
@@ -234,6 +268,16 @@ int fflush(FILE *stream) {
   return 0;
 }
 
+int fpurge(FILE *stream) {
+  stream->bs=stream->bm=0;
+  stream->ungotten=0;
+  return 0;
+}
+
+int fileno(FILE *stream) {
+  return stream->fd;
+}
+
 int fclose(FILE *stream) {
   int res;
   FILE *f,*fl;
@@ -376,11 +420,14 @@ kaputt:
     stream->flags|=ERRORINDICATOR;
     return EOF;
   }
-  if (stream->bm>=stream->buflen-1)
-    if (fflush(stream)) goto kaputt;
+  if (stream->bm>=stream->buflen-1) {
+    if (stream->flags&RECORDBUF)
+      __stdio_grow(stream,1);
+    else if (fflush(stream)) goto kaputt;
+  }
   if (stream->flags&NOBUF) {
     char ch = c;
-    if (VG_(write)(stream->fd,&ch,1) != 1)
+    if (__stdio_write(stream,&ch,1) != 1)
       goto kaputt;
     return 0;
   }
@@ -412,13 +459,15 @@ size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream)
     return 0;
   }
   if (!nmemb || len/nmemb!=size) return 0; /* check for integer overflow */
-  if (len>stream->buflen || (stream->flags&NOBUF)) {
+  if ((len>stream->buflen && !(stream->flags&RECORDBUF)) ||
+      (stream->flags&NOBUF)) {
     if (fflush(stream)) return 0;
     do {
-      res=VG_(write)(stream->fd,ptr,len);
+      res=__stdio_write(stream,ptr,len);
     } while (res==-1 && errno==VKI_EINTR);
   } else {
     register const unsigned char *c=ptr;
+    if (stream->flags&RECORDBUF) __stdio_grow(stream,len);
     for (i=len; i>0; --i,++c)
       if (fputc(*c,stream)) { res=len-i; goto abort; }
     res=len;
@@ -154,6 +154,24 @@ FILE *fdopen(int filedes, const char *mode);
 FILE *fd_open(const char *path, const char *mode, int *out_fd);
 int fflush(FILE *stream);
 int fclose(FILE *stream);
+/* Throw away whatever is buffered for stream without writing it (as
+   BSD's fpurge()) */
+int fpurge(FILE *stream);
+int fileno(FILE *stream);
+
+/* If set, called right before (done == 0) and right after (done != 0,
+   with len set to the number of bytes actually written) every write()
+   done for a FILE.  Used by Kvasir's --kvasir-stats. */
+extern void (*my_libc_write_hook)(FILE *stream, size_t len, int done);
+
+/* The number of bytes written to stream so far, including those that
+   are still in its buffer */
+unsigned long long my_libc_bytes_out(FILE *stream);
+
+/* Only write out stream when it is flushed (growing its buffer as
+   needed in between), so that everything written to it between two
+   fflush()es goes out in a single write() */
+void setRECORDBUF(FILE *stream);
 
 int feof(FILE *stream);
 int ferror(FILE *stream);
@@ -85,6 +85,9 @@
 #include "pub_tool_libcfile.h"
 #include "pub_tool_libcprint.h"
 #include "pub_tool_mallocfree.h"
+#include "pub_tool_aspacemgr.h"
+#include "pub_tool_debuginfo.h"
+#include "pub_tool_vki.h"
 #include <limits.h>
 // end of includes needed by Fjalar
 
@@ -330,7 +333,7 @@ static char *dump_ctf_strtab_name;
 int do_debug_info;	// always true for Fjalar
 int do_debug_lines;	// always true for Fjalar
 int do_debug_loc;	// always true for Fjalar
-int do_debug_frames;	// always true for Fjalar
+int do_debug_frames;	// true if --fjalar-debug-dump
 int do_debug_abbrevs;	// true if --fjalar-debug-dump
 int do_debug_aranges;	// true if --fjalar-debug-dump
 int do_debug_pubnames;	// true if --fjalar-debug-dump
@@ -574,27 +577,89 @@ bfd_vmatoa (const char *fmtch, bfd_vma value)  // Fjalar: const added to remove
   return ret;
 }
 
-/* Retrieve NMEMB structures, each SIZE bytes long from FILEDATA starting at
-   OFFSET + the offset of the current archive member, if we are examining an
-   archive.  Put the retrieved data into VAR, if it is not NULL.  Otherwise
-   allocate a buffer using malloc and fill that.  In either case return the
-   pointer to the start of the retrieved data or NULL if something went wrong.
-   If something does go wrong and REASON is not NULL then emit an error
-   message using REASON as part of the context.  */
+// START OF CODE ADDED FOR FJALAR
 
-static void *
-get_data (void *         var,
-	  Filedata *     filedata,
-	  unsigned long  offset,
-	  bfd_size_type  size,
-	  bfd_size_type  nmemb,
-	  const char *   reason)
+/* Fjalar maps the file it is reading into memory, and hands out the
+   (large) debugging sections and symbol tables as views into that
+   mapping instead of reading them into freshly allocated buffers,
+   which would double the peak memory use for programs with a lot of
+   debugging information.  The mapping is private and writable, so
+   relocations can still be applied to a view in place (only the
+   pages that are written to are copied).  Everything else still gets
+   a buffer of its own, copied from the mapping.  */
+static Filedata *      file_map_owner = NULL;
+static unsigned char * file_map = NULL;
+static bfd_size_type   file_map_size = 0;
+
+static void
+fjalar_map_file (Filedata * filedata)
+{
+  SysRes res;
+
+  if (filedata->file_size == 0)
+    return;
+
+  res = VG_(am_mmap_file_float_valgrind) (VG_PGROUNDUP (filedata->file_size),
+                                          VKI_PROT_READ | VKI_PROT_WRITE,
+                                          fileno (filedata->handle), 0);
+  if (sr_isError (res))
+    {
+      /* Not fatal - we just read the file as before.  */
+      FJALAR_DPRINTF ("Unable to map %s; reading it instead\n",
+                      filedata->file_name);
+      return;
+    }
+
+  file_map_owner = filedata;
+  file_map = (unsigned char *) sr_Res (res);
+  file_map_size = filedata->file_size;
+}
+
+static void
+fjalar_unmap_file (Filedata * filedata)
+{
+  if (file_map_owner != filedata)
+    return;
+
+  VG_(am_munmap_valgrind) ((Addr) file_map, VG_PGROUNDUP (file_map_size));
+  file_map_owner = NULL;
+  file_map = NULL;
+  file_map_size = 0;
+}
+
+/* Is P a view into the mapped file (rather than a buffer of its own)?  */
+static bool
+is_file_view (const void * p)
+{
+  return (file_map != NULL
+          && (const unsigned char *) p >= file_map
+          && (const unsigned char *) p < file_map + file_map_size);
+}
+
+/* Free the result of get_data or get_data_view.  */
+static void
+free_data (void * p)
+{
+  if (p != NULL && !is_file_view (p))
+    VG_(free) (p);
+}
+
+// END FJALAR CODE
+
+/* Check that NMEMB structures, each SIZE bytes long, can be retrieved
+   from FILEDATA starting at OFFSET (see get_data).  */
+
+static bool
+check_data_range (Filedata *     filedata,
+		  unsigned long  offset,
+		  bfd_size_type  size,
+		  bfd_size_type  nmemb,
+		  const char *   reason)
 {
-  void * mvar;
   bfd_size_type amt = size * nmemb;
 
   if (size == 0 || nmemb == 0)
-    return NULL;
+    return false;
 
   /* If the size_t type is smaller than the bfd_size_type, eg because
      you are building a 32-bit tool on a 64-bit host, then make sure
@@ -607,7 +672,7 @@ get_data (void *         var,
 	error (_("Size truncation prevents reading %s"
 		 " elements of size %s for %s\n"),
 	       bfd_vmatoa ("u", nmemb), bfd_vmatoa ("u", size), reason);
-      return NULL;
+      return false;
     }
 
   /* Check for size overflow.  */
@@ -617,7 +682,7 @@ get_data (void *         var,
 	error (_("Size overflow prevents reading %s"
 		 " elements of size %s for %s\n"),
 	       bfd_vmatoa ("u", nmemb), bfd_vmatoa ("u", size), reason);
-      return NULL;
+      return false;
     }
 
   /* Be kind to memory checkers (eg valgrind, address sanitizer) by not
@@ -629,11 +694,38 @@ get_data (void *         var,
       if (reason)
 	error (_("Reading %s bytes extends past end of file for %s\n"),
 	       bfd_vmatoa ("u", amt), reason);
-      return NULL;
+      return false;
     }
 
-  if (fseek (filedata->handle, filedata->archive_file_offset + offset,
-	     SEEK_SET))
+  return true;
+}
+
+/* Retrieve NMEMB structures, each SIZE bytes long from FILEDATA starting at
+   OFFSET + the offset of the current archive member, if we are examining an
+   archive.  Put the retrieved data into VAR, if it is not NULL.  Otherwise
+   allocate a buffer using malloc and fill that.  In either case return the
+   pointer to the start of the retrieved data or NULL if something went wrong.
+   If something does go wrong and REASON is not NULL then emit an error
+   message using REASON as part of the context.  */
+
+static void *
+get_data (void *         var,
+	  Filedata *     filedata,
+	  unsigned long  offset,
+	  bfd_size_type  size,
+	  bfd_size_type  nmemb,
+	  const char *   reason)
+{
+  void * mvar;
+  bfd_size_type amt = size * nmemb;
+
+  if (! check_data_range (filedata, offset, size, nmemb, reason))
+    return NULL;
+
+  /* Fjalar: copy out of the mapped file if there is one.  */
+  if (filedata != file_map_owner
+      && fseek (filedata->handle, filedata->archive_file_offset + offset,
+		SEEK_SET))
     {
       if (reason)
 	error (_("Unable to seek to 0x%lx for %s\n"),
@@ -658,6 +750,13 @@ get_data (void *         var,
       ((char *) mvar)[amt] = '\0';
     }
 
+  if (filedata == file_map_owner)
+    {
+      VG_(memcpy) (mvar, file_map + filedata->archive_file_offset + offset,
+		   (size_t) amt);
+      return mvar;
+    }
+
   if (fread (mvar, (size_t) size, (size_t) nmemb, filedata->handle) != nmemb)
     {
       if (reason)
@@ -671,6 +770,30 @@ get_data (void *         var,
   return mvar;
 }
 
+// START OF CODE ADDED FOR FJALAR
+
+/* Like get_data (NULL, ...), but returns a read-only view into the
+   mapped file rather than a copy where it can.  The view is not '\0'
+   terminated, may be unaligned, and must be freed with free_data.  */
+
+static void *
+get_data_view (Filedata *     filedata,
+	       unsigned long  offset,
+	       bfd_size_type  size,
+	       bfd_size_type  nmemb,
+	       const char *   reason)
+{
+  if (filedata != file_map_owner)
+    return get_data (NULL, filedata, offset, size, nmemb, reason);
+
+  if (! check_data_range (filedata, offset, size, nmemb, reason))
+    return NULL;
+
+  return file_map + filedata->archive_file_offset + offset;
+}
+
+// END FJALAR CODE
+
 /* Print a VMA value in the MODE specified.
    Returns the number of characters displayed.  */
 
@@ -6693,8 +6816,9 @@ get_32bit_elf_symbols (Filedata *           filedata,
       goto exit_point;
     }
 
-  esyms = (Elf32_External_Sym *) get_data (NULL, filedata, section->sh_offset, 1,
-                                           section->sh_size, _("symbols"));
+  esyms = (Elf32_External_Sym *) get_data_view (filedata, section->sh_offset,
+						1, section->sh_size,
+						_("symbols"));
   if (esyms == NULL)
     goto exit_point;
 
@@ -6707,13 +6831,13 @@ get_32bit_elf_symbols (Filedata *           filedata,
       if (shndx != NULL)
 	{
 	  error (_("Multiple symbol table index sections associated with the same symbol section\n"));
-	  VG_(free) (shndx);
+	  free_data (shndx);
 	}
 
-      shndx = (Elf_External_Sym_Shndx *) get_data (NULL, filedata,
-						   entry->hdr->sh_offset,
-						   1, entry->hdr->sh_size,
-						   _("symbol table section indices"));
+      shndx = (Elf_External_Sym_Shndx *) get_data_view (filedata,
+							entry->hdr->sh_offset,
+							1, entry->hdr->sh_size,
+							_("symbol table section indices"));
       if (shndx == NULL)
 	goto exit_point;
 
@@ -6753,8 +6877,8 @@ get_32bit_elf_symbols (Filedata *           filedata,
     }
 
  exit_point:
-  VG_(free) (shndx);
-  VG_(free) (esyms);
+  free_data (shndx);
+  free_data (esyms);
 
   if (num_syms_return != NULL)
     * num_syms_return = isyms == NULL ? 0 : number;
@@ -6810,8 +6934,9 @@ get_64bit_elf_symbols (Filedata *           filedata,
       goto exit_point;
     }
 
-  esyms = (Elf64_External_Sym *) get_data (NULL, filedata, section->sh_offset, 1,
-                                           section->sh_size, _("symbols"));
+  esyms = (Elf64_External_Sym *) get_data_view (filedata, section->sh_offset,
+						1, section->sh_size,
+						_("symbols"));
   if (!esyms)
     goto exit_point;
 
@@ -6824,13 +6949,13 @@ get_64bit_elf_symbols (Filedata *           filedata,
       if (shndx != NULL)
 	{
 	  error (_("Multiple symbol table index sections associated with the same symbol section\n"));
-	  VG_(free) (shndx);
+	  free_data (shndx);
 	}
 
-      shndx = (Elf_External_Sym_Shndx *) get_data (NULL, filedata,
-						   entry->hdr->sh_offset,
-						   1, entry->hdr->sh_size,
-						   _("symbol table section indices"));
+      shndx = (Elf_External_Sym_Shndx *) get_data_view (filedata,
+							entry->hdr->sh_offset,
+							1, entry->hdr->sh_size,
+							_("symbol table section indices"));
       if (shndx == NULL)
 	goto exit_point;
 
@@ -6872,8 +6997,8 @@ get_64bit_elf_symbols (Filedata *           filedata,
     }
 
  exit_point:
-  VG_(free) (shndx);
-  VG_(free) (esyms);
+  free_data (shndx);
+  free_data (esyms);
 
   if (num_syms_return != NULL)
     * num_syms_return = isyms == NULL ? 0 : number;
@@ -15534,7 +15659,7 @@ dump_section_as_strings (Elf_Internal_Shdr * section, Filedata * filedata)
 
 	  if (chdr.ch_type != ELFCOMPRESS_ZLIB)
 	    {
-	      warn (_("section '%s' has unsupported compress type: %d\n"),
+	      warn (_("section '%s' has unsupported compress type: %u\n"),
 		    printable_section_name (filedata, section), chdr.ch_type);
 	      goto error_out;
 	    }
@@ -15750,7 +15875,7 @@ dump_section_as_bytes (Elf_Internal_Shdr *section,
 
 	  if (chdr.ch_type != ELFCOMPRESS_ZLIB)
 	    {
-	      warn (_("section '%s' has unsupported compress type: %d\n"),
+	      warn (_("section '%s' has unsupported compress type: %u\n"),
 		    printable_section_name (filedata, section), chdr.ch_type);
 	      goto error_out;
 	    }
@@ -16086,6 +16211,103 @@ dump_section_as_ctf (Elf_Internal_Shdr * section, Filedata * filedata)
 
 #endif // This code is not needed for Fjalar.
 
+// START OF CODE ADDED FOR FJALAR
+
+/* If the contents *START (of *SIZE bytes) of section SEC are
+   compressed, either with SHF_COMPRESSED or as a .zdebug_* section
+   with a "ZLIB" header, replace them by the uncompressed contents in
+   a buffer of their own.  Returns false if they can't be
+   uncompressed.  */
+static bool
+fjalar_uncompress_section (Filedata *               filedata,
+                           const Elf_Internal_Shdr * sec,
+                           unsigned char **         start,
+                           dwarf_size_type *        size)
+{
+  unsigned char * data = *start;
+  dwarf_size_type data_size = *size;
+  dwarf_size_type uncompressed_size = 0;
+  unsigned char * uncompressed;
+  SizeT len;
+  int i;
+
+  if ((sec->sh_flags & SHF_COMPRESSED) != 0)
+    {
+      unsigned int header_size;
+      unsigned int type;
+
+      if (is_32bit_elf)
+        {
+          Elf32_External_Chdr * echdr = (Elf32_External_Chdr *) data;
+
+          header_size = sizeof (* echdr);
+          if (data_size < header_size)
+            goto too_small;
+          type = BYTE_GET (echdr->ch_type);
+          uncompressed_size = BYTE_GET (echdr->ch_size);
+        }
+      else
+        {
+          Elf64_External_Chdr * echdr = (Elf64_External_Chdr *) data;
+
+          header_size = sizeof (* echdr);
+          if (data_size < header_size)
+            goto too_small;
+          type = BYTE_GET (echdr->ch_type);
+          uncompressed_size = BYTE_GET (echdr->ch_size);
+        }
+
+      if (type != ELFCOMPRESS_ZLIB)
+        {
+          warn (_("section '%s' has unsupported compress type: %u\n"),
+                printable_section_name (filedata, sec), type);
+          return false;
+        }
+      data += header_size;
+      data_size -= header_size;
+    }
+  else if (data_size > 12 && VG_(memcmp) (data, "ZLIB", 4) == 0)
+    {
+      /* The "ZLIB" header is followed by the uncompressed section
+         size, 8 bytes in big-endian order.  */
+      for (i = 4; i < 12; i++)
+        uncompressed_size = (uncompressed_size << 8) + data[i];
+      data += 12;
+      data_size -= 12;
+    }
+  else
+    return true;
+
+  uncompressed = VG_(malloc) ("readelf.c: fjalar_uncompress_section",
+                              (SizeT) uncompressed_size + 1);
+  /* Valgrind's own inflater, as we can't link against zlib.  */
+  len = VG_(tinfl_decompress_mem_to_mem) (uncompressed,
+                                          (SizeT) uncompressed_size,
+                                          data, (SizeT) data_size,
+                                          VG_TINFL_FLAG_PARSE_ZLIB_HEADER
+                                          | VG_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+  if (len != uncompressed_size)
+    {
+      error (_("Unable to decompress section %s\n"),
+             printable_section_name (filedata, sec));
+      VG_(free) (uncompressed);
+      return false;
+    }
+  uncompressed[uncompressed_size] = '\0';
+
+  free_data (*start);
+  *start = uncompressed;
+  *size = uncompressed_size;
+  return true;
+
+ too_small:
+  warn (_("compressed section %s is too small to contain a compression header\n"),
+        printable_section_name (filedata, sec));
+  return false;
+}
+
+// END FJALAR CODE
+
 static bool
 load_specific_debug_section (enum dwarf_section_display_enum  debug,
 			     const Elf_Internal_Shdr *        sec,
@@ -16100,15 +16322,15 @@ load_specific_debug_section (enum dwarf_section_display_enum  debug,
       /* If it is already loaded, do nothing.  */
       if (streq (section->filename, filedata->file_name))
 	return true;
-      VG_(free) (section->start);
+      free_data (section->start);
     }
 
   snprintf (buf, sizeof (buf), _("%s section data"), section->name);
   section->address = sec->sh_addr;
   section->filename = filedata->file_name;
-  section->start = (unsigned char *) get_data (NULL, filedata,
-                                               sec->sh_offset, 1,
-                                               sec->sh_size, buf);
+  section->start = (unsigned char *) get_data_view (filedata,
+                                                    sec->sh_offset, 1,
+                                                    sec->sh_size, buf);
   if (section->start == NULL)
     section->size = 0;
   else
@@ -16140,7 +16362,7 @@ load_specific_debug_section (enum dwarf_section_display_enum  debug,
 
 	  if (chdr.ch_type != ELFCOMPRESS_ZLIB)
 	    {
-	      warn (_("section '%s' has unsupported compress type: %d\n"),
+	      warn (_("section '%s' has unsupported compress type: %u\n"),
 		    section->name, chdr.ch_type);
 	      return false;
 	    }
@@ -16184,6 +16406,15 @@ load_specific_debug_section (enum dwarf_section_display_enum  debug,
 	}
 
 #endif
+      // Fjalar: inflate .zdebug_* and SHF_COMPRESSED sections now that
+      // they are needed
+      if (! fjalar_uncompress_section (filedata, sec, &section->start, &size))
+	{
+	  free_data (section->start);
+	  section->start = NULL;
+	  section->size = 0;
+	  return false;
+	}
       section->size = size;
     }
 
@@ -16411,7 +16642,7 @@ free_debug_section (enum dwarf_section_display_enum debug)
   if (section->start == NULL)
     return;
 
-  VG_(free) ((char *) section->start);
+  free_data (section->start);
   section->start = NULL;
   section->address = 0;
   section->size = 0;
@@ -16454,7 +16685,8 @@ display_debug_section (int shndx, Elf_Internal_Shdr * section, Filedata * fileda
 // START OF CODE ADDED FOR FJALAR
 
   for (i = 0; i < max; i++)
-    if (VG_(strcmp) (debug_displays[i].section.uncompressed_name, name) == 0)
+    if (VG_(strcmp) (debug_displays[i].section.uncompressed_name, name) == 0
+        || VG_(strcmp) (debug_displays[i].section.compressed_name, name) == 0)
       {
 	struct dwarf_section * sec = &debug_displays [i].section;
 	if (i == line && startswith (name, ".debug_line."))
@@ -22578,10 +22810,12 @@ fjalar_process_file (const char * file_name)
     }
 
   filedata->file_size = (bfd_size_type) statbuf.size;
+  fjalar_map_file (filedata);
 
   if (! get_file_header (filedata))
     {
       error (_("%s: Failed to read file header\n"), file_name);
+      fjalar_unmap_file (filedata);
       fclose (filedata->handle);
       VG_(free) (filedata);
       return FALSE;
@@ -22605,6 +22839,7 @@ fjalar_process_file (const char * file_name)
   if (! process_file_header (filedata))
     {
       // FJALAR_DPRINTF("failed process_file_header()\n");
+      fjalar_unmap_file (filedata);
       fclose (filedata->handle);
       VG_(free) (filedata);
       return FALSE;
@@ -22732,6 +22967,7 @@ fjalar_process_file (const char * file_name)
 
   free_debug_memory ();
 
+  fjalar_unmap_file (filedata);
   fclose (filedata->handle);
   VG_(free) (filedata);
   return res;
@@ -23397,13 +23633,15 @@ process_elf_binary_data (const HChar* filename)
   do_debug_info++;
   do_debug_lines++;
   do_debug_loc++;
-  do_debug_frames++;
   show_name = 1;
   dump_any_debugging = true;
 
   // These sections are not needed to harvest data for Fjalar/Kvasir,
   // but if the user asked for --fjalar-debug-dump, display them anyway.  (markro)
+  // The call frame information is not needed either: the Valgrind core
+  // already decodes .eh_frame/.debug_frame for its unwinder.
   if (fjalar_debug_dump) {
+      do_debug_frames++;
       do_debug_abbrevs++;
       do_debug_aranges++;
       do_debug_macinfo++;
@@ -0,0 +1,183 @@
+#! /usr/bin/env python3
+r"""Turn a Kvasir --dtrace-columnar store back into .dtrace records.
+
+With --dtrace-columnar=<file>, Kvasir writes the executions of program
+points to a column-oriented store (one array per variable and program
+point, in segments of up to a few thousand executions; see
+kvasir/dtrace-columnar.c for the layout) instead of to the .dtrace
+file, which only gets the header and the declarations.
+
+This script writes the records of a store as Kvasir would have written
+them to the .dtrace file, in their original order, optionally after the
+header and declarations of that .dtrace file.  The functions that read
+the store can also be used on their own, to get at the columns of a
+program point without going through the text.
+"""
+
+## Usage: columnar_to_dtrace.py [-p prefix.dtrace] [-o output.dtrace] store
+import heapq
+import optparse
+import shutil
+import struct
+import sys
+
+MAGIC = b"KVCOLUMN"
+END_MAGIC = b"KVCOLEND"
+VERSION = 1
+
+# The format of the raw values of each kind of column, as Kvasir would
+# have printed them
+RAW_FORMATS = {
+    "B": "%d", "b": "%d", "H": "%d", "h": "%d", "I": "%d", "i": "%d",
+    "Q": "%d", "q": "%d", "f": "%.9g", "d": "%.17g",
+}
+
+
+class Segment:
+    """The executions of one program point in one segment of a store."""
+
+    def __init__(self, ppt, var_names, seqs, nonces, columns):
+        self.ppt = ppt
+        self.var_names = var_names
+        self.seqs = seqs
+        self.nonces = nonces
+        # For each variable, (kind, modbits, values), where values are
+        # strings for text columns and numbers otherwise
+        self.columns = columns
+
+    def record(self, i):
+        """The .dtrace record of execution i (without the blank line
+        that separates records)."""
+        lines = [self.ppt, "this_invocation_nonce", str(self.nonces[i])]
+        for name, (kind, modbits, values) in zip(self.var_names,
+                                                 self.columns):
+            lines.append(name)
+            if kind == "t":
+                lines.append(values[i])
+            elif modbits[i] == 2:
+                lines.append("nonsensical")
+            else:
+                lines.append(RAW_FORMATS[kind] % values[i])
+            lines.append(str(modbits[i]))
+        return "\n".join(lines) + "\n"
+
+
+def _pad(pos):
+    return (pos + 7) & ~7
+
+
+def _lines(data, pos, count):
+    """Read count '\n'-terminated lines from data at pos."""
+    lines = []
+    for _ in range(count):
+        end = data.index(b"\n", pos)
+        lines.append(data[pos:end].decode("utf-8", "replace"))
+        pos = end + 1
+    return lines, pos
+
+
+def _read_segment(data, offset, order):
+    num_samples, num_vars = struct.unpack_from(order + "II", data, offset)
+    names, pos = _lines(data, offset + 8, num_vars + 1)
+    pos = _pad(pos)
+
+    seqs = struct.unpack_from("%s%dQ" % (order, num_samples), data, pos)
+    pos += 8 * num_samples
+    nonces = struct.unpack_from("%s%dI" % (order, num_samples), data, pos)
+    pos = _pad(pos + 4 * num_samples)
+
+    columns = []
+    for _ in range(num_vars):
+        kind, element_size = struct.unpack_from(order + "II", data, pos)
+        kind = chr(kind)
+        pos += 8
+        modbits = data[pos:pos + num_samples]
+        pos = _pad(pos + num_samples)
+        if kind == "t":
+            offsets = struct.unpack_from("%s%dI" % (order, num_samples + 1),
+                                         data, pos)
+            pos += 4 * (num_samples + 1)
+            text = data[pos:pos + offsets[-1]]
+            values = [text[offsets[i]:offsets[i + 1]].decode("utf-8",
+                                                             "replace")
+                      for i in range(num_samples)]
+            pos = _pad(pos + offsets[-1])
+        else:
+            if struct.calcsize(kind) != element_size:
+                raise ValueError("column of kind %r has %d-byte values"
+                                 % (kind, element_size))
+            values = struct.unpack_from("%s%d%s" % (order, num_samples, kind),
+                                        data, pos)
+            pos = _pad(pos + element_size * num_samples)
+        columns.append((kind, modbits, values))
+
+    return Segment(names[0], names[1:], seqs, nonces, columns)
+
+
+def read_store(filename):
+    """Return the segments of the store in filename."""
+    with open(filename, "rb") as f:
+        data = f.read()
+    if data[:8] != MAGIC or data[-8:] != END_MAGIC:
+        raise ValueError("%s is not a complete --dtrace-columnar store"
+                         % filename)
+
+    # The store is in the byte order of the traced machine
+    for order in "<>":
+        if struct.unpack_from(order + "I", data, 8)[0] == VERSION:
+            break
+    else:
+        raise ValueError("%s has an unknown version" % filename)
+
+    index_offset, num_segments = struct.unpack_from(order + "QQ", data,
+                                                    len(data) - 24)
+    segments = []
+    pos = index_offset
+    for _ in range(num_segments):
+        offset, = struct.unpack_from(order + "Q", data, pos)
+        _, pos = _lines(data, pos + 16, 1)
+        pos = _pad(pos)
+        segments.append(_read_segment(data, offset, order))
+    return segments
+
+
+def write_dtrace(segments, out):
+    """Write the records of segments to out in their original order."""
+    def executions(segment):
+        for i, seq in enumerate(segment.seqs):
+            yield seq, i, segment
+
+    for _, i, segment in heapq.merge(*[executions(s) for s in segments],
+                                     key=lambda e: e[0]):
+        out.write("\n")
+        out.write(segment.record(i))
+
+
+def main():
+    parser = optparse.OptionParser(
+        usage="%prog [-p PREFIX] [-o OUTPUT] STORE",
+        description="Write the .dtrace records of a store written by "
+        "Kvasir with --dtrace-columnar.")
+    parser.add_option("-p", "--prefix", dest="prefix",
+                      help="Start the output with PREFIX, the .dtrace file "
+                      "of the same run (which has its header and "
+                      "declarations)")
+    parser.add_option("-o", "--output", dest="output",
+                      help="Write the .dtrace file to OUTPUT "
+                      "(default: standard output)")
+    (options, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error("need exactly one store")
+
+    segments = read_store(args[0])
+    out = open(options.output, "w") if options.output else sys.stdout
+    if options.prefix:
+        with open(options.prefix) as prefix:
+            shutil.copyfileobj(prefix, out)
+    write_dtrace(segments, out)
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
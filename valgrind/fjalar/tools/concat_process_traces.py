@@ -0,0 +1,54 @@
+#! /usr/bin/env python3
+r"""Concatenate the .dtrace files of the processes of a forking program.
+
+When --dtrace-file contains a %p, each process that the traced program
+forks writes its records to a .dtrace file of its own, named with its
+process ID.  The invocation nonces in these files overlap (a forked
+process carries on counting from where its parent was), and with
+DynComp only the first process writes the .decls file unless
+--decls-file contains a %p, too.
+
+This script writes a single .dtrace file for Daikon: the declarations
+(from the given .decls file, or else from the first .dtrace file),
+followed by the records of all of the processes, with their nonces
+renumbered so that every invocation has a nonce of its own.  An exit
+that a forked process reaches for an invocation entered before the
+fork keeps a nonce with no matching entry, which Daikon skips.
+"""
+
+## Usage: concat_process_traces.py [-d decls] [-o output.dtrace] dtrace...
+import optparse
+import shutil
+import sys
+
+import merge_thread_traces
+
+
+def main():
+    parser = optparse.OptionParser(
+        usage="%prog [-d DECLS] [-o OUTPUT] DTRACE...",
+        description="Concatenate the per-process .dtrace files written "
+        "by Kvasir with a --dtrace-file containing %p.")
+    parser.add_option("-d", "--decls", dest="decls",
+                      help="Start the output with the declarations in DECLS "
+                      "(default: those at the top of the first DTRACE)")
+    parser.add_option("-o", "--output", dest="output",
+                      help="Write the combined .dtrace file to OUTPUT "
+                      "(default: standard output)")
+    (options, args) = parser.parse_args()
+    if len(args) < 1:
+        parser.error("need at least one .dtrace file")
+
+    out = open(options.output, "w") if options.output else sys.stdout
+    if options.decls:
+        with open(options.decls) as decls:
+            shutil.copyfileobj(decls, out)
+        out.write("\n")
+    merge_thread_traces.merge(args, out, copy_header=not options.decls,
+                              per_file=True)
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
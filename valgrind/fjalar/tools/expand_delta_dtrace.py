@@ -0,0 +1,84 @@
+#! /usr/bin/env python3
+r"""Expand a .dtrace file written by Kvasir with --dtrace-delta.
+
+With --dtrace-delta, each program point record only has the variables
+whose value or modbit differ from the previous record of the same
+program point.  The first record of each program point (and any record
+whose variables aren't the same as those of the previous one) is
+written in full, preceded by a "# full" comment.
+
+This script writes the .dtrace file that Kvasir would have written
+without --dtrace-delta, by filling in the missing variables of each
+record from the previous record of its program point.
+"""
+
+## Usage: expand_delta_dtrace.py [-o output.dtrace] delta.dtrace
+import optparse
+import sys
+
+from merge_thread_traces import (HEADER_KEYWORDS, NONCE_LINE, body_of,
+                                 read_blocks)
+
+FULL_COMMENT = "# full"
+DELTA_COMMENT = "# delta-encoded"
+
+
+def expand(f, out):
+    """Write the expanded records of the .dtrace file f to out."""
+    # For each program point, the [name, value, modbit] of each of its
+    # variables in its previous record
+    previous = {}
+    for block in read_blocks(f):
+        body = body_of(block)
+        comments = block[:len(block) - len(body)]
+        # Headers, declarations and comments on their own (such as a
+        # "# writer pid" comment) pass through
+        if not body or body[0].split()[0] in HEADER_KEYWORDS or \
+                body[0].startswith("ppt ") or \
+                len(body) < 3 or body[1] != NONCE_LINE:
+            block = [line for line in block
+                     if not line.startswith(DELTA_COMMENT)]
+            if block:
+                out.write("\n".join(block) + "\n\n")
+            continue
+
+        ppt = body[0]
+        changes = [body[i:i + 3] for i in range(3, len(body), 3)]
+        if FULL_COMMENT in comments:
+            previous[ppt] = changes
+        else:
+            variables = previous.get(ppt)
+            if variables is None:
+                raise ValueError("record of %s without a full record "
+                                 "before it" % ppt)
+            positions = dict((v[0], i) for i, v in enumerate(variables))
+            for change in changes:
+                variables[positions[change[0]]] = change
+
+        lines = [c for c in comments if c != FULL_COMMENT] + body[:3]
+        for variable in previous[ppt]:
+            lines.extend(variable)
+        out.write("\n".join(lines) + "\n\n")
+
+
+def main():
+    parser = optparse.OptionParser(
+        usage="%prog [-o OUTPUT] DTRACE",
+        description="Expand a .dtrace file written by Kvasir with "
+        "--dtrace-delta so that Daikon can read it.")
+    parser.add_option("-o", "--output", dest="output",
+                      help="Write the expanded .dtrace file to OUTPUT "
+                      "(default: standard output)")
+    (options, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error("need exactly one .dtrace file")
+
+    out = open(options.output, "w") if options.output else sys.stdout
+    with open(args[0]) as f:
+        expand(f, out)
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,164 @@
+#! /usr/bin/env python3
+r"""Combine the comparability results of several Kvasir/DynComp runs.
+
+Each run of Kvasir with --dyncomp-partitions=<file> writes, next to its
+.decls file, the variable partitions behind the comparability numbers
+in it.  This script takes the .decls file of any one of the runs
+(they only differ in their comparability numbers) and the partition
+files of all of them, and writes a .decls file in which two variables
+of a program point are comparable if they were comparable in any of
+the runs (or are connected through a chain of such variables, since
+comparability is transitive).  That lets a test suite be split up
+into shards that run in parallel, while still getting the same kind of
+result as running all of it under a single Kvasir process.
+
+All of the runs must have traced the same program with the same
+options, so that their program points and variables match up.
+"""
+
+## Usage: merge_partitions.py [-o output.decls] input.decls partitions...
+import optparse
+import sys
+
+ENTER_EXIT_SUFFIXES = (":::ENTER", ":::EXIT0")
+
+
+class UnionFind:
+    """A disjoint-set forest over arbitrary hashable items."""
+
+    def __init__(self):
+        self.parent = {}
+
+    def find(self, item):
+        """Return the representative of item's set."""
+        root = self.parent.setdefault(item, item)
+        while self.parent[root] != root:
+            root = self.parent[root]
+        while item != root:
+            self.parent[item], item = root, self.parent[item]
+        return root
+
+    def union(self, a, b):
+        """Merge the sets of a and b."""
+        root_a = self.find(a)
+        root_b = self.find(b)
+        if root_a != root_b:
+            self.parent[root_b] = root_a
+
+
+def read_partitions(filename):
+    """Read a --dyncomp-partitions file.
+
+    Returns (separate_entry_exit, ppts), where ppts maps each program
+    point name to its list of (variable index, set id) pairs, in the
+    order that their comparability numbers appear in the .decls file.
+    """
+    separate_entry_exit = False
+    ppts = {}
+    cur = None
+    with open(filename) as f:
+        first = f.readline().split()
+        if first != ["dyncomp-partitions", "1"]:
+            sys.exit("%s is not a DynComp partitions file" % filename)
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("separate-entry-exit "):
+                separate_entry_exit = line.split()[1] == "yes"
+            elif line.startswith("ppt "):
+                cur = ppts.setdefault(line[4:], [])
+            elif line:
+                index, set_id = line.split()
+                if cur is None:
+                    sys.exit("%s: variable outside of a program point" % filename)
+                cur.append((int(index), int(set_id)))
+    return separate_entry_exit, ppts
+
+
+def partition_key(ppt, separate_entry_exit):
+    """Return the name under which ppt's variables are partitioned.
+
+    Unless --dyncomp-separate-entry-exit was on, the entry and exit of
+    a function share one partition (DynComp uses the exit's sets for
+    both), so that their comparability numbers always agree.
+    """
+    if not separate_entry_exit:
+        for suffix in ENTER_EXIT_SUFFIXES:
+            if ppt.endswith(suffix):
+                return ppt[: -len(suffix)]
+    return ppt
+
+
+def merge(partition_files):
+    """Union the partitions of all runs.
+
+    Returns (uf, separate_entry_exit, ppts) where ppts is the
+    partitions of the first run (used to line up the .decls file).
+    """
+    uf = UnionFind()
+    first = None
+    for shard, filename in enumerate(partition_files):
+        separate_entry_exit, ppts = read_partitions(filename)
+        if first is None:
+            first = (separate_entry_exit, ppts)
+        elif separate_entry_exit != first[0]:
+            sys.exit("%s: runs differ in --dyncomp-separate-entry-exit" % filename)
+        for ppt, records in ppts.items():
+            first_records = first[1].get(ppt)
+            if first_records is None or \
+                    [r[0] for r in records] != [r[0] for r in first_records]:
+                sys.exit("%s: program point %s does not match %s"
+                         % (filename, ppt, partition_files[0]))
+            key = partition_key(ppt, separate_entry_exit)
+            for index, set_id in records:
+                # A set id is a comparability number, which is only
+                # meaningful within its own run and program point
+                # (Kvasir numbers the sets of each one from 1):
+                uf.union(("var", key, index), ("set", shard, key, set_id))
+    return uf, first[0], first[1]
+
+
+def rewrite_decls(decls, out, uf, separate_entry_exit, ppts):
+    """Copy decls to out, renumbering the comparability lines."""
+    numbers = {}
+    ppt = None
+    records = iter(())
+    for line in decls:
+        stripped = line.strip()
+        if stripped.startswith("ppt "):
+            ppt = stripped[4:]
+            records = iter(ppts.get(ppt, []))
+        elif stripped.startswith("comparability "):
+            record = next(records, None)
+            if record is None:
+                sys.exit("program point %s has more variables in the .decls "
+                         "file than in the partitions" % ppt)
+            index = record[0]
+            root = uf.find(("var", partition_key(ppt, separate_entry_exit), index))
+            number = numbers.setdefault(root, len(numbers) + 1)
+            indent = line[: len(line) - len(line.lstrip())]
+            line = "%scomparability %d\n" % (indent, number)
+        out.write(line)
+
+
+def main():
+    parser = optparse.OptionParser(
+        usage="%prog [-o OUTPUT] DECLS PARTITIONS...",
+        description="Combine the comparability results of several "
+        "Kvasir/DynComp runs made with --dyncomp-partitions.")
+    parser.add_option("-o", "--output", dest="output",
+                      help="Write the combined .decls file to OUTPUT "
+                      "(default: standard output)")
+    (options, args) = parser.parse_args()
+    if len(args) < 2:
+        parser.error("need a .decls file and at least one partitions file")
+
+    uf, separate_entry_exit, ppts = merge(args[1:])
+    out = open(options.output, "w") if options.output else sys.stdout
+    with open(args[0]) as decls:
+        rewrite_decls(decls, out, uf, separate_entry_exit, ppts)
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,129 @@
+#! /usr/bin/env python3
+r"""Combine the per-thread .dtrace files of a Kvasir run into one.
+
+With --dtrace-per-thread, Kvasir writes the records of each thread of
+a multi-threaded program to a .dtrace file of its own: the main
+thread's go to the usual foo.dtrace and those of thread N to
+foo-threadN.dtrace.  Each record is preceded by a "# thread N"
+comment, and invocation nonces are numbered separately for each
+thread, so the same nonce can turn up in several of the files.
+
+This script concatenates the files into a single .dtrace file that
+Daikon can read, renumbering the nonces so that every invocation gets
+a nonce of its own.  The header and any declarations are taken from
+the first file (the main thread's); those of the other files, which
+are the same, are dropped.
+"""
+
+## Usage: merge_thread_traces.py [-o output.dtrace] main.dtrace thread.dtrace...
+import optparse
+import sys
+
+HEADER_KEYWORDS = ("input-language", "decl-version", "var-comparability")
+NONCE_LINE = "this_invocation_nonce"
+
+
+def read_blocks(f):
+    """Yield the blank-line separated blocks of f as lists of lines."""
+    block = []
+    for line in f:
+        line = line.rstrip("\n")
+        if line:
+            block.append(line)
+        elif block:
+            yield block
+            block = []
+    if block:
+        yield block
+
+
+def thread_of(block, default):
+    """Return the thread named by block's "# thread N" comment."""
+    for line in block:
+        if line.startswith("# thread "):
+            return int(line.split()[2])
+        if not line.startswith("#"):
+            break
+    return default
+
+
+def body_of(block):
+    """Return block without its leading comment lines."""
+    i = 0
+    while i < len(block) and block[i].startswith("#"):
+        i += 1
+    return block[i:]
+
+
+class NonceMap:
+    """Hands out fresh nonces for (thread, nonce) pairs."""
+
+    def __init__(self):
+        self.open = {}
+        self.next = 0
+
+    def renumber(self, key, is_exit):
+        """Return the new nonce for key; an exit ends the invocation."""
+        nonce = self.open.get(key)
+        if nonce is None:
+            nonce = self.next
+            self.next += 1
+            if not is_exit:
+                self.open[key] = nonce
+        elif is_exit:
+            del self.open[key]
+        return nonce
+
+
+def merge(filenames, out, copy_header=True, per_file=False):
+    """Write the records of all of filenames to out, renumbering nonces.
+
+    The header and declarations of the first file are copied, too, if
+    copy_header is set.  Unless per_file is set, the records of a
+    thread are matched up by their thread comment even if they are in
+    different files.
+    """
+    nonces = NonceMap()
+    for index, filename in enumerate(filenames):
+        # Records without a thread comment are told apart by file:
+        default_thread = ("file", index)
+        with open(filename) as f:
+            for block in read_blocks(f):
+                body = body_of(block)
+                if not body:
+                    continue
+                if body[0].split()[0] in HEADER_KEYWORDS or \
+                        body[0].startswith("ppt "):
+                    if index == 0 and copy_header:
+                        out.write("\n".join(block) + "\n\n")
+                    continue
+                if len(body) >= 3 and body[1] == NONCE_LINE:
+                    thread = thread_of(block, default_thread)
+                    key = ((index, thread) if per_file else thread, body[2])
+                    is_exit = ":::EXIT" in body[0]
+                    nonce = nonces.renumber(key, is_exit)
+                    offset = len(block) - len(body)
+                    block[offset + 2] = str(nonce)
+                out.write("\n".join(block) + "\n\n")
+
+
+def main():
+    parser = optparse.OptionParser(
+        usage="%prog [-o OUTPUT] MAIN_DTRACE THREAD_DTRACE...",
+        description="Combine the .dtrace files written by Kvasir with "
+        "--dtrace-per-thread into one.")
+    parser.add_option("-o", "--output", dest="output",
+                      help="Write the combined .dtrace file to OUTPUT "
+                      "(default: standard output)")
+    (options, args) = parser.parse_args()
+    if len(args) < 1:
+        parser.error("need at least one .dtrace file")
+
+    out = open(options.output, "w") if options.output else sys.stdout
+    merge(args, out)
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,107 @@
+#! /usr/bin/env python3
+"""Tests for merge_partitions.py.
+
+Run with: python3 test_merge_partitions.py
+"""
+
+import io
+import os
+import shutil
+import tempfile
+import unittest
+
+import merge_partitions
+
+
+def comparabilities(decls):
+    """Return {ppt: [comparability numbers]} for the text of a .decls file."""
+    result = {}
+    ppt = None
+    for line in decls.splitlines():
+        line = line.strip()
+        if line.startswith("ppt "):
+            ppt = result.setdefault(line[4:], [])
+        elif line.startswith("comparability "):
+            ppt.append(int(line.split()[1]))
+    return result
+
+
+class MergePartitionsTest(unittest.TestCase):
+
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def write_partitions(self, name, separate, ppts):
+        """Write a partitions file with ppts: [(name, [set ids])]."""
+        path = os.path.join(self.dir, name)
+        with open(path, "w") as f:
+            f.write("dyncomp-partitions 1\n")
+            f.write("separate-entry-exit %s\n" % ("yes" if separate else "no"))
+            for ppt, set_ids in ppts:
+                f.write("ppt %s\n" % ppt)
+                for index, set_id in enumerate(set_ids):
+                    f.write("%d %d\n" % (index, set_id))
+        return path
+
+    def merged(self, decls, partition_files):
+        uf, separate, ppts = merge_partitions.merge(partition_files)
+        out = io.StringIO()
+        merge_partitions.rewrite_decls(io.StringIO(decls), out, uf,
+                                       separate, ppts)
+        return comparabilities(out.getvalue())
+
+    def decls(self, ppts):
+        lines = []
+        for ppt, num_vars in ppts:
+            lines.append("ppt %s" % ppt)
+            for v in range(num_vars):
+                lines.append("  variable v%d" % v)
+                lines.append("    comparability 1")
+            lines.append("")
+        return "\n".join(lines) + "\n"
+
+    def test_numbers_reused_across_program_points(self):
+        # Kvasir numbers the sets of each program point from 1, so the
+        # same numbers in A and B say nothing about each other
+        ppts = [("A():::ENTER", 2), ("B():::ENTER", 2)]
+        shard1 = self.write_partitions("1.parts", True, [
+            ("A():::ENTER", [1, 2]), ("B():::ENTER", [1, 2])])
+        shard2 = self.write_partitions("2.parts", True, [
+            ("A():::ENTER", [1, 2]), ("B():::ENTER", [2, 1])])
+        result = self.merged(self.decls(ppts), [shard1, shard2])
+        a = result["A():::ENTER"]
+        b = result["B():::ENTER"]
+        self.assertNotEqual(a[0], a[1])
+        self.assertNotEqual(b[0], b[1])
+
+    def test_union_across_runs(self):
+        ppts = [("A():::ENTER", 3)]
+        shard1 = self.write_partitions("1.parts", True, [
+            ("A():::ENTER", [1, 1, 2])])
+        shard2 = self.write_partitions("2.parts", True, [
+            ("A():::ENTER", [1, 2, 2])])
+        a = self.merged(self.decls(ppts), [shard1, shard2])["A():::ENTER"]
+        self.assertEqual(a[0], a[1])
+        self.assertEqual(a[1], a[2])
+
+    def test_entry_and_exit_share_sets(self):
+        # Without separate-entry-exit, the same number at the entry and
+        # the exit of a function is the same set
+        ppts = [("A():::ENTER", 2), ("A():::EXIT0", 2)]
+        shard1 = self.write_partitions("1.parts", False, [
+            ("A():::ENTER", [1, 2]), ("A():::EXIT0", [1, 2])])
+        shard2 = self.write_partitions("2.parts", False, [
+            ("A():::ENTER", [1, 1]), ("A():::EXIT0", [1, 1])])
+        result = self.merged(self.decls(ppts), [shard1, shard2])
+        self.assertEqual(result["A():::ENTER"][0], result["A():::ENTER"][1])
+        self.assertEqual(result["A():::EXIT0"][0], result["A():::EXIT0"][1])
+
+        only1 = self.merged(self.decls(ppts), [shard1])
+        self.assertNotEqual(only1["A():::ENTER"][0], only1["A():::ENTER"][1])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -2836,6 +2836,62 @@ char harvest_debug_frame_entry(debug_frame *df){
 }
 
 
+// These two record the operations of a location list entry's
+// expression as decode_location_expression() goes through them:
+void harvest_location_list_op(location_list* ll, enum dwarf_location_atom atom){
+  if (ll->expr_size < MAX_DWARF_OPS) {
+    ll->expr[ll->expr_size].atom = atom;
+    ll->expr[ll->expr_size].atom_offset = 0;
+    ll->expr_size++;
+  }
+  else {
+    ll->expr_size = MAX_DWARF_OPS + 1;
+  }
+}
+
+void harvest_location_list_operand(location_list* ll, long long value){
+  if ((ll->expr_size > 0) && (ll->expr_size <= MAX_DWARF_OPS)) {
+    ll->expr[ll->expr_size - 1].atom_offset = value;
+  }
+}
+
+char harvest_formal_param_location_list(dwarf_entry* e, unsigned long offset)
+{
+  unsigned long tag;
+  if ((e == 0) || (e->entry_ptr == 0))
+    return 0;
+
+  tag = e->tag_name;
+
+  if (tag_is_formal_parameter(tag))
+    {
+      formal_parameter *paramPtr = ((formal_parameter*)e->entry_ptr);
+      paramPtr->has_loc_list = 1;
+      paramPtr->loc_list_offset = offset;
+      paramPtr->valid_loc = 1;
+      return 1;
+    }
+  else
+    return 0;
+}
+
+// A formal parameter of a DWARF 5 compilation unit whose location is a
+// .debug_loclists list, which we don't read, so it gets skipped
+char harvest_formal_param_loclists(dwarf_entry* e)
+{
+  static Bool warned = False;
+
+  if ((e == 0) || (e->entry_ptr == 0) || !tag_is_formal_parameter(e->tag_name))
+    return 0;
+
+  if (!warned) {
+    printf( "  Warning! Target program has DWARF 5 location lists for formal parameters,\n"
+            "  which are skipped; compile it with -gdwarf-4 to trace them.\n");
+    warned = True;
+  }
+  return 1;
+}
+
 char harvest_location_list_entry(location_list* ll, unsigned long offset){
   location_list *cur_loc = NULL;
   tl_assert(loc_list_map && "Location list map uninitialized");
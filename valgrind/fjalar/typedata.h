@@ -73,6 +73,11 @@ typedef struct _location_list
   unsigned long end;
   enum dwarf_location_atom atom; //Location Expression.
   long long atom_offset;
+  // The whole location expression (atom and atom_offset are just its
+  // last operation, which is all that the frame base code needs).
+  // expr_size is MAX_DWARF_OPS + 1 if the expression was too long.
+  dwarf_location expr[MAX_DWARF_OPS];
+  unsigned int expr_size;
   struct _location_list *next;
 } location_list;
 
@@ -335,6 +340,11 @@ typedef struct
                  //       way to get the parameter location
   unsigned int valid_loc;
 
+  // If DW_AT_location is a location list (as for optimized code),
+  // this is its offset in .debug_loc, i.e., its key in loc_list_map
+  unsigned int has_loc_list;
+  unsigned long loc_list_offset;
+
   unsigned long abstract_origin_ID; // See comment in the function struct definition
                                     // for the uses of this.
 
@@ -533,6 +543,10 @@ char harvest_specification_value(dwarf_entry* e, unsigned long value);
 char harvest_abstract_origin_value(dwarf_entry* e, unsigned long value);
 char harvest_accessibility(dwarf_entry* e, char a);
 char harvest_location_list_entry(location_list* ll, unsigned long offset);
+void harvest_location_list_op(location_list* ll, enum dwarf_location_atom atom);
+void harvest_location_list_operand(location_list* ll, long long value);
+char harvest_formal_param_location_list(dwarf_entry* e, unsigned long offset);
+char harvest_formal_param_loclists(dwarf_entry* e);
 char harvest_debug_frame_entry(debug_frame* df);
 char harvest_frame_base(dwarf_entry* e, enum dwarf_location_atom a, long offset);
 char harvest_decl_file(dwarf_entry* e, unsigned long value);
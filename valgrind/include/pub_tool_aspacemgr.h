@@ -159,6 +159,18 @@ extern void* VG_(am_shadow_alloc)(SizeT size);
    accordingly.  This fails if the range isn't valid for valgrind. */
 extern SysRes VG_(am_munmap_valgrind)( Addr start, SizeT length );
 
+/* Fjalar - Map shared a file at an unconstrained address for V (see
+   pub_core_aspacemgr.h).  Kvasir uses this to share a buffer with the
+   process that writes its .dtrace file. */
+extern SysRes VG_(am_shared_mmap_file_float_valgrind)
+   ( SizeT length, UInt prot, Int fd, Off64T offset );
+
+/* Fjalar - Map privately a file at an unconstrained address for V
+   (see pub_core_aspacemgr.h).  Fjalar uses this to read the sections
+   of the program's ELF file without copying them. */
+extern SysRes VG_(am_mmap_file_float_valgrind)
+   ( SizeT length, UInt prot, Int fd, Off64T offset );
+
 #endif   // __PUB_TOOL_ASPACEMGR_H
 
 /*--------------------------------------------------------------------*/
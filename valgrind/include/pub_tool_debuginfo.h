@@ -279,6 +279,7 @@ SizeT         VG_(DebugInfo_get_got_size)    ( const DebugInfo *di );
 const HChar*  VG_(DebugInfo_get_soname)      ( const DebugInfo *di );
 const HChar*  VG_(DebugInfo_get_filename)    ( const DebugInfo *di );
 PtrdiffT      VG_(DebugInfo_get_text_bias)   ( const DebugInfo *di );
+ULong         VG_(DebugInfo_get_handle)      ( const DebugInfo *di );
 
 /* Function for traversing the DebugInfo list.  When called with NULL
    it returns the first element; otherwise it returns the given
@@ -314,6 +315,19 @@ const HChar* VG_(pp_SectKind)( VgSectKind kind );
    the address space manager mapped files. */
 VgSectKind VG_(DebugInfo_sect_kind)( /*OUT*/const HChar** objname, Addr a);
 
+/* Fjalar - Valgrind's own inflater (m_debuginfo/tinfl.c), for tools
+   that read compressed debug info sections themselves.  Decompresses
+   the src_len bytes at src into the out_len bytes at out and returns
+   the number of bytes written, or VG_TINFL_DECOMPRESS_FAILED.  flags
+   are the VG_TINFL_FLAG_* below. */
+#define VG_TINFL_FLAG_PARSE_ZLIB_HEADER             1
+#define VG_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF 4
+#define VG_TINFL_DECOMPRESS_FAILED                  ((SizeT)(-1))
+
+SizeT VG_(tinfl_decompress_mem_to_mem) ( void* out, SizeT out_len,
+                                         const void* src, SizeT src_len,
+                                         Int flags );
+
 
 #endif   // __PUB_TOOL_DEBUGINFO_H
 
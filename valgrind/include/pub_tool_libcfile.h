@@ -103,6 +103,13 @@ extern const HChar* VG_(dirname) ( const HChar* path );
 /* Return the name of a directory for temporary files. */
 extern const HChar* VG_(tmpdir)(void);
 
+/* Fjalar - Create and open a new temporary file (see
+   pub_core_libcfile.h).  Returns -1 on failure, else the fd of the
+   file.  fullname must have room for
+   VG_(mkstemp_fullname_bufsz)(VG_(strlen)(part_of_name)) chars. */
+extern SizeT VG_(mkstemp_fullname_bufsz) ( SizeT part_of_name_len );
+extern Int VG_(mkstemp) ( const HChar* part_of_name, /*OUT*/HChar* fullname );
+
 /* Return the working directory at startup. The returned string is
    persistent. Might be NULL if the current working directory doesn't
    exist. */
@@ -34,6 +34,16 @@
 void VG_(discard_translations_safely) ( Addr  start, SizeT len,
                                         const HChar* who );
 
+// Fjalar - Like VG_(discard_translations_safely), but callable from a
+// dirty helper (see fjalar_retire_function()).  The host code of a
+// discarded translation stays in its sector until the sector is
+// recycled for a new translation, so the helper may return into the
+// superblock it was called from; all chains into the discarded
+// superblocks are undone, so control goes back through the dispatcher
+// when that superblock exits.
+void VG_(discard_translations_from_helper) ( Addr  start, SizeT len,
+                                             const HChar* who );
+
 #endif   // __PUB_TOOL_TRANSTAB_H
 
 /*--------------------------------------------------------------------*/
@@ -0,0 +1,62 @@
+// This artificial program passes large arrays around, on the heap and
+// as globals.  It is a stress test for the part of Kvasir that finds out
+// how big an array behind a pointer is and prints all of its elements
+// (and, with DynComp, merges all of their tags) at every program point.
+
+#include <stdlib.h>
+
+#define LEN    10000
+#define REPS   50
+
+int    global_ints[LEN];
+double global_doubles[LEN / 4];
+
+__attribute__((noinline))
+long sum_ints(const int* a, int n)
+{
+   long s = 0;
+   int i;
+   for (i = 0; i < n; i++) {
+      s += a[i];
+   }
+   return s;
+}
+
+__attribute__((noinline))
+void scale(double* a, int n, double factor)
+{
+   int i;
+   for (i = 0; i < n; i++) {
+      a[i] *= factor;
+   }
+}
+
+__attribute__((noinline))
+void fill(int* a, int n, int seed)
+{
+   int i;
+   for (i = 0; i < n; i++) {
+      a[i] = seed + i;
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   int len  = (argc > 1) ? atoi(argv[1]) : LEN;
+   int reps = (argc > 2) ? atoi(argv[2]) : REPS;
+   int* heap_ints = malloc(len * sizeof(int));
+   long sum = 0;
+   int i;
+
+   for (i = 0; i < LEN / 4; i++) {
+      global_doubles[i] = i;
+   }
+   for (i = 0; i < reps; i++) {
+      fill(heap_ints, len, i);
+      fill(global_ints, LEN, -i);
+      scale(global_doubles, LEN / 4, 1.0001);
+      sum += sum_ints(heap_ints, len) + sum_ints(global_ints, LEN);
+   }
+   free(heap_ints);
+   return ( sum == 0xdeadbeef ? 1 : 0 );
+}
@@ -0,0 +1,72 @@
+// This artificial program calls lots of member functions of small C++
+// class hierarchies.  It is a stress test for the C++ side of Fjalar:
+// every call has a "this" parameter whose fields (including inherited
+// ones and member objects) Kvasir has to traverse, and the member
+// functions give it mangled names, constructors and object program
+// points to deal with.
+
+#include <stdlib.h>
+
+#define REPS   5000
+
+class Vec {
+public:
+   Vec(double vx, double vy) : x(vx), y(vy) {}
+   double dot(const Vec& other) const { return x * other.x + y * other.y; }
+   Vec operator+(const Vec& other) const { return Vec(x + other.x, y + other.y); }
+   double x, y;
+};
+
+class Shape {
+public:
+   Shape(int i, const Vec& o) : id(i), origin(o), moves(0) {}
+   virtual ~Shape() {}
+   virtual double area() const = 0;
+   void move(const Vec& by) { origin = origin + by; moves++; }
+protected:
+   int id;
+   Vec origin;
+   long moves;
+};
+
+class Circle : public Shape {
+public:
+   Circle(int i, const Vec& o, double radius) : Shape(i, o), r(radius) {}
+   virtual double area() const { return 3.14159 * r * r; }
+private:
+   double r;
+};
+
+class Rect : public Shape {
+public:
+   Rect(int i, const Vec& o, const Vec& e) : Shape(i, o), extent(e) {}
+   virtual double area() const { return extent.x * extent.y; }
+private:
+   Vec extent;
+   char label[16];
+};
+
+int main(int argc, char* argv[])
+{
+   int reps = (argc > 1) ? atoi(argv[1]) : REPS;
+   Shape* shapes[8];
+   double sum = 0;
+   int i;
+
+   for (i = 0; i < 8; i++) {
+      if (i & 1) {
+         shapes[i] = new Circle(i, Vec(i, -i), 1.0 + i);
+      } else {
+         shapes[i] = new Rect(i, Vec(-i, i), Vec(2.0, i + 1.0));
+      }
+   }
+   for (i = 0; i < reps; i++) {
+      Vec step(i % 3, 1);
+      shapes[i % 8]->move(step);
+      sum += shapes[i % 8]->area() + step.dot(Vec(0.5, 0.5));
+   }
+   for (i = 0; i < 8; i++) {
+      delete shapes[i];
+   }
+   return ( sum == 1.0 ? 1 : 0 );
+}
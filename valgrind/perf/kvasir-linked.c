@@ -0,0 +1,102 @@
+// This artificial program builds and walks pointer-heavy data structures:
+// a doubly linked list and a binary search tree, with nodes scattered
+// over the heap.  It is a stress test for Kvasir's pointer dereferencing:
+// every node parameter leads Kvasir through next/prev/left/right pointers
+// (up to --struct-depth levels), each of which has to be checked against
+// Memcheck's A bits and the heap block table, and for the sequences of
+// nodes that it derives.
+
+#include <stdlib.h>
+
+#define NODES  500
+#define REPS   20
+
+struct list_node {
+   int key;
+   char tag[8];
+   struct list_node* next;
+   struct list_node* prev;
+};
+
+struct tree_node {
+   int key;
+   struct tree_node* left;
+   struct tree_node* right;
+   struct tree_node* parent;
+   struct list_node* item;
+};
+
+__attribute__((noinline))
+struct list_node* push(struct list_node* head, int key)
+{
+   struct list_node* n = malloc(sizeof(*n));
+   n->key = key;
+   n->tag[0] = 'a' + (key % 26);
+   n->next = head;
+   n->prev = NULL;
+   if (head) {
+      head->prev = n;
+   }
+   return n;
+}
+
+__attribute__((noinline))
+struct tree_node* insert(struct tree_node* root, struct tree_node* parent,
+                         struct list_node* item)
+{
+   if (!root) {
+      struct tree_node* t = calloc(1, sizeof(*t));
+      t->key = item->key;
+      t->parent = parent;
+      t->item = item;
+      return t;
+   }
+   if (item->key < root->key) {
+      root->left = insert(root->left, root, item);
+   } else {
+      root->right = insert(root->right, root, item);
+   }
+   return root;
+}
+
+__attribute__((noinline))
+int lookup(struct tree_node* root, int key)
+{
+   while (root && root->key != key) {
+      root = (key < root->key) ? root->left : root->right;
+   }
+   return root ? root->item->tag[0] : 0;
+}
+
+__attribute__((noinline))
+int walk(struct list_node* head)
+{
+   int sum = 0;
+   for (; head; head = head->next) {
+      sum += head->key;
+   }
+   return sum;
+}
+
+int main(int argc, char* argv[])
+{
+   int nodes = (argc > 1) ? atoi(argv[1]) : NODES;
+   int reps  = (argc > 2) ? atoi(argv[2]) : REPS;
+   struct list_node* head = NULL;
+   struct list_node* n;
+   struct tree_node* root = NULL;
+   int i, sum = 0;
+
+   for (i = 0; i < nodes; i++) {
+      // Spread the keys out so that the tree doesn't degenerate.
+      head = push(head, (i * 7919) % nodes);
+   }
+   for (n = head; n; n = n->next) {
+      root = insert(root, NULL, n);
+   }
+   for (i = 0; i < reps; i++) {
+      sum += walk(head);
+      sum += lookup(root, i % nodes);
+   }
+   return ( sum == 0xdeadbeef ? 1 : 0 );
+}
@@ -0,0 +1,46 @@
+// This artificial program makes a lot of calls that nest very deeply.  It
+// is a stress test for Kvasir's handling of function entries and exits:
+// every call is a program point, and each of them pushes an entry (and a
+// copy of the formal parameters) onto Fjalar's per-thread function stack,
+// which here gets thousands of entries deep.
+
+#include <stdlib.h>
+
+#define DEPTH  2000
+#define REPS   20
+
+int counter;
+
+__attribute__((noinline))
+long descend(int depth, long acc, int step)
+{
+   counter++;
+   if (depth == 0) {
+      return acc;
+   }
+   // Alternate between two return paths so that the exits differ.
+   if (depth & 1) {
+      return descend(depth - 1, acc + step, step + 1) - 1;
+   }
+   return descend(depth - 1, acc ^ step, step) + 1;
+}
+
+__attribute__((noinline))
+int fib(int n)
+{
+   return (n < 2) ? n : fib(n - 1) + fib(n - 2);
+}
+
+int main(int argc, char* argv[])
+{
+   int depth = (argc > 1) ? atoi(argv[1]) : DEPTH;
+   int reps  = (argc > 2) ? atoi(argv[2]) : REPS;
+   long sum = 0;
+   int i;
+
+   for (i = 0; i < reps; i++) {
+      sum += descend(depth, i, 1);
+      sum += fib(15);
+   }
+   return ( sum == 0xdeadbeef ? 1 : 0 );
+}
@@ -0,0 +1,82 @@
+// This artificial program passes large structs around, by value and by
+// pointer.  It is a stress test for Kvasir's traversal of struct fields:
+// each parameter expands into well over a hundred variables, including
+// nested structs and embedded arrays, at every program point.
+
+#include <stdlib.h>
+#include <string.h>
+
+#define REPS   2000
+
+struct point {
+   int x, y, z;
+   double weight;
+};
+
+struct record {
+   int id;
+   char name[32];
+   short flags[16];
+   struct point corners[8];
+   struct point center;
+   double stats[24];
+   unsigned long long stamp;
+   struct record* next;
+};
+
+struct record table[16];
+
+__attribute__((noinline))
+double score(struct record r)
+{
+   double s = r.center.weight;
+   int i;
+   for (i = 0; i < 8; i++) {
+      s += r.corners[i].x * r.corners[i].weight;
+   }
+   return s + r.stats[r.id % 24];
+}
+
+__attribute__((noinline))
+void update(struct record* r, const struct point* p, int i)
+{
+   r->corners[i % 8] = *p;
+   r->center.x += p->x;
+   r->center.weight += p->weight;
+   r->stats[i % 24] = r->center.weight;
+   r->flags[i % 16] ^= (short)i;
+   r->stamp++;
+}
+
+__attribute__((noinline))
+struct point midpoint(struct point a, struct point b)
+{
+   struct point m;
+   m.x = (a.x + b.x) / 2;
+   m.y = (a.y + b.y) / 2;
+   m.z = (a.z + b.z) / 2;
+   m.weight = (a.weight + b.weight) / 2;
+   return m;
+}
+
+int main(int argc, char* argv[])
+{
+   int reps = (argc > 1) ? atoi(argv[1]) : REPS;
+   double sum = 0;
+   int i;
+
+   for (i = 0; i < 16; i++) {
+      table[i].id = i;
+      strcpy(table[i].name, "record");
+      table[i].next = &table[(i + 1) % 16];
+   }
+   for (i = 0; i < reps; i++) {
+      struct record* r = &table[i % 16];
+      struct point p = midpoint(r->corners[i % 8], r->next->center);
+      p.x += i;
+      p.weight += 0.5;
+      update(r, &p, i);
+      sum += score(*r);
+   }
+   return ( sum == 1.0 ? 1 : 0 );
+}